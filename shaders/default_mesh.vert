@@ -1,27 +1,45 @@
-#version 460
-
-layout (location = 0) in vec3 vPosition;
-layout (location = 1) in vec3 vNormal;
-layout (location = 2) in vec3 vColor;
-layout (location = 3) in vec2 vTexCoord;
-
-layout (location = 0) out vec3 outColor;
-layout (location = 1) out vec2 texCoord;
-
-layout (set = 0, binding = 0) uniform CameraBuffer {
-    mat4 view;
-    mat4 proj;
-    mat4 viewproj;
-} cameraData;
-
-layout (push_constant) uniform constants {
-    vec4 data;
-    mat4 matrix;
-} pushConstant;
-
-void main() {
-    mat4 transformMatrix = (cameraData.viewproj * pushConstant.matrix);
-    gl_Position = transformMatrix * vec4(vPosition, 1.0f);
-    outColor = vColor;
-    texCoord = vTexCoord;
+#version 460
+
+layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec3 vNormal;
+layout (location = 2) in vec3 vColor;
+layout (location = 3) in vec2 vTexCoord;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 texCoord;
+// slot in the texture table, only read by the bindless fragment shader
+layout (location = 2) flat out uint outTextureIndex;
+
+layout (set = 0, binding = 0) uniform CameraBuffer {
+    mat4 view;
+    mat4 proj;
+    mat4 viewproj;
+} cameraData;
+
+// world matrix of every model instance
+layout (std430, set = 0, binding = 1) readonly buffer InstanceBuffer {
+    mat4 instances[];
+};
+
+struct DrawData {
+    mat4 matrix; // mesh within its model
+    uint instanceOffset;
+    uint textureIndex;
+    uint padding1;
+    uint padding2;
+};
+
+// one entry per draw, the draw's index is passed as its first instance
+layout (std430, set = 0, binding = 2) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+void main() {
+    DrawData draw = draws[gl_BaseInstance];
+    mat4 instance = instances[draw.instanceOffset + gl_InstanceIndex - gl_BaseInstance];
+    mat4 transformMatrix = (cameraData.viewproj * instance * draw.matrix);
+    gl_Position = transformMatrix * vec4(vPosition, 1.0f);
+    outColor = vColor;
+    texCoord = vTexCoord;
+    outTextureIndex = draw.textureIndex;
 }
\ No newline at end of file
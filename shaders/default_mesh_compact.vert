@@ -0,0 +1,52 @@
+#version 460
+
+// CompactVertex layout, the position is dequantized by the draw matrix
+layout (location = 0) in vec4 vPosition;
+layout (location = 1) in vec2 vNormal;
+layout (location = 3) in vec2 vTexCoord;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 texCoord;
+// slot in the texture table, only read by the bindless fragment shader
+layout (location = 2) flat out uint outTextureIndex;
+
+layout (set = 0, binding = 0) uniform CameraBuffer {
+    mat4 view;
+    mat4 proj;
+    mat4 viewproj;
+} cameraData;
+
+// world matrix of every model instance
+layout (std430, set = 0, binding = 1) readonly buffer InstanceBuffer {
+    mat4 instances[];
+};
+
+struct DrawData {
+    mat4 matrix; // mesh within its model
+    uint instanceOffset;
+    uint textureIndex;
+    uint padding1;
+    uint padding2;
+};
+
+// one entry per draw, the draw's index is passed as its first instance
+layout (std430, set = 0, binding = 2) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+vec3 decode_normal(vec2 encoded) {
+    vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float t = max(-n.z, 0.0f);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0f)));
+    return normalize(n);
+}
+
+void main() {
+    DrawData draw = draws[gl_BaseInstance];
+    mat4 instance = instances[draw.instanceOffset + gl_InstanceIndex - gl_BaseInstance];
+    mat4 transformMatrix = (cameraData.viewproj * instance * draw.matrix);
+    gl_Position = transformMatrix * vec4(vPosition.xyz, 1.0f);
+    outColor = decode_normal(vNormal);
+    texCoord = vTexCoord;
+    outTextureIndex = draw.textureIndex;
+}
@@ -0,0 +1,23 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 texCoord;
+layout (location = 2) flat in uint textureIndex;
+
+layout (location = 0) out vec4 outFragColor;
+
+// every texture, only the slots in use are bound
+layout (set = 1, binding = 0) uniform texture2D textures[];
+layout (set = 1, binding = 1) uniform sampler textureSampler;
+
+layout (push_constant) uniform constants {
+    vec4 data; // x for LOD bias
+} pushConstant;
+
+void main() {
+    // draws batched across textures can share a subgroup, so the index isn't uniform
+    vec4 texColor = texture(sampler2D(textures[nonuniformEXT(textureIndex)], textureSampler), texCoord, pushConstant.data.x);
+
+    outFragColor = texColor;
+}
\ No newline at end of file
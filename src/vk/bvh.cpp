@@ -0,0 +1,434 @@
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <vk/frustum_culling.h>
+
+#include "bvh.h"
+
+namespace VkRenderer {
+    static float surface_area(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+        glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // axis parallel rays would put 0 * inf into the slab test
+    static glm::vec3 inverse_direction(const glm::vec3 &direction) {
+        auto safe = [](float value) { return std::abs(value) < 1e-20f ? std::copysign(1e-20f, value) : value; };
+        return 1.0f / glm::vec3(safe(direction.x), safe(direction.y), safe(direction.z));
+    }
+
+    // distance at which the ray enters the box, infinity if it misses it before maxDistance
+    static float ray_box(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float maxDistance) {
+        glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+        glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+        glm::vec3 tMin = glm::min(t0, t1);
+        glm::vec3 tMax = glm::max(t0, t1);
+        float entry = std::max({tMin.x, tMin.y, tMin.z, 0.0f});
+        float exit = std::min({tMax.x, tMax.y, tMax.z, maxDistance});
+        return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+    }
+
+    void SceneBvh::init(ResourceHandles *resources) {
+        _resources = resources;
+    }
+
+    void SceneBvh::update(std::unordered_map<std::string, Model> &models) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        std::vector<ModelEntry> entries;
+        uint32_t primitiveCount = 0;
+        for (auto &it: models) {
+            Model &model = it.second;
+            if (!model.instances_allocated()) continue;
+
+            auto count = static_cast<uint32_t>(model.draw_bounds().size());
+            entries.push_back({&it.first, &model, model.id, primitiveCount, count, 0});
+            primitiveCount += count;
+        }
+
+        // the tree only depends on which models there are and how many draws each has, moving them is a refit,
+        // ids rather than addresses identify the models since a new one can take a removed one's place
+        bool rebuild = entries.size() != _entries.size();
+        for (size_t i = 0; !rebuild && i < entries.size(); i++) {
+            rebuild = entries[i].modelId != _entries[i].modelId || entries[i].primitiveCount != _entries[i].primitiveCount;
+        }
+
+        if (rebuild) {
+            _entries = std::move(entries);
+            build();
+            _stats.builds++;
+        } else {
+            for (auto &entry: _entries) {
+                if (entry.model->bounds_version() == entry.boundsVersion) continue;
+                refit(entry, entry.model->draw_bounds());
+                _stats.refits++;
+            }
+        }
+
+        _stats.primitiveCount = _primitives.size();
+        _stats.nodeCount = _nodes.size();
+        auto end = std::chrono::high_resolution_clock::now();
+        _stats.updateTime = std::chrono::duration<double, std::micro>(end - start).count();
+    }
+
+    void SceneBvh::build() {
+        _primitives.clear();
+        _buildBounds.clear();
+        for (uint32_t e = 0; e < _entries.size(); e++) {
+            ModelEntry &entry = _entries[e];
+            const std::vector<DrawBounds> &bounds = entry.model->draw_bounds();
+            entry.boundsVersion = entry.model->bounds_version();
+
+            // same order as draw_bounds, meshes with their transforms within
+            size_t boundsIndex = 0;
+            for (uint32_t m = 0; m < entry.model->meshes.size(); m++) {
+                for (uint32_t t = 0; t < entry.model->meshes[m]._transforms.size(); t++) {
+                    _primitives.push_back({e, m, t});
+                    _buildBounds.push_back(bounds[boundsIndex++]);
+                }
+            }
+        }
+
+        auto count = static_cast<uint32_t>(_primitives.size());
+        _order.resize(count);
+        std::iota(_order.begin(), _order.end(), 0);
+        _nodes.clear();
+        if (count > 0) {
+            // a binary tree with single primitive leaves has at most 2n - 1 nodes, so workers never resize it
+            _nodes.resize(2 * count - 1);
+            _nodes[0].parent = UINT32_MAX;
+            _nodeCount = 1;
+            build_node(0, 0, count);
+            {
+                std::unique_lock<std::mutex> lock(_buildMutex);
+                _buildCondition.wait(lock, [this]() { return _pendingJobs == 0; });
+            }
+            _nodes.resize(_nodeCount);
+        }
+
+        // bounds in tree order, so a leaf tests one contiguous range
+        _slots.resize(count);
+        _leaves.resize(count);
+        _centerX.resize(count);
+        _centerY.resize(count);
+        _centerZ.resize(count);
+        _extentX.resize(count);
+        _extentY.resize(count);
+        _extentZ.resize(count);
+        _radius.resize(count);
+        for (uint32_t slot = 0; slot < count; slot++) {
+            _slots[_order[slot]] = slot;
+            set_bounds(slot, _buildBounds[_order[slot]]);
+        }
+        for (uint32_t n = 0; n < _nodes.size(); n++) {
+            if (_nodes[n].left != 0) continue;
+            for (uint32_t slot = _nodes[n].first; slot < _nodes[n].first + _nodes[n].count; slot++) {
+                _leaves[slot] = n;
+            }
+        }
+        _refitMarks.assign(_nodes.size(), 0);
+        _buildBounds.clear();
+    }
+
+    void SceneBvh::build_node(uint32_t nodeIndex, uint32_t first, uint32_t count) {
+        BvhNode &node = _nodes[nodeIndex];
+        node.first = first;
+        node.count = count;
+        node.left = 0;
+        node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+        node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+        glm::vec3 centroidMin = node.boundsMin;
+        glm::vec3 centroidMax = node.boundsMax;
+        for (uint32_t i = first; i < first + count; i++) {
+            const DrawBounds &bounds = _buildBounds[_order[i]];
+            node.boundsMin = glm::min(node.boundsMin, bounds.center - bounds.extent);
+            node.boundsMax = glm::max(node.boundsMax, bounds.center + bounds.extent);
+            centroidMin = glm::min(centroidMin, bounds.center);
+            centroidMax = glm::max(centroidMax, bounds.center);
+        }
+        if (count == 1) return;
+
+        // binned SAH over the centroids, a split costs one traversal step plus the primitives tested on each side
+        glm::vec3 centroidExtent = centroidMax - centroidMin;
+        int bestAxis = -1;
+        uint32_t bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; axis++) {
+            if (centroidExtent[axis] <= 0.0f) continue;
+
+            float scale = static_cast<float>(BVH_BINS) / centroidExtent[axis];
+            uint32_t binCount[BVH_BINS] = {};
+            glm::vec3 binMin[BVH_BINS];
+            glm::vec3 binMax[BVH_BINS];
+            for (uint32_t bin = 0; bin < BVH_BINS; bin++) {
+                binMin[bin] = glm::vec3(std::numeric_limits<float>::max());
+                binMax[bin] = glm::vec3(-std::numeric_limits<float>::max());
+            }
+            for (uint32_t i = first; i < first + count; i++) {
+                const DrawBounds &bounds = _buildBounds[_order[i]];
+                uint32_t bin = std::min(BVH_BINS - 1, static_cast<uint32_t>((bounds.center[axis] - centroidMin[axis]) * scale));
+                binCount[bin]++;
+                binMin[bin] = glm::min(binMin[bin], bounds.center - bounds.extent);
+                binMax[bin] = glm::max(binMax[bin], bounds.center + bounds.extent);
+            }
+
+            // right side of every split first, then sweep the left side up to it
+            float rightArea[BVH_BINS] = {};
+            uint32_t rightCount[BVH_BINS] = {};
+            glm::vec3 sideMin(std::numeric_limits<float>::max());
+            glm::vec3 sideMax(-std::numeric_limits<float>::max());
+            uint32_t sideCount = 0;
+            for (uint32_t bin = BVH_BINS - 1; bin > 0; bin--) {
+                sideCount += binCount[bin];
+                sideMin = glm::min(sideMin, binMin[bin]);
+                sideMax = glm::max(sideMax, binMax[bin]);
+                rightCount[bin] = sideCount;
+                rightArea[bin] = sideCount > 0 ? surface_area(sideMin, sideMax) : 0.0f;
+            }
+            sideMin = glm::vec3(std::numeric_limits<float>::max());
+            sideMax = glm::vec3(-std::numeric_limits<float>::max());
+            sideCount = 0;
+            for (uint32_t split = 1; split < BVH_BINS; split++) {
+                sideCount += binCount[split - 1];
+                sideMin = glm::min(sideMin, binMin[split - 1]);
+                sideMax = glm::max(sideMax, binMax[split - 1]);
+                if (sideCount == 0 || rightCount[split] == 0) continue;
+
+                float cost = static_cast<float>(sideCount) * surface_area(sideMin, sideMax) + static_cast<float>(rightCount[split]) * rightArea[split];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = split;
+                }
+            }
+        }
+
+        // costs are relative to the node's area, a leaf costs one test per primitive
+        float leafCost = static_cast<float>(count - 1) * surface_area(node.boundsMin, node.boundsMax);
+        uint32_t middle;
+        if (bestAxis >= 0 && (count > BVH_MAX_LEAF_SIZE || bestCost < leafCost)) {
+            // same expression as the binning, so primitives land on the side they were counted on
+            float minimum = centroidMin[bestAxis];
+            float scale = static_cast<float>(BVH_BINS) / centroidExtent[bestAxis];
+            auto split = std::partition(_order.begin() + first, _order.begin() + first + count, [&](uint32_t primitive) {
+                return std::min(BVH_BINS - 1, static_cast<uint32_t>((_buildBounds[primitive].center[bestAxis] - minimum) * scale)) < bestSplit;
+            });
+            middle = static_cast<uint32_t>(split - _order.begin());
+        } else if (count > BVH_MAX_LEAF_SIZE) {
+            // every centroid is in the same place, any split is as good as another
+            middle = first + count / 2;
+        } else {
+            return;
+        }
+
+        uint32_t left = _nodeCount.fetch_add(2);
+        node.left = left;
+        _nodes[left].parent = nodeIndex;
+        _nodes[left + 1].parent = nodeIndex;
+        uint32_t leftCount = middle - first;
+        if (count > BVH_PARALLEL_THRESHOLD) {
+            {
+                std::lock_guard<std::mutex> lock(_buildMutex);
+                _pendingJobs++;
+            }
+            _resources->threadPool->submit([this, left, first, leftCount]() {
+                build_node(left, first, leftCount);
+                finish_job();
+            });
+        } else {
+            build_node(left, first, leftCount);
+        }
+        build_node(left + 1, middle, count - leftCount);
+    }
+
+    void SceneBvh::finish_job() {
+        {
+            std::lock_guard<std::mutex> lock(_buildMutex);
+            _pendingJobs--;
+        }
+        _buildCondition.notify_all();
+    }
+
+    void SceneBvh::set_bounds(uint32_t slot, const DrawBounds &bounds) {
+        _centerX[slot] = bounds.center.x;
+        _centerY[slot] = bounds.center.y;
+        _centerZ[slot] = bounds.center.z;
+        _extentX[slot] = bounds.extent.x;
+        _extentY[slot] = bounds.extent.y;
+        _extentZ[slot] = bounds.extent.z;
+        _radius[slot] = bounds.radius;
+    }
+
+    void SceneBvh::refit(ModelEntry &entry, const std::vector<DrawBounds> &bounds) {
+        entry.boundsVersion = entry.model->bounds_version();
+
+        // the model's leaves and every ancestor, each once
+        std::vector<uint32_t> dirty;
+        for (uint32_t i = 0; i < entry.primitiveCount; i++) {
+            uint32_t slot = _slots[entry.firstPrimitive + i];
+            set_bounds(slot, bounds[i]);
+            for (uint32_t node = _leaves[slot]; node != UINT32_MAX && !_refitMarks[node]; node = _nodes[node].parent) {
+                _refitMarks[node] = 1;
+                dirty.push_back(node);
+            }
+        }
+
+        // children are allocated after their parent, so descending indices refit bottom up
+        std::sort(dirty.begin(), dirty.end(), std::greater<>());
+        for (uint32_t nodeIndex: dirty) {
+            BvhNode &node = _nodes[nodeIndex];
+            if (node.left == 0) {
+                node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+                node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+                for (uint32_t slot = node.first; slot < node.first + node.count; slot++) {
+                    glm::vec3 center(_centerX[slot], _centerY[slot], _centerZ[slot]);
+                    glm::vec3 extent(_extentX[slot], _extentY[slot], _extentZ[slot]);
+                    node.boundsMin = glm::min(node.boundsMin, center - extent);
+                    node.boundsMax = glm::max(node.boundsMax, center + extent);
+                }
+            } else {
+                node.boundsMin = glm::min(_nodes[node.left].boundsMin, _nodes[node.left + 1].boundsMin);
+                node.boundsMax = glm::max(_nodes[node.left].boundsMax, _nodes[node.left + 1].boundsMax);
+            }
+            _refitMarks[nodeIndex] = 0;
+        }
+    }
+
+    size_t SceneBvh::cull_frustum(const glm::vec4 planes[6], std::vector<uint8_t> &visible) const {
+        visible.assign(_primitives.size(), 0);
+        if (_nodes.empty()) return 0;
+
+        // nodes with the planes they still straddle, planes a node is entirely inside of are dropped for its subtree
+        std::vector<std::pair<uint32_t, uint32_t>> stack;
+        stack.emplace_back(0, 0x3fu);
+        uint8_t leafVisible[BVH_MAX_LEAF_SIZE];
+        size_t visited = 0;
+        while (!stack.empty()) {
+            uint32_t nodeIndex = stack.back().first;
+            uint32_t planeMask = stack.back().second;
+            stack.pop_back();
+            visited++;
+
+            const BvhNode &node = _nodes[nodeIndex];
+            glm::vec3 center = (node.boundsMin + node.boundsMax) * 0.5f;
+            glm::vec3 extent = (node.boundsMax - node.boundsMin) * 0.5f;
+            bool outside = false;
+            for (uint32_t p = 0; p < 6 && !outside; p++) {
+                if (!(planeMask & (1u << p))) continue;
+
+                glm::vec3 normal = glm::vec3(planes[p]);
+                float distance = glm::dot(normal, center) + planes[p].w;
+                float reach = glm::dot(glm::abs(normal), extent);
+                if (distance + reach < 0.0f) {
+                    outside = true;
+                } else if (distance - reach >= 0.0f) {
+                    planeMask &= ~(1u << p);
+                }
+            }
+            if (outside) continue;
+
+            if (planeMask == 0) {
+                for (uint32_t slot = node.first; slot < node.first + node.count; slot++) {
+                    visible[_order[slot]] = 1;
+                }
+            } else if (node.left == 0) {
+                VkRenderer::culling::frustum_cull(planes, &_centerX[node.first], &_centerY[node.first], &_centerZ[node.first], &_extentX[node.first],
+                                                  &_extentY[node.first], &_extentZ[node.first], &_radius[node.first], node.count, leafVisible);
+                for (uint32_t i = 0; i < node.count; i++) {
+                    visible[_order[node.first + i]] = leafVisible[i];
+                }
+            } else {
+                stack.emplace_back(node.left, planeMask);
+                stack.emplace_back(node.left + 1, planeMask);
+            }
+        }
+        return visited;
+    }
+
+    bool SceneBvh::raycast(const glm::vec3 &origin, const glm::vec3 &direction, PickResult &result) const {
+        if (_nodes.empty()) return false;
+
+        glm::vec3 inverseDirection = inverse_direction(direction);
+        float nearest = std::numeric_limits<float>::infinity();
+        uint32_t nearestPrimitive = UINT32_MAX;
+        std::vector<uint32_t> stack = {0};
+        while (!stack.empty()) {
+            const BvhNode &node = _nodes[stack.back()];
+            stack.pop_back();
+            // boxes behind the nearest hit so far can't contain a closer one
+            if (std::isinf(ray_box(origin, inverseDirection, node.boundsMin, node.boundsMax, nearest))) continue;
+
+            if (node.left == 0) {
+                for (uint32_t slot = node.first; slot < node.first + node.count; slot++) {
+                    float distance = hit_primitive(_order[slot], origin, direction, nearest);
+                    if (distance < nearest) {
+                        nearest = distance;
+                        nearestPrimitive = _order[slot];
+                    }
+                }
+                continue;
+            }
+
+            // nearer child on top so it's visited first
+            float leftEntry = ray_box(origin, inverseDirection, _nodes[node.left].boundsMin, _nodes[node.left].boundsMax, nearest);
+            float rightEntry = ray_box(origin, inverseDirection, _nodes[node.left + 1].boundsMin, _nodes[node.left + 1].boundsMax, nearest);
+            uint32_t nearChild = leftEntry <= rightEntry ? node.left : node.left + 1;
+            uint32_t farChild = leftEntry <= rightEntry ? node.left + 1 : node.left;
+            if (!std::isinf(std::max(leftEntry, rightEntry))) stack.push_back(farChild);
+            if (!std::isinf(std::min(leftEntry, rightEntry))) stack.push_back(nearChild);
+        }
+        if (nearestPrimitive == UINT32_MAX) return false;
+
+        const Primitive &primitive = _primitives[nearestPrimitive];
+        result.modelName = *_entries[primitive.entry].name;
+        result.meshIndex = primitive.meshIndex;
+        result.distance = nearest;
+        return true;
+    }
+
+    float SceneBvh::hit_primitive(uint32_t primitiveIndex, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const {
+        const Primitive &primitive = _primitives[primitiveIndex];
+        const Model *model = _entries[primitive.entry].model;
+        const Mesh &mesh = model->meshes[primitive.meshIndex];
+        size_t indexCount = mesh._lods.empty() ? mesh._indices.size() : mesh._lods[0].indexCount;
+
+        float nearest = maxDistance;
+        for (auto &instance: model->instance_matrices()) {
+            // affine maps keep the ray parameter, so distances found in mesh space compare directly
+            glm::mat4 inverse = glm::inverse(instance * mesh._transforms[primitive.transformIndex]);
+            glm::vec3 localOrigin = glm::vec3(inverse * glm::vec4(origin, 1.0f));
+            glm::vec3 localDirection = glm::vec3(inverse * glm::vec4(direction, 0.0f));
+            float boxEntry = ray_box(localOrigin, inverse_direction(localDirection), mesh._boundsMin, mesh._boundsMax, nearest);
+            if (std::isinf(boxEntry)) continue;
+            if (mesh._vertices.empty()) {
+                nearest = boxEntry;
+                continue;
+            }
+
+            // Moller-Trumbore, both faces count
+            for (size_t i = 0; i + 2 < indexCount; i += 3) {
+                const glm::vec3 &p0 = mesh._vertices[mesh._indices[i]].position;
+                glm::vec3 edge1 = mesh._vertices[mesh._indices[i + 1]].position - p0;
+                glm::vec3 edge2 = mesh._vertices[mesh._indices[i + 2]].position - p0;
+                glm::vec3 p = glm::cross(localDirection, edge2);
+                float determinant = glm::dot(edge1, p);
+                if (std::abs(determinant) < 1e-12f) continue;
+
+                float inverseDeterminant = 1.0f / determinant;
+                glm::vec3 s = localOrigin - p0;
+                float u = glm::dot(s, p) * inverseDeterminant;
+                if (u < 0.0f || u > 1.0f) continue;
+                glm::vec3 q = glm::cross(s, edge1);
+                float v = glm::dot(localDirection, q) * inverseDeterminant;
+                if (v < 0.0f || u + v > 1.0f) continue;
+                float t = glm::dot(edge2, q) * inverseDeterminant;
+                if (t > 0.0f && t < nearest) {
+                    nearest = t;
+                }
+            }
+        }
+        return nearest < maxDistance ? nearest : std::numeric_limits<float>::infinity();
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <vk/types.h>
+#include <vk/model.h>
+
+namespace VkRenderer {
+    // split candidates per axis when building
+    constexpr uint32_t BVH_BINS = 16;
+    // nodes with more primitives are always split even if SAH prefers a leaf
+    constexpr uint32_t BVH_MAX_LEAF_SIZE = 8;
+    // larger subtrees are handed to the thread pool
+    constexpr uint32_t BVH_PARALLEL_THRESHOLD = 4096;
+
+    struct BvhNode {
+        glm::vec3 boundsMin;
+        uint32_t first; // primitives [first, first + count) in tree order, for inner nodes too
+        glm::vec3 boundsMax;
+        uint32_t count;
+        uint32_t left; // children are left and left + 1, 0 for leaves
+        uint32_t parent;
+    };
+
+    struct BvhStats {
+        size_t primitiveCount = 0;
+        size_t nodeCount = 0;
+        size_t builds = 0;
+        size_t refits = 0;
+        double updateTime = 0.0; // microseconds spent in the last update
+    };
+
+    struct PickResult {
+        std::string modelName;
+        size_t meshIndex;
+        float distance; // in units of the ray direction
+    };
+
+    // bounding volume hierarchy over every mesh draw in the scene, primitives are numbered like Model::draw_bounds
+    // concatenated over the models with allocated instances in map order
+    class SceneBvh {
+    public:
+        void init(ResourceHandles *resources);
+
+        // rebuild when draws were added or removed, otherwise refit the models whose bounds changed
+        void update(std::unordered_map<std::string, Model> &models);
+
+        // visible[i] is 1 if primitive i touches the inside of every plane, returns the number of nodes visited
+        size_t cull_frustum(const glm::vec4 planes[6], std::vector<uint8_t> &visible) const;
+
+        // nearest triangle along the ray, models must not have been removed since the last update
+        bool raycast(const glm::vec3 &origin, const glm::vec3 &direction, PickResult &result) const;
+
+        [[nodiscard]] BvhStats stats() const { return _stats; }
+
+    private:
+        struct ModelEntry {
+            const std::string *name;
+            Model *model;
+            uint64_t modelId;
+            uint32_t firstPrimitive;
+            uint32_t primitiveCount;
+            uint64_t boundsVersion;
+        };
+
+        struct Primitive {
+            uint32_t entry;
+            uint32_t meshIndex;
+            uint32_t transformIndex;
+        };
+
+        ResourceHandles *_resources;
+        std::vector<ModelEntry> _entries;
+        std::vector<Primitive> _primitives;
+        std::vector<BvhNode> _nodes;
+        // tree order to primitive index and back
+        std::vector<uint32_t> _order;
+        std::vector<uint32_t> _slots;
+        // bounds in tree order, components split for culling::frustum_cull
+        std::vector<float> _centerX;
+        std::vector<float> _centerY;
+        std::vector<float> _centerZ;
+        std::vector<float> _extentX;
+        std::vector<float> _extentY;
+        std::vector<float> _extentZ;
+        std::vector<float> _radius;
+        std::vector<uint32_t> _leaves;
+        BvhStats _stats;
+
+        // set on nodes queued for a refit
+        std::vector<uint8_t> _refitMarks;
+
+        // build state, bounds by primitive index
+        std::vector<DrawBounds> _buildBounds;
+        std::atomic<uint32_t> _nodeCount{0};
+        std::mutex _buildMutex;
+        std::condition_variable _buildCondition;
+        uint32_t _pendingJobs = 0;
+
+        void build();
+
+        void build_node(uint32_t nodeIndex, uint32_t first, uint32_t count);
+
+        void finish_job();
+
+        void set_bounds(uint32_t slot, const DrawBounds &bounds);
+
+        void refit(ModelEntry &entry, const std::vector<DrawBounds> &bounds);
+
+        [[nodiscard]] float hit_primitive(uint32_t primitive, const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance) const;
+    };
+}
@@ -1,16 +1,16 @@
-#pragma once
-
-#include <vulkan/vulkan.h>
-
-namespace VkRenderer {
-#define VK_CHECK(x)                                                    \
-    do                                                                 \
-    {                                                                  \
-        VkResult err = x;                                              \
-        if (err)                                                       \
-        {                                                              \
-            std::cout <<"Detected Vulkan error: " << err << std::endl; \
-            abort();                                                   \
-        }                                                              \
-    } while (0)
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace VkRenderer {
+#define VK_CHECK(x)                                                    \
+    do                                                                 \
+    {                                                                  \
+        VkResult err = x;                                              \
+        if (err)                                                       \
+        {                                                              \
+            std::cout <<"Detected Vulkan error: " << err << std::endl; \
+            abort();                                                   \
+        }                                                              \
+    } while (0)
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include <iostream>
+#include <algorithm>
+#include <vk/check.h>
+#include <vk/info.h>
+#include <vk/utils.h>
+#include <vk/pipeline.h>
+#include <vk/mipmap.h>
+
+#include "depth_pyramid.h"
+
+namespace VkRenderer {
+    constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+
+    void DepthPyramid::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        // the largest powers of two that fit, so every later level halves exactly
+        _width = 1;
+        while (_width * 2 <= _resources->windowExtent.width) _width *= 2;
+        _height = 1;
+        while (_height * 2 <= _resources->windowExtent.height) _height *= 2;
+        _levelCount = VkRenderer::mipmap::level_count(_width, _height);
+
+        VkExtent3D extent = {_width, _height, 1};
+        VkImageCreateInfo imageInfo = VkRenderer::info::image_create_info(VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, extent,
+                                                                          _levelCount);
+        VmaAllocationCreateInfo allocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_GPU_ONLY, VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT));
+        VK_CHECK(vmaCreateImage(_resources->allocator, &imageInfo, &allocInfo, &_image._image, &_image._allocation, nullptr));
+
+        VkImageViewCreateInfo viewInfo = VkRenderer::info::imageview_create_info(VK_FORMAT_R32_SFLOAT, _image._image, VK_IMAGE_ASPECT_COLOR_BIT, _levelCount);
+        VK_CHECK(vkCreateImageView(_resources->device, &viewInfo, nullptr, &_view));
+        _levelViews.resize(_levelCount);
+        for (uint32_t level = 0; level < _levelCount; level++) {
+            VkImageViewCreateInfo levelInfo = VkRenderer::info::imageview_create_info(VK_FORMAT_R32_SFLOAT, _image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+            levelInfo.subresourceRange.baseMipLevel = level;
+            VK_CHECK(vkCreateImageView(_resources->device, &levelInfo, nullptr, &_levelViews[level]));
+        }
+
+        // only read with texelFetch, the filter is never used
+        VkSamplerCreateInfo samplerInfo = VkRenderer::info::sampler_create_info(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+        _sampler = _resources->samplerCache->create_sampler(&samplerInfo);
+
+        // source level, destination level
+        VkDescriptorSetLayoutBinding bindings[2];
+        bindings[0] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+        bindings[1] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = VkRenderer::info::descriptor_set_layout_create_info(2, bindings, 0);
+        VkDescriptorSetLayout setLayout = _resources->descriptorLayoutCache->create_descriptor_layout(&setLayoutInfo);
+
+        VkPushConstantRange pushConstant;
+        pushConstant.offset = 0;
+        pushConstant.size = sizeof(ReducePushConstant);
+        pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = VkRenderer::info::pipeline_layout_create_info();
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        VK_CHECK(vkCreatePipelineLayout(_resources->device, &pipelineLayoutInfo, nullptr, &_pipelineLayout));
+
+        VkShaderModule shader;
+        if (!VkRenderer::utils::load_shader_module(_resources->device, "../shaders/depth_pyramid.comp.spv", &shader)) {
+            std::cout << "Error building depth pyramid shader module" << std::endl;
+        }
+        _pipeline = VkRenderer::pipeline::build_compute_pipeline(_resources->device, shader, _pipelineLayout);
+        vkDestroyShaderModule(_resources->device, shader, nullptr);
+
+        // the layout never changes after this
+        VkRenderer::utils::immediate_submit(_resources, [&](VkCommandBuffer cmd) {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = _image._image;
+            barrier.subresourceRange = viewInfo.subresourceRange;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        });
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    void DepthPyramid::build(VkCommandBuffer cmd, VkRenderer::descriptor::Allocator *descriptorAllocator) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = _image._image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = _levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        // the previous build and the occlusion tests that read it come first
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        glm::ivec2 sourceSize(static_cast<int>(_resources->windowExtent.width), static_cast<int>(_resources->windowExtent.height));
+        for (uint32_t level = 0; level < _levelCount; level++) {
+            // level 0 reduces the depth attachment, every other level the one above it
+            VkDescriptorImageInfo sourceInfo;
+            sourceInfo.sampler = _sampler;
+            sourceInfo.imageView = level == 0 ? _resources->depthImageView : _view;
+            sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+            VkDescriptorImageInfo destinationInfo;
+            destinationInfo.sampler = VK_NULL_HANDLE;
+            destinationInfo.imageView = _levelViews[level];
+            destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+            VkDescriptorSet reduceSet;
+            VkRenderer::descriptor::Builder::begin(_resources->descriptorLayoutCache, descriptorAllocator)
+                    .bind_image(0, &sourceInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                    .bind_image(1, &destinationInfo, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+                    .build(reduceSet);
+
+            ReducePushConstant constant{};
+            constant.sourceSize = sourceSize;
+            constant.destinationSize = glm::ivec2(static_cast<int>(std::max(_width >> level, 1u)), static_cast<int>(std::max(_height >> level, 1u)));
+            constant.sourceLevel = level == 0 ? 0 : static_cast<int32_t>(level - 1);
+
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &reduceSet, 0, nullptr);
+            vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstant), &constant);
+            vkCmdDispatch(cmd, (constant.destinationSize.x + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+                          (constant.destinationSize.y + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+
+            // the next level reads this one, the last one is read by the occlusion tests
+            barrier.subresourceRange.baseMipLevel = level;
+            barrier.subresourceRange.levelCount = 1;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            sourceSize = constant.destinationSize;
+        }
+    }
+
+    VkDescriptorImageInfo DepthPyramid::image_info() const {
+        VkDescriptorImageInfo info;
+        info.sampler = _sampler;
+        info.imageView = _view;
+        info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        return info;
+    }
+
+    void DepthPyramid::cleanup() {
+        vkDestroyPipeline(_resources->device, _pipeline, nullptr);
+        vkDestroyPipelineLayout(_resources->device, _pipelineLayout, nullptr);
+        for (VkImageView view: _levelViews) {
+            vkDestroyImageView(_resources->device, view, nullptr);
+        }
+        vkDestroyImageView(_resources->device, _view, nullptr);
+        vmaDestroyImage(_resources->allocator, _image._image, _image._allocation);
+    }
+}
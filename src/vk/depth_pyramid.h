@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <vk/types.h>
+
+namespace VkRenderer {
+    // farthest depth of the depth attachment over ever larger footprints, halving down to 1x1 for occlusion tests,
+    // level 0 is the window size rounded down to powers of two and every level stays in VK_IMAGE_LAYOUT_GENERAL
+    class DepthPyramid {
+    public:
+        void init(ResourceHandles *resources);
+
+        // record the reduction, the depth attachment must be in DEPTH_STENCIL_READ_ONLY_OPTIMAL with its writes visible to compute,
+        // the whole chain can be read by compute shaders afterwards
+        void build(VkCommandBuffer cmd, VkRenderer::descriptor::Allocator *descriptorAllocator);
+
+        // every level through one view, for texelFetch
+        [[nodiscard]] VkDescriptorImageInfo image_info() const;
+
+        [[nodiscard]] glm::vec2 size() const { return {static_cast<float>(_width), static_cast<float>(_height)}; }
+
+    private:
+        // matches the push constants of depth_pyramid.comp
+        struct ReducePushConstant {
+            glm::ivec2 sourceSize;
+            glm::ivec2 destinationSize;
+            int32_t sourceLevel;
+        };
+
+        ResourceHandles *_resources;
+        AllocatedImage _image;
+        VkImageView _view;
+        std::vector<VkImageView> _levelViews;
+        uint32_t _width;
+        uint32_t _height;
+        uint32_t _levelCount;
+        VkSampler _sampler;
+        VkPipelineLayout _pipelineLayout;
+        VkPipeline _pipeline;
+
+        void cleanup();
+    };
+}
@@ -1,98 +1,134 @@
-#pragma once
-
-#include <unordered_map>
-#include <vector>
-#include <vulkan/vulkan.h>
-
-namespace VkRenderer::descriptor {
-    class Allocator {
-    public:
-        struct PoolSizes {
-            std::vector<std::pair<VkDescriptorType, float>> sizes = {
-                    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
-                    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          4.0f},
-                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f},
-                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         2.0f},
-                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
-                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
-                    {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   1.0f},
-                    {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   1.0f},
-                    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.0f},
-                    {VK_DESCRIPTOR_TYPE_SAMPLER,                0.5f},
-                    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       0.5f}
-            };
-        };
-
-        VkDevice device;
-
-        void init(VkDevice newDevice);
-
-        bool allocate(VkDescriptorSet *set, VkDescriptorSetLayout layout);
-
-        void reset_pools();
-
-        void cleanup();
-
-    private:
-        PoolSizes descriptorSizes;
-        std::vector<VkDescriptorPool> usedPools;
-        std::vector<VkDescriptorPool> freePools;
-        VkDescriptorPool currentPool{VK_NULL_HANDLE};
-
-        VkDescriptorPool create_pool(int count, VkDescriptorPoolCreateFlags flags);
-
-        VkDescriptorPool grab_pool();
-    };
-
-    class LayoutCache {
-    public:
-        struct LayoutInfo {
-            std::vector<VkDescriptorSetLayoutBinding> bindings;
-
-            bool operator==(const LayoutInfo &other) const;
-
-            [[nodiscard]] size_t hash() const;
-        };
-
-        void init(VkDevice newDevice);
-
-        VkDescriptorSetLayout create_descriptor_layout(VkDescriptorSetLayoutCreateInfo *info);
-
-        void cleanup();
-
-    private:
-        struct LayoutHash {
-            size_t operator()(const LayoutInfo &k) const {
-                return k.hash();
-            }
-        };
-
-        std::unordered_map<LayoutInfo, VkDescriptorSetLayout, LayoutHash> layoutCache;
-        VkDevice device;
-    };
-
-    class Builder {
-    public:
-        static Builder begin(LayoutCache *layoutCache, Allocator *allocator);
-
-        Builder &bind_buffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo, VkDescriptorType type, VkShaderStageFlags stageFlags);
-
-        Builder &bind_image(uint32_t binding, VkDescriptorImageInfo *imageInfo, VkDescriptorType type, VkShaderStageFlags stageFlags);
-
-        bool build(VkDescriptorSet &set, VkDescriptorSetLayout &layout);
-
-        bool build(VkDescriptorSet &set);
-
-    private:
-        std::vector<VkWriteDescriptorSet> writes;
-        std::vector<VkDescriptorSetLayoutBinding> bindings;
-        LayoutCache *cache;
-        Allocator *alloc;
-    };
-
-    VkDescriptorSetLayoutBinding descriptor_set_layout_binding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
-
-    VkWriteDescriptorSet write_descriptor_buffer(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo *bufferInfo, uint32_t binding);
-
-    VkWriteDescriptorSet write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo *imageInfo, uint32_t binding);
-}
+#pragma once
+
+#include <unordered_map>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace VkRenderer::descriptor {
+    class Allocator {
+    public:
+        struct PoolSizes {
+            std::vector<std::pair<VkDescriptorType, float>> sizes = {
+                    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+                    {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          4.0f},
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         2.0f},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         2.0f},
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   1.0f},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   1.0f},
+                    {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          1.0f},
+                    {VK_DESCRIPTOR_TYPE_SAMPLER,                0.5f},
+                    {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,       0.5f}
+            };
+        };
+
+        VkDevice device;
+
+        void init(VkDevice newDevice);
+
+        bool allocate(VkDescriptorSet *set, VkDescriptorSetLayout layout);
+
+        void reset_pools();
+
+        void cleanup();
+
+    private:
+        PoolSizes descriptorSizes;
+        std::vector<VkDescriptorPool> usedPools;
+        std::vector<VkDescriptorPool> freePools;
+        VkDescriptorPool currentPool{VK_NULL_HANDLE};
+
+        VkDescriptorPool create_pool(int count, VkDescriptorPoolCreateFlags flags);
+
+        VkDescriptorPool grab_pool();
+    };
+
+    // one VkSampler per distinct sampler state, shared by every texture and set layout that asks for it
+    class SamplerCache {
+    public:
+        struct SamplerInfo {
+            VkSamplerCreateInfo createInfo;
+
+            bool operator==(const SamplerInfo &other) const;
+
+            [[nodiscard]] size_t hash() const;
+        };
+
+        void init(VkDevice newDevice);
+
+        VkSampler create_sampler(const VkSamplerCreateInfo *info);
+
+        [[nodiscard]] size_t sampler_count();
+
+        void cleanup();
+
+    private:
+        struct SamplerHash {
+            size_t operator()(const SamplerInfo &k) const {
+                return k.hash();
+            }
+        };
+
+        std::unordered_map<SamplerInfo, VkSampler, SamplerHash> samplerCache;
+        std::mutex cacheMutex;
+        VkDevice device;
+    };
+
+    class LayoutCache {
+    public:
+        struct LayoutInfo {
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            // handles behind each binding's pImmutableSamplers, the pointers in bindings are not kept
+            std::vector<std::vector<VkSampler>> immutableSamplers;
+
+            bool operator==(const LayoutInfo &other) const;
+
+            [[nodiscard]] size_t hash() const;
+        };
+
+        void init(VkDevice newDevice);
+
+        VkDescriptorSetLayout create_descriptor_layout(VkDescriptorSetLayoutCreateInfo *info);
+
+        void cleanup();
+
+    private:
+        struct LayoutHash {
+            size_t operator()(const LayoutInfo &k) const {
+                return k.hash();
+            }
+        };
+
+        std::unordered_map<LayoutInfo, VkDescriptorSetLayout, LayoutHash> layoutCache;
+        // shared between the render loop and the model loader thread
+        std::mutex cacheMutex;
+        VkDevice device;
+    };
+
+    class Builder {
+    public:
+        static Builder begin(LayoutCache *layoutCache, Allocator *allocator);
+
+        Builder &bind_buffer(uint32_t binding, VkDescriptorBufferInfo *bufferInfo, VkDescriptorType type, VkShaderStageFlags stageFlags);
+
+        Builder &bind_image(uint32_t binding, VkDescriptorImageInfo *imageInfo, VkDescriptorType type, VkShaderStageFlags stageFlags);
+
+        bool build(VkDescriptorSet &set, VkDescriptorSetLayout &layout);
+
+        bool build(VkDescriptorSet &set);
+
+    private:
+        std::vector<VkWriteDescriptorSet> writes;
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        LayoutCache *cache;
+        Allocator *alloc;
+    };
+
+    VkDescriptorSetLayoutBinding descriptor_set_layout_binding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
+
+    VkWriteDescriptorSet write_descriptor_buffer(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo *bufferInfo, uint32_t binding);
+
+    VkWriteDescriptorSet write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo *imageInfo, uint32_t binding);
+}
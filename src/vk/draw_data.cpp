@@ -0,0 +1,46 @@
+#include <vk/utils.h>
+
+#include "draw_data.h"
+
+namespace VkRenderer {
+    void DrawDataBuffer::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        // written sequentially while recording, never read back
+        for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
+            _buffers[i] = VkRenderer::utils::create_buffer(_resources->allocator, DRAW_DATA_CAPACITY * sizeof(GPUDrawData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
+            void *data;
+            vmaMapMemory(_resources->allocator, _buffers[i]._allocation, &data);
+            _mapped[i] = static_cast<GPUDrawData *>(data);
+        }
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    void DrawDataBuffer::begin_frame(uint32_t frameIndex) {
+        _frameIndex = frameIndex;
+        _count = 0;
+    }
+
+    uint32_t DrawDataBuffer::add(const GPUDrawData &data) {
+        if (_count == DRAW_DATA_CAPACITY) return DRAW_DATA_FULL;
+
+        _mapped[_frameIndex][_count] = data;
+        return _count++;
+    }
+
+    void DrawDataBuffer::end_frame() {
+        if (_count == 0) return;
+        vmaFlushAllocation(_resources->allocator, _buffers[_frameIndex]._allocation, 0, _count * sizeof(GPUDrawData));
+    }
+
+    void DrawDataBuffer::cleanup() {
+        for (auto &buffer: _buffers) {
+            vmaUnmapMemory(_resources->allocator, buffer._allocation);
+            vmaDestroyBuffer(_resources->allocator, buffer._buffer, buffer._allocation);
+        }
+    }
+}
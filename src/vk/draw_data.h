@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vk/types.h>
+
+namespace VkRenderer {
+    // draws recorded per frame
+    constexpr uint32_t DRAW_DATA_CAPACITY = 64 * 1024;
+    constexpr uint32_t DRAW_DATA_FULL = UINT32_MAX;
+
+    // matches DrawData in the mesh vertex shaders
+    struct GPUDrawData {
+        glm::mat4 matrix; // mesh within its model
+        uint32_t instanceOffset; // first instance buffer entry, the shader adds gl_InstanceIndex - gl_BaseInstance
+        uint32_t textureIndex; // TextureTable slot, only read by bindless materials
+        uint32_t padding[2];
+    };
+
+    // per-draw data of the frame being recorded, draws pass their index as firstInstance and shaders read it with gl_BaseInstance
+    // each frame in flight has its own persistently mapped copy, refilled every frame
+    class DrawDataBuffer {
+    public:
+        void init(ResourceHandles *resources);
+
+        // the frame's fence must have been waited on
+        void begin_frame(uint32_t frameIndex);
+
+        // index to draw with, DRAW_DATA_FULL once the frame's copy is full
+        uint32_t add(const GPUDrawData &data);
+
+        // make the frame's writes visible before it's submitted
+        void end_frame();
+
+        [[nodiscard]] VkBuffer buffer(uint32_t frameIndex) const { return _buffers[frameIndex]._buffer; }
+
+        [[nodiscard]] uint32_t count() const { return _count; }
+
+    private:
+        ResourceHandles *_resources;
+        AllocatedBuffer _buffers[FRAME_OVERLAP];
+        GPUDrawData *_mapped[FRAME_OVERLAP];
+        uint32_t _frameIndex = 0;
+        uint32_t _count = 0;
+
+        void cleanup();
+    };
+}
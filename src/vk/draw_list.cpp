@@ -0,0 +1,129 @@
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+#include <vk/geometry.h>
+
+#include "draw_list.h"
+
+namespace VkRenderer {
+    void DrawList::init(ResourceHandles *resources) {
+        _resources = resources;
+    }
+
+    void DrawList::clear() {
+        _draws.clear();
+        _keys.clear();
+        _pipelines.clear();
+        _descriptors.clear();
+    }
+
+    bool DrawList::add(const Material *material, VkDescriptorSet descriptor, VkIndexType indexType, const VkDrawIndexedIndirectCommand &command, float depth) {
+        if (_draws.size() == (size_t{1} << DRAW_KEY_DRAW_BITS)) return false;
+
+        // positive floats order like their bits, the low mantissa bits are dropped
+        uint32_t depthBits;
+        float clamped = std::max(depth, 0.0f);
+        memcpy(&depthBits, &clamped, sizeof(depthBits));
+        depthBits >>= 32 - DRAW_KEY_DEPTH_BITS;
+
+        uint64_t key = pipeline_id(material->pipeline);
+        key = (key << DRAW_KEY_DESCRIPTOR_BITS) | descriptor_id(descriptor);
+        key = (key << DRAW_KEY_GEOMETRY_BITS) | (indexType == VK_INDEX_TYPE_UINT32 ? 1u : 0u);
+        key = (key << DRAW_KEY_DEPTH_BITS) | depthBits;
+        key = (key << DRAW_KEY_DRAW_BITS) | _draws.size();
+        _keys.push_back(key);
+        _draws.push_back({material, descriptor, indexType, command});
+        return true;
+    }
+
+    void DrawList::submit(VkCommandBuffer cmd) {
+        _stats = {};
+        _stats.drawCount = _draws.size();
+
+        auto sortStart = std::chrono::high_resolution_clock::now();
+        VkRenderer::sorting::radix_sort(_keys, _sortScratch);
+        auto sortEnd = std::chrono::high_resolution_clock::now();
+        _stats.sortTime = std::chrono::duration<double, std::micro>(sortEnd - sortStart).count();
+
+        // ids can saturate, so binds compare the actual state rather than key fields
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        VkDescriptorSet boundDescriptor = VK_NULL_HANDLE;
+        for (uint64_t key: _keys) {
+            const Draw &draw = _draws[key & ((uint64_t{1} << DRAW_KEY_DRAW_BITS) - 1)];
+            if (draw.material->pipeline != boundPipeline) {
+                boundPipeline = draw.material->pipeline;
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+                _stats.pipelineBinds++;
+            }
+            // every material's layout is compatible, so set 1 survives pipeline changes
+            if (draw.descriptor != boundDescriptor) {
+                boundDescriptor = draw.descriptor;
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.material->pipelineLayout, 1, 1, &boundDescriptor, 0, nullptr);
+                _stats.descriptorBinds++;
+            }
+            if (_resources->geometryBuffer->bind_index_type(cmd, draw.indexType)) {
+                _stats.indexBinds++;
+            }
+
+            const VkDrawIndexedIndirectCommand &command = draw.command;
+            vkCmdDrawIndexed(cmd, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+        }
+    }
+
+    uint32_t DrawList::pipeline_id(VkPipeline pipeline) {
+        // a handful of pipelines, a linear search beats hashing
+        for (size_t i = 0; i < _pipelines.size(); i++) {
+            if (_pipelines[i] == pipeline) return static_cast<uint32_t>(std::min<size_t>(i, (size_t{1} << DRAW_KEY_PIPELINE_BITS) - 1));
+        }
+        _pipelines.push_back(pipeline);
+        return static_cast<uint32_t>(std::min<size_t>(_pipelines.size() - 1, (size_t{1} << DRAW_KEY_PIPELINE_BITS) - 1));
+    }
+
+    uint32_t DrawList::descriptor_id(VkDescriptorSet descriptor) {
+        // one texture set per material, too many for a linear search, every repeat must get the same id to sort together
+        auto id = static_cast<uint32_t>(std::min<size_t>(_descriptors.size(), (size_t{1} << DRAW_KEY_DESCRIPTOR_BITS) - 1));
+        return _descriptors.emplace(descriptor, id).first->second;
+    }
+}
+
+namespace VkRenderer::sorting {
+    void radix_sort(std::vector<uint64_t> &keys, std::vector<uint64_t> &scratch) {
+        constexpr int DIGITS = 8;
+        constexpr int BUCKETS = 256;
+        size_t count = keys.size();
+        if (count < 2) return;
+
+        // every digit's histogram in one read of the keys
+        size_t histograms[DIGITS][BUCKETS] = {};
+        for (uint64_t key: keys) {
+            for (int digit = 0; digit < DIGITS; digit++) {
+                histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+            }
+        }
+
+        scratch.resize(count);
+        uint64_t *source = keys.data();
+        uint64_t *destination = scratch.data();
+        for (int digit = 0; digit < DIGITS; digit++) {
+            size_t *histogram = histograms[digit];
+            // high digits are mostly shared, a pass would only copy the keys
+            if (histogram[(source[0] >> (digit * 8)) & 0xFF] == count) continue;
+
+            size_t offset = 0;
+            for (int bucket = 0; bucket < BUCKETS; bucket++) {
+                size_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < count; i++) {
+                uint64_t key = source[i];
+                destination[histogram[(key >> (digit * 8)) & 0xFF]++] = key;
+            }
+            std::swap(source, destination);
+        }
+
+        if (source != keys.data()) {
+            memcpy(keys.data(), source, count * sizeof(uint64_t));
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <vk/types.h>
+#include <vk/material.h>
+#include <vk/draw_data.h>
+
+namespace VkRenderer {
+    // key fields from the most significant bit down, draws sort by state first and front to back within it,
+    // the lowest bits hold the draw's position in the list so keys sort on their own
+    constexpr uint32_t DRAW_KEY_PIPELINE_BITS = 8;
+    constexpr uint32_t DRAW_KEY_DESCRIPTOR_BITS = 16;
+    constexpr uint32_t DRAW_KEY_GEOMETRY_BITS = 2;
+    constexpr uint32_t DRAW_KEY_DEPTH_BITS = 22;
+    constexpr uint32_t DRAW_KEY_DRAW_BITS = 16;
+    static_assert(DRAW_KEY_PIPELINE_BITS + DRAW_KEY_DESCRIPTOR_BITS + DRAW_KEY_GEOMETRY_BITS + DRAW_KEY_DEPTH_BITS + DRAW_KEY_DRAW_BITS == 64);
+    // every draw has an entry in the DrawDataBuffer, so it can't hold more
+    static_assert((1u << DRAW_KEY_DRAW_BITS) >= DRAW_DATA_CAPACITY);
+
+    struct DrawListStats {
+        size_t drawCount = 0;
+        size_t pipelineBinds = 0;
+        size_t descriptorBinds = 0;
+        size_t indexBinds = 0;
+        double sortTime = 0.0; // microseconds
+    };
+
+    // draws of the frame collected with a 64-bit sort key, submitted in key order so consecutive draws share state
+    // and redundant binds are skipped, all materials are opaque so draws in the same state go front to back for early-Z
+    class DrawList {
+    public:
+        void init(ResourceHandles *resources);
+
+        void clear();
+
+        // descriptor is bound at set 1, the draw's data must already be in the DrawDataBuffer, depth is the distance from the camera,
+        // false once the list is full
+        bool add(const Material *material, VkDescriptorSet descriptor, VkIndexType indexType, const VkDrawIndexedIndirectCommand &command, float depth);
+
+        // sort and record every draw, the geometry buffers and the global set must be bound
+        void submit(VkCommandBuffer cmd);
+
+        [[nodiscard]] DrawListStats stats() const { return _stats; }
+
+    private:
+        struct Draw {
+            const Material *material;
+            VkDescriptorSet descriptor;
+            VkIndexType indexType;
+            VkDrawIndexedIndirectCommand command;
+        };
+
+        ResourceHandles *_resources;
+        std::vector<Draw> _draws;
+        std::vector<uint64_t> _keys;
+        std::vector<uint64_t> _sortScratch;
+        // key ids of this frame's states, in first seen order
+        std::vector<VkPipeline> _pipelines;
+        std::unordered_map<VkDescriptorSet, uint32_t> _descriptors;
+        DrawListStats _stats;
+
+        uint32_t pipeline_id(VkPipeline pipeline);
+
+        uint32_t descriptor_id(VkDescriptorSet descriptor);
+    };
+}
+
+namespace VkRenderer::sorting {
+    // least significant digit first, 8 bits at a time, digits every key shares are skipped, scratch is resized to match keys
+    void radix_sort(std::vector<uint64_t> &keys, std::vector<uint64_t> &scratch);
+}
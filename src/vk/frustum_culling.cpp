@@ -0,0 +1,105 @@
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <vk/utils.h>
+#include <vk/bvh.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VK_RENDERER_SSE
+#include <immintrin.h>
+#endif
+
+#include "frustum_culling.h"
+
+namespace VkRenderer {
+    void FrustumCuller::cull(std::unordered_map<std::string, Model> &models, const SceneBvh &bvh, const glm::mat4 &viewproj, bool enabled) {
+        auto start = std::chrono::high_resolution_clock::now();
+        _stats = {};
+
+        // subtrees entirely inside or outside are decided without looking at their draws
+        size_t count = bvh.stats().primitiveCount;
+        if (enabled) {
+            glm::vec4 planes[6];
+            VkRenderer::utils::frustum_planes(viewproj, planes);
+            _stats.visitedNodes = bvh.cull_frustum(planes, _visible);
+        } else {
+            _visible.assign(count, 1);
+        }
+
+        // hand the results back to the meshes, draws are numbered like the bvh's primitives
+        size_t drawIndex = 0;
+        for (auto &it: models) {
+            Model &model = it.second;
+            if (!model.instances_allocated()) continue;
+
+            for (auto &mesh: model.meshes) {
+                if (drawIndex + mesh._transforms.size() > count) {
+                    mesh._visible.clear();
+                    continue;
+                }
+                mesh._visible.assign(_visible.begin() + static_cast<std::ptrdiff_t>(drawIndex),
+                                     _visible.begin() + static_cast<std::ptrdiff_t>(drawIndex + mesh._transforms.size()));
+                drawIndex += mesh._transforms.size();
+            }
+        }
+
+        _stats.drawCount = count;
+        _stats.visibleCount = static_cast<size_t>(std::count(_visible.begin(), _visible.end(), 1));
+        auto end = std::chrono::high_resolution_clock::now();
+        _stats.cullTime = std::chrono::duration<double, std::micro>(end - start).count();
+    }
+}
+
+namespace VkRenderer::culling {
+    void frustum_cull(const glm::vec4 planes[6], const float *centerX, const float *centerY, const float *centerZ, const float *extentX, const float *extentY,
+                      const float *extentZ, const float *radius, size_t count, uint8_t *visible) {
+        size_t i = 0;
+
+#ifdef VK_RENDERER_SSE
+        // four draws at a time, a draw is outside once its center is further than its projected size behind any plane
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+        for (int p = 0; p < 6; p++) {
+            planeX[p] = _mm_set1_ps(planes[p].x);
+            planeY[p] = _mm_set1_ps(planes[p].y);
+            planeZ[p] = _mm_set1_ps(planes[p].z);
+            planeW[p] = _mm_set1_ps(planes[p].w);
+            absX[p] = _mm_set1_ps(std::abs(planes[p].x));
+            absY[p] = _mm_set1_ps(std::abs(planes[p].y));
+            absZ[p] = _mm_set1_ps(std::abs(planes[p].z));
+        }
+        for (; i + 4 <= count; i += 4) {
+            __m128 cx = _mm_loadu_ps(centerX + i);
+            __m128 cy = _mm_loadu_ps(centerY + i);
+            __m128 cz = _mm_loadu_ps(centerZ + i);
+            __m128 ex = _mm_loadu_ps(extentX + i);
+            __m128 ey = _mm_loadu_ps(extentY + i);
+            __m128 ez = _mm_loadu_ps(extentZ + i);
+            __m128 r = _mm_loadu_ps(radius + i);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+                // both volumes contain the draw, so the smaller of the box's and the sphere's reach is still conservative
+                __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absX[p], ex), _mm_mul_ps(absY[p], ey)), _mm_mul_ps(absZ[p], ez));
+                reach = _mm_min_ps(reach, r);
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(inside);
+            visible[i] = static_cast<uint8_t>(mask & 1);
+            visible[i + 1] = static_cast<uint8_t>((mask >> 1) & 1);
+            visible[i + 2] = static_cast<uint8_t>((mask >> 2) & 1);
+            visible[i + 3] = static_cast<uint8_t>((mask >> 3) & 1);
+        }
+#endif
+
+        // remainder, or everything without SSE
+        for (; i < count; i++) {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; p++) {
+                float distance = planes[p].x * centerX[i] + planes[p].y * centerY[i] + planes[p].z * centerZ[i] + planes[p].w;
+                float reach = std::abs(planes[p].x) * extentX[i] + std::abs(planes[p].y) * extentY[i] + std::abs(planes[p].z) * extentZ[i];
+                inside = distance + std::min(reach, radius[i]) >= 0.0f;
+            }
+            visible[i] = inside;
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <vk/model.h>
+
+namespace VkRenderer {
+    class SceneBvh;
+}
+
+namespace VkRenderer {
+    struct FrustumStats {
+        size_t drawCount = 0;
+        size_t visibleCount = 0;
+        size_t visitedNodes = 0;
+        double cullTime = 0.0; // microseconds
+    };
+
+    // walks the scene bvh against the camera frustum on the CPU and marks the mesh draws outside it,
+    // instanced models are culled as a whole since their instances share draw calls
+    class FrustumCuller {
+    public:
+        // bvh must have been updated with models this frame, disabled marks every draw visible
+        void cull(std::unordered_map<std::string, Model> &models, const SceneBvh &bvh, const glm::mat4 &viewproj, bool enabled);
+
+        [[nodiscard]] FrustumStats stats() const { return _stats; }
+
+    private:
+        std::vector<uint8_t> _visible;
+        FrustumStats _stats;
+    };
+}
+
+namespace VkRenderer::culling {
+    // bounds given as separate component arrays, box center and half extents with a bounding sphere around the same center,
+    // visible[i] is 1 if draw i touches the inside of every plane, planes as from utils::frustum_planes
+    void frustum_cull(const glm::vec4 planes[6], const float *centerX, const float *centerY, const float *centerZ, const float *extentX, const float *extentY,
+                      const float *extentZ, const float *radius, size_t count, uint8_t *visible);
+}
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <cstring>
+#include <vk/check.h>
+#include <vk/info.h>
+
+#include "geometry.h"
+
+namespace VkRenderer {
+    void RangeAllocator::init(VkDeviceSize capacity) {
+        _capacity = capacity;
+        _used = 0;
+        _freeRanges.clear();
+        _freeRanges[0] = capacity;
+    }
+
+    bool RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, GeometryRange &range) {
+        if (size == 0) return false;
+
+        // smallest free range that fits once aligned
+        auto best = _freeRanges.end();
+        for (auto it = _freeRanges.begin(); it != _freeRanges.end(); it++) {
+            VkDeviceSize aligned = (it->first + alignment - 1) / alignment * alignment;
+            if (aligned + size <= it->first + it->second && (best == _freeRanges.end() || it->second < best->second)) {
+                best = it;
+            }
+        }
+        if (best == _freeRanges.end()) return false;
+
+        // split off whatever is left on either side
+        VkDeviceSize start = best->first;
+        VkDeviceSize end = best->first + best->second;
+        VkDeviceSize aligned = (start + alignment - 1) / alignment * alignment;
+        _freeRanges.erase(best);
+        if (aligned > start) {
+            _freeRanges[start] = aligned - start;
+        }
+        if (aligned + size < end) {
+            _freeRanges[aligned + size] = end - aligned - size;
+        }
+
+        range.offset = aligned;
+        range.size = size;
+        _used += size;
+        return true;
+    }
+
+    void RangeAllocator::free(const GeometryRange &range) {
+        if (range.size == 0) return;
+
+        VkDeviceSize offset = range.offset;
+        VkDeviceSize size = range.size;
+        _used -= size;
+
+        // merge with the following range
+        auto next = _freeRanges.lower_bound(offset);
+        if (next != _freeRanges.end() && next->first == offset + size) {
+            size += next->second;
+            next = _freeRanges.erase(next);
+        }
+
+        // and the preceding one
+        if (next != _freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+        _freeRanges[offset] = size;
+    }
+
+    void GeometryBuffer::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        _vertexData = create_buffer(_vertexBuffer, GEOMETRY_VERTEX_CAPACITY, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+        // meshlet culling reads indices from compute
+        _indexData = create_buffer(_indexBuffer, GEOMETRY_INDEX_CAPACITY, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        _meshletData = create_buffer(_meshletBuffer, GEOMETRY_MESHLET_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        std::cout << "Geometry buffers written in place: vertices " << (_vertexData != nullptr) << ", indices " << (_indexData != nullptr) << ", meshlets "
+                  << (_meshletData != nullptr) << std::endl;
+
+        _vertexAllocator.init(GEOMETRY_VERTEX_CAPACITY);
+        _indexAllocator.init(GEOMETRY_INDEX_CAPACITY);
+        _meshletAllocator.init(GEOMETRY_MESHLET_CAPACITY);
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    bool GeometryBuffer::upload_vertices(UploadBatcher *uploader, const void *data, VkDeviceSize size, VkDeviceSize stride, GeometryRange &range) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_vertexAllocator.allocate(size, stride, range)) {
+                std::cout << "Geometry vertex buffer is full, " << size << " bytes requested" << std::endl;
+                range = {};
+                return false;
+            }
+        }
+
+        write(uploader, _vertexBuffer, _vertexData, range.offset, data, size, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        return true;
+    }
+
+    bool GeometryBuffer::upload_indices(UploadBatcher *uploader, const void *data, VkDeviceSize size, VkDeviceSize indexSize, GeometryRange &range) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_indexAllocator.allocate(size, indexSize, range)) {
+                std::cout << "Geometry index buffer is full, " << size << " bytes requested" << std::endl;
+                range = {};
+                return false;
+            }
+        }
+
+        write(uploader, _indexBuffer, _indexData, range.offset, data, size, VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+        return true;
+    }
+
+    bool GeometryBuffer::upload_meshlets(UploadBatcher *uploader, const void *data, VkDeviceSize size, VkDeviceSize meshletSize, GeometryRange &range) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_meshletAllocator.allocate(size, meshletSize, range)) {
+                std::cout << "Geometry meshlet buffer is full, " << size << " bytes requested" << std::endl;
+                range = {};
+                return false;
+            }
+        }
+
+        write(uploader, _meshletBuffer, _meshletData, range.offset, data, size, VK_ACCESS_SHADER_READ_BIT);
+        return true;
+    }
+
+    void GeometryBuffer::free(const GeometryRange &vertexRange, const GeometryRange &indexRange, const GeometryRange &meshletRange) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _vertexAllocator.free(vertexRange);
+        _indexAllocator.free(indexRange);
+        _meshletAllocator.free(meshletRange);
+    }
+
+    void GeometryBuffer::bind(VkCommandBuffer cmd) {
+        VkDeviceSize offset = 0;
+        vkCmdBindVertexBuffers(cmd, 0, 1, &_vertexBuffer._buffer, &offset);
+        vkCmdBindIndexBuffer(cmd, _indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT16);
+        _boundIndexType = VK_INDEX_TYPE_UINT16;
+    }
+
+    bool GeometryBuffer::bind_index_type(VkCommandBuffer cmd, VkIndexType indexType) {
+        if (indexType == _boundIndexType) return false;
+        vkCmdBindIndexBuffer(cmd, _indexBuffer._buffer, 0, indexType);
+        _boundIndexType = indexType;
+        return true;
+    }
+
+    GeometryStats GeometryBuffer::stats() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        GeometryStats stats;
+        stats.vertexBytes = _vertexAllocator.used();
+        stats.vertexCapacity = _vertexAllocator.capacity();
+        stats.indexBytes = _indexAllocator.used();
+        stats.indexCapacity = _indexAllocator.capacity();
+        stats.meshletBytes = _meshletAllocator.used();
+        stats.meshletCapacity = _meshletAllocator.capacity();
+        return stats;
+    }
+
+    uint8_t *GeometryBuffer::create_buffer(AllocatedBuffer &buffer, VkDeviceSize capacity, VkBufferUsageFlags usage) {
+        VkBufferCreateInfo bufferInfo = VkRenderer::info::buffer_create_info(capacity, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+        if (_resources->hostVisibleDeviceMemory) {
+            // persistently mapped device-local memory, uploads are copied straight in
+            VmaAllocationCreateInfo directAllocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_GPU_ONLY,
+                                                                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            directAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+            VmaAllocationInfo directResult;
+            if (vmaCreateBuffer(_resources->allocator, &bufferInfo, &directAllocInfo, &buffer._buffer, &buffer._allocation, &directResult) == VK_SUCCESS) {
+                return static_cast<uint8_t *>(directResult.pMappedData);
+            }
+            // small BAR heaps can't hold the buffer, fall through to staging
+        }
+
+        VmaAllocationCreateInfo allocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_GPU_ONLY, 0);
+        VK_CHECK(vmaCreateBuffer(_resources->allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr));
+        return nullptr;
+    }
+
+    void GeometryBuffer::write(UploadBatcher *uploader, const AllocatedBuffer &buffer, uint8_t *mapped, VkDeviceSize offset, const void *data, VkDeviceSize size,
+                               VkAccessFlags dstAccessMask) {
+        if (mapped == nullptr) {
+            uploader->upload_buffer(buffer._buffer, offset, data, size, dstAccessMask);
+            return;
+        }
+
+        // the range is fresh, so nothing reads it, host writes are visible to every later submission
+        memcpy(mapped + offset, data, size);
+        vmaFlushAllocation(_resources->allocator, buffer._allocation, offset, size);
+    }
+
+    void GeometryBuffer::cleanup() {
+        vmaDestroyBuffer(_resources->allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
+        vmaDestroyBuffer(_resources->allocator, _indexBuffer._buffer, _indexBuffer._allocation);
+        vmaDestroyBuffer(_resources->allocator, _meshletBuffer._buffer, _meshletBuffer._allocation);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vk/types.h>
+#include <vk/upload.h>
+
+namespace VkRenderer {
+    constexpr VkDeviceSize GEOMETRY_VERTEX_CAPACITY = 256 * 1024 * 1024;
+    constexpr VkDeviceSize GEOMETRY_INDEX_CAPACITY = 128 * 1024 * 1024;
+    constexpr VkDeviceSize GEOMETRY_MESHLET_CAPACITY = 32 * 1024 * 1024;
+
+    // bytes within one of the geometry buffers, empty if allocation failed
+    struct GeometryRange {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+    };
+
+    struct GeometryStats {
+        VkDeviceSize vertexBytes = 0;
+        VkDeviceSize vertexCapacity = 0;
+        VkDeviceSize indexBytes = 0;
+        VkDeviceSize indexCapacity = 0;
+        VkDeviceSize meshletBytes = 0;
+        VkDeviceSize meshletCapacity = 0;
+    };
+
+    // best fit free list over [0, capacity), neighbouring free ranges are merged on release
+    class RangeAllocator {
+    public:
+        void init(VkDeviceSize capacity);
+
+        // the offset is a multiple of alignment, which doesn't have to be a power of two
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, GeometryRange &range);
+
+        void free(const GeometryRange &range);
+
+        [[nodiscard]] VkDeviceSize used() const { return _used; }
+
+        [[nodiscard]] VkDeviceSize capacity() const { return _capacity; }
+
+    private:
+        VkDeviceSize _capacity = 0;
+        VkDeviceSize _used = 0;
+        // offset to size
+        std::map<VkDeviceSize, VkDeviceSize> _freeRanges;
+    };
+
+    // every mesh's vertices and indices live in one vertex buffer and one index buffer, bound once per frame
+    class GeometryBuffer {
+    public:
+        void init(ResourceHandles *resources);
+
+        // sub-allocate and write in place if the buffer is mapped, otherwise upload through uploader, vertices are aligned to stride so they can be addressed with vertexOffset
+        bool upload_vertices(UploadBatcher *uploader, const void *data, VkDeviceSize size, VkDeviceSize stride, GeometryRange &range);
+
+        // indices are aligned to indexSize so they can be addressed with firstIndex
+        bool upload_indices(UploadBatcher *uploader, const void *data, VkDeviceSize size, VkDeviceSize indexSize, GeometryRange &range);
+
+        // meshlet bounds for GPU culling, aligned to whole meshlets
+        bool upload_meshlets(UploadBatcher *uploader, const void *data, VkDeviceSize size, VkDeviceSize meshletSize, GeometryRange &range);
+
+        // the GPU must be done with the ranges
+        void free(const GeometryRange &vertexRange, const GeometryRange &indexRange, const GeometryRange &meshletRange);
+
+        // bind both buffers at offset 0, indices start out 16-bit
+        void bind(VkCommandBuffer cmd);
+
+        // rebind the index buffer if the type differs from the last one bound, true if it was rebound
+        bool bind_index_type(VkCommandBuffer cmd, VkIndexType indexType);
+
+        [[nodiscard]] GeometryStats stats();
+
+        // the index and meshlet buffers can also be read as storage buffers
+        [[nodiscard]] VkBuffer index_buffer() const { return _indexBuffer._buffer; }
+
+        [[nodiscard]] VkBuffer meshlet_buffer() const { return _meshletBuffer._buffer; }
+
+    private:
+        ResourceHandles *_resources;
+        AllocatedBuffer _vertexBuffer;
+        AllocatedBuffer _indexBuffer;
+        AllocatedBuffer _meshletBuffer;
+        // set for buffers in host-visible device memory, nullptr for buffers filled through staging
+        uint8_t *_vertexData = nullptr;
+        uint8_t *_indexData = nullptr;
+        uint8_t *_meshletData = nullptr;
+        VkIndexType _boundIndexType = VK_INDEX_TYPE_UINT16;
+
+        // models are uploaded on the loader thread and freed on the render thread
+        std::mutex _mutex;
+        RangeAllocator _vertexAllocator;
+        RangeAllocator _indexAllocator;
+        RangeAllocator _meshletAllocator;
+
+        uint8_t *create_buffer(AllocatedBuffer &buffer, VkDeviceSize capacity, VkBufferUsageFlags usage);
+
+        void write(UploadBatcher *uploader, const AllocatedBuffer &buffer, uint8_t *mapped, VkDeviceSize offset, const void *data, VkDeviceSize size,
+                   VkAccessFlags dstAccessMask);
+
+        void cleanup();
+    };
+}
@@ -0,0 +1,332 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vk/check.h>
+#include <vk/info.h>
+#include <vk/utils.h>
+#include <vk/pipeline.h>
+#include <vk/geometry.h>
+#include <vk/instance_buffer.h>
+#include <vk/draw_data.h>
+#include <vk/texture_table.h>
+
+#include "indirect_scene.h"
+
+namespace VkRenderer {
+    constexpr uint32_t INDIRECT_GROUP_SIZE = 64;
+    // largest dispatch dimension every device supports
+    constexpr uint32_t INDIRECT_MAX_GROUPS = 65535;
+
+    void IndirectScene::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        // objects, meshes, batches, instances, commands, counts
+        VkDescriptorSetLayoutBinding bindings[6];
+        for (uint32_t i = 0; i < 6; i++) {
+            bindings[i] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = VkRenderer::info::descriptor_set_layout_create_info(6, bindings, 0);
+        VkDescriptorSetLayout setLayout = _resources->descriptorLayoutCache->create_descriptor_layout(&setLayoutInfo);
+
+        VkPushConstantRange pushConstant;
+        pushConstant.offset = 0;
+        pushConstant.size = sizeof(CullPushConstant);
+        pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = VkRenderer::info::pipeline_layout_create_info();
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        VK_CHECK(vkCreatePipelineLayout(_resources->device, &pipelineLayoutInfo, nullptr, &_pipelineLayout));
+
+        VkShaderModule shader;
+        if (!VkRenderer::utils::load_shader_module(_resources->device, "../shaders/indirect_cull.comp.spv", &shader)) {
+            std::cout << "Error building indirect culling shader module" << std::endl;
+        }
+        _pipeline = VkRenderer::pipeline::build_compute_pipeline(_resources->device, shader, _pipelineLayout);
+        vkDestroyShaderModule(_resources->device, shader, nullptr);
+
+        // an extension on Vulkan 1.1, so it isn't exported by the loader
+        if (_resources->drawIndirectCount) {
+            _drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                    vkGetDeviceProcAddr(_resources->device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    void IndirectScene::cull(VkCommandBuffer cmd, uint32_t frameIndex, VkRenderer::descriptor::Allocator *descriptorAllocator,
+                             std::unordered_map<std::string, Model> &models, const glm::mat4 &viewproj, const glm::vec3 &cameraPosition) {
+        FrameResources &frame = _frames[frameIndex];
+
+        // this frame's fence has been waited on, so last use's counts are complete
+        read_results(frame);
+
+        // only the structure is compared, moving models just changes the instance matrices the shader reads
+        std::vector<ModelKey> keys;
+        keys.reserve(models.size());
+        for (auto &it: models) {
+            if (!it.second.instances_allocated()) continue;
+            keys.push_back({&it.second, it.second.id, it.second.first_instance(), it.second.instance_count(), it.second.meshes.size()});
+        }
+        if (keys != _keys || _resources->settings.bindlessTextures != _bindless) {
+            _keys = std::move(keys);
+            _bindless = _resources->settings.bindlessTextures;
+            rebuild(models);
+        }
+        if (frame.version != _version) {
+            upload(frame);
+        }
+
+        frame.batchCount = _batches.size();
+        if (_objects.empty()) return;
+
+        // counts start from zero every frame
+        vkCmdFillBuffer(cmd, frame.countBuffer._buffer, 0, _batches.size() * sizeof(uint32_t), 0);
+        VkMemoryBarrier fillBarrier = {};
+        fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        fillBarrier.pNext = nullptr;
+        fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &fillBarrier, 0, nullptr, 0, nullptr);
+
+        VkDescriptorBufferInfo objectInfo = VkRenderer::info::descriptor_buffer_info(frame.objectBuffer._buffer, 0,
+                                                                                     static_cast<uint32_t>(_objects.size() * sizeof(GPUIndirectObject)));
+        VkDescriptorBufferInfo meshInfo = VkRenderer::info::descriptor_buffer_info(frame.meshBuffer._buffer, 0, static_cast<uint32_t>(_meshes.size() * sizeof(GPUIndirectMesh)));
+        VkDescriptorBufferInfo batchInfo = VkRenderer::info::descriptor_buffer_info(frame.batchBuffer._buffer, 0, static_cast<uint32_t>(_batches.size() * sizeof(uint32_t)));
+        VkDescriptorBufferInfo instanceInfo = VkRenderer::info::descriptor_buffer_info(_resources->instanceBuffer->buffer(frameIndex), 0,
+                                                                                       INSTANCE_CAPACITY * sizeof(glm::mat4));
+        VkDescriptorBufferInfo commandInfo = VkRenderer::info::descriptor_buffer_info(frame.commandBuffer._buffer, 0,
+                                                                                      static_cast<uint32_t>(_objects.size() * sizeof(VkDrawIndexedIndirectCommand)));
+        VkDescriptorBufferInfo countInfo = VkRenderer::info::descriptor_buffer_info(frame.countBuffer._buffer, 0, static_cast<uint32_t>(_batches.size() * sizeof(uint32_t)));
+        VkDescriptorSet cullSet;
+        VkRenderer::descriptor::Builder::begin(_resources->descriptorLayoutCache, descriptorAllocator)
+                .bind_buffer(0, &objectInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(1, &meshInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(2, &batchInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(3, &instanceInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(4, &commandInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(5, &countInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .build(cullSet);
+
+        // without the count variant every object keeps its own slot and culled ones are drawn with no instances
+        CullPushConstant constant{};
+        constant.viewproj = viewproj;
+        constant.camera = glm::vec4(cameraPosition, _resources->flyCamera->_projection[1][1] * 0.5f * static_cast<float>(_resources->windowExtent.height));
+        constant.objectCount = static_cast<uint32_t>(_objects.size());
+        constant.lodErrorPixels = _resources->settings.lodErrorPixels;
+        constant.compact = _drawIndexedIndirectCount != nullptr;
+        constant.frustumCulling = _resources->settings.frustumCulling;
+
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &cullSet, 0, nullptr);
+        vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstant), &constant);
+        uint32_t groups = (constant.objectCount + INDIRECT_GROUP_SIZE - 1) / INDIRECT_GROUP_SIZE;
+        uint32_t groupsX = std::min(groups, INDIRECT_MAX_GROUPS);
+        vkCmdDispatch(cmd, groupsX, (groups + groupsX - 1) / groupsX, 1);
+
+        // commands and counts feed the draws, counts are also read back once the frame completes
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                             nullptr);
+    }
+
+    void IndirectScene::draw(VkCommandBuffer cmd, uint32_t frameIndex) {
+        FrameResources &frame = _frames[frameIndex];
+        if (_objects.empty()) return;
+
+        constexpr auto stride = static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand));
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        VkDescriptorSet boundTextures = VK_NULL_HANDLE;
+        for (size_t i = 0; i < _batches.size(); i++) {
+            const Batch &batch = _batches[i];
+            if (batch.material->pipeline != boundPipeline) {
+                boundPipeline = batch.material->pipeline;
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+            }
+            // the texture's set is looked up now, streaming may have replaced it since the rebuild
+            VkDescriptorSet textures = batch.texture != nullptr ? batch.texture->descriptor : _resources->textureTable->descriptor(frameIndex);
+            if (textures != boundTextures) {
+                boundTextures = textures;
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.material->pipelineLayout, 1, 1, &boundTextures, 0, nullptr);
+            }
+            _resources->geometryBuffer->bind_index_type(cmd, batch.indexType);
+
+            VkDeviceSize offset = batch.firstCommand * sizeof(VkDrawIndexedIndirectCommand);
+            if (_drawIndexedIndirectCount != nullptr) {
+                _drawIndexedIndirectCount(cmd, frame.commandBuffer._buffer, offset, frame.countBuffer._buffer, i * sizeof(uint32_t), batch.commandCount, stride);
+            } else if (_resources->multiDrawIndirect) {
+                vkCmdDrawIndexedIndirect(cmd, frame.commandBuffer._buffer, offset, batch.commandCount, stride);
+            } else {
+                for (uint32_t c = 0; c < batch.commandCount; c++) {
+                    vkCmdDrawIndexedIndirect(cmd, frame.commandBuffer._buffer, offset + c * sizeof(VkDrawIndexedIndirectCommand), 1, stride);
+                }
+            }
+        }
+    }
+
+    VkDescriptorBufferInfo IndirectScene::draw_data_info(uint32_t frameIndex) const {
+        // a descriptor can't be empty, so an unbuilt scene points at the DrawDataBuffer instead
+        const FrameResources &frame = _frames[frameIndex];
+        if (frame.drawDataBuffer._buffer == VK_NULL_HANDLE) {
+            return VkRenderer::info::descriptor_buffer_info(_resources->drawData->buffer(frameIndex), 0, DRAW_DATA_CAPACITY * sizeof(GPUDrawData));
+        }
+        return VkRenderer::info::descriptor_buffer_info(frame.drawDataBuffer._buffer, 0, static_cast<uint32_t>(std::max<size_t>(_drawData.size(), 1) * sizeof(GPUDrawData)));
+    }
+
+    void IndirectScene::rebuild(std::unordered_map<std::string, Model> &models) {
+        _objects.clear();
+        _drawData.clear();
+        _meshes.clear();
+        _batches.clear();
+        _batchCommands.clear();
+
+        // one object per instance of each node transform, grouped by batch so each batch's commands are contiguous
+        std::map<std::tuple<Material *, Texture *, VkIndexType>, uint32_t> batchIndices;
+        std::vector<std::vector<size_t>> batchObjects;
+        std::vector<GPUIndirectObject> objects;
+        std::vector<GPUDrawData> drawData;
+        for (auto &it: models) {
+            Model &model = it.second;
+            if (!model.instances_allocated()) continue;
+
+            for (auto &mesh: model.meshes) {
+                if (mesh._indexRange.size == 0) continue;
+
+                auto meshIndex = static_cast<uint32_t>(_meshes.size());
+                GPUIndirectMesh meshInfo{};
+                meshInfo.firstIndex = static_cast<uint32_t>(mesh._indexRange.offset / mesh.index_size());
+                meshInfo.vertexOffset = static_cast<int32_t>(mesh._vertexRange.offset / vertex_stride(mesh._vertexFormat));
+                meshInfo.lodCount = static_cast<uint32_t>(std::min<size_t>(mesh._lods.size(), MESH_MAX_LODS));
+                for (uint32_t l = 0; l < meshInfo.lodCount; l++) {
+                    meshInfo.lods[l].indexOffset = mesh._lods[l].indexOffset;
+                    meshInfo.lods[l].indexCount = mesh._lods[l].indexCount;
+                    meshInfo.lods[l].error = mesh._lods[l].error;
+                }
+                _meshes.push_back(meshInfo);
+
+                // bindless draws find their texture through the draw data, so textures no longer split batches
+                Material *material = _bindless ? model.defaultMaterial->bindless : model.defaultMaterial;
+                Texture *texture = _bindless ? nullptr : mesh._texture;
+                auto key = std::make_tuple(material, texture, mesh._indexType);
+                auto batch = batchIndices.find(key);
+                if (batch == batchIndices.end()) {
+                    batch = batchIndices.emplace(key, static_cast<uint32_t>(_batches.size())).first;
+                    _batches.push_back({material, texture, mesh._indexType, 0, 0});
+                    batchObjects.emplace_back();
+                }
+
+                for (auto &transform: mesh._transforms) {
+                    float maxScale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))});
+                    GPUIndirectObject object{};
+                    object.sphere = glm::vec4(glm::vec3(transform * glm::vec4(glm::vec3(mesh._bounds), 1.0f)), mesh._bounds.w * maxScale);
+                    object.mesh = meshIndex;
+                    object.batch = batch->second;
+                    object.scale = maxScale;
+                    for (uint32_t i = 0; i < model.instance_count(); i++) {
+                        object.instance = model.first_instance() + i;
+                        batchObjects[batch->second].push_back(objects.size());
+                        objects.push_back(object);
+                        drawData.push_back(mesh.draw_data(transform, object.instance));
+                    }
+                }
+            }
+        }
+
+        // objects are numbered in batch order, that number is their draw data index and their slot in the command buffer
+        _objects.reserve(objects.size());
+        _drawData.reserve(drawData.size());
+        for (size_t b = 0; b < _batches.size(); b++) {
+            _batches[b].firstCommand = static_cast<uint32_t>(_objects.size());
+            _batches[b].commandCount = static_cast<uint32_t>(batchObjects[b].size());
+            _batchCommands.push_back(_batches[b].firstCommand);
+            for (size_t index: batchObjects[b]) {
+                GPUIndirectObject object = objects[index];
+                object.command = static_cast<uint32_t>(_objects.size());
+                _objects.push_back(object);
+                _drawData.push_back(drawData[index]);
+            }
+        }
+
+        _version++;
+        _stats.objectCount = _objects.size();
+        _stats.batchCount = _batches.size();
+        _stats.rebuilds++;
+    }
+
+    void IndirectScene::upload(FrameResources &frame) {
+        frame.version = _version;
+        if (_objects.empty()) return;
+
+        // previous contents were consumed before the fence, buffers can be replaced or rewritten
+        reserve(frame.objectBuffer, frame.objectCapacity, _objects.size(), sizeof(GPUIndirectObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.drawDataBuffer, frame.drawDataCapacity, _drawData.size(), sizeof(GPUDrawData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.commandBuffer, frame.commandCapacity, _objects.size(), sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        reserve(frame.meshBuffer, frame.meshCapacity, _meshes.size(), sizeof(GPUIndirectMesh), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.batchBuffer, frame.batchCapacity, _batches.size(), sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.countBuffer, frame.countCapacity, _batches.size(), sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        void *data;
+        vmaMapMemory(_resources->allocator, frame.objectBuffer._allocation, &data);
+        memcpy(data, _objects.data(), _objects.size() * sizeof(GPUIndirectObject));
+        vmaUnmapMemory(_resources->allocator, frame.objectBuffer._allocation);
+        vmaMapMemory(_resources->allocator, frame.drawDataBuffer._allocation, &data);
+        memcpy(data, _drawData.data(), _drawData.size() * sizeof(GPUDrawData));
+        vmaUnmapMemory(_resources->allocator, frame.drawDataBuffer._allocation);
+        vmaMapMemory(_resources->allocator, frame.meshBuffer._allocation, &data);
+        memcpy(data, _meshes.data(), _meshes.size() * sizeof(GPUIndirectMesh));
+        vmaUnmapMemory(_resources->allocator, frame.meshBuffer._allocation);
+        vmaMapMemory(_resources->allocator, frame.batchBuffer._allocation, &data);
+        memcpy(data, _batchCommands.data(), _batchCommands.size() * sizeof(uint32_t));
+        vmaUnmapMemory(_resources->allocator, frame.batchBuffer._allocation);
+    }
+
+    void IndirectScene::read_results(FrameResources &frame) {
+        _stats.visibleCount = 0;
+        if (frame.batchCount == 0 || frame.countBuffer._buffer == VK_NULL_HANDLE) return;
+
+        void *data;
+        vmaInvalidateAllocation(_resources->allocator, frame.countBuffer._allocation, 0, VK_WHOLE_SIZE);
+        vmaMapMemory(_resources->allocator, frame.countBuffer._allocation, &data);
+        const auto *counts = static_cast<const uint32_t *>(data);
+        for (size_t i = 0; i < frame.batchCount; i++) {
+            _stats.visibleCount += counts[i];
+        }
+        vmaUnmapMemory(_resources->allocator, frame.countBuffer._allocation);
+    }
+
+    void IndirectScene::reserve(AllocatedBuffer &buffer, VkDeviceSize &capacity, VkDeviceSize count, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+                                VmaMemoryUsage memoryUsage) {
+        if (count <= capacity && buffer._buffer != VK_NULL_HANDLE) return;
+        if (buffer._buffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(_resources->allocator, buffer._buffer, buffer._allocation);
+        }
+
+        // grow geometrically so a growing scene doesn't reallocate on every rebuild
+        capacity = std::max(count, capacity * 2);
+        buffer = VkRenderer::utils::create_buffer(_resources->allocator, capacity * elementSize, usage, memoryUsage);
+    }
+
+    void IndirectScene::cleanup() {
+        for (auto &frame: _frames) {
+            AllocatedBuffer *buffers[] = {&frame.objectBuffer, &frame.drawDataBuffer, &frame.meshBuffer, &frame.batchBuffer, &frame.commandBuffer, &frame.countBuffer};
+            for (AllocatedBuffer *buffer: buffers) {
+                if (buffer->_buffer != VK_NULL_HANDLE) {
+                    vmaDestroyBuffer(_resources->allocator, buffer->_buffer, buffer->_allocation);
+                }
+            }
+        }
+        vkDestroyPipeline(_resources->device, _pipeline, nullptr);
+        vkDestroyPipelineLayout(_resources->device, _pipelineLayout, nullptr);
+    }
+}
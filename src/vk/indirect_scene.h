@@ -0,0 +1,142 @@
+#pragma once
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <vk/types.h>
+#include <vk/model.h>
+
+namespace VkRenderer {
+    struct IndirectStats {
+        size_t objectCount = 0;
+        size_t batchCount = 0;
+        size_t rebuilds = 0;
+        // read back from the frame that last used the same buffers, so it lags by FRAME_OVERLAP frames
+        size_t visibleCount = 0;
+    };
+
+    // GPU-driven drawing, every instance of every mesh is an object in GPU buffers that stay as they are until models are added,
+    // removed or re-instanced, a compute pass culls the objects, picks their level of detail and writes their indirect commands,
+    // and each batch of objects sharing a pipeline, texture and index type is drawn with one indirect multi-draw
+    class IndirectScene {
+    public:
+        void init(ResourceHandles *resources);
+
+        // refresh the objects if the scene's structure changed and record the culling dispatch, must be outside a render pass,
+        // the models' instance matrices must have been written for this frame
+        void cull(VkCommandBuffer cmd, uint32_t frameIndex, VkRenderer::descriptor::Allocator *descriptorAllocator, std::unordered_map<std::string, Model> &models,
+                  const glm::mat4 &viewproj, const glm::vec3 &cameraPosition);
+
+        // one indirect draw per batch, the geometry buffers must be bound and the global set's draw data must be draw_data_info
+        void draw(VkCommandBuffer cmd, uint32_t frameIndex);
+
+        // per-object draw data, indexed by the commands' firstInstance like the DrawDataBuffer
+        [[nodiscard]] VkDescriptorBufferInfo draw_data_info(uint32_t frameIndex) const;
+
+        [[nodiscard]] IndirectStats stats() const { return _stats; }
+
+    private:
+        // matches IndirectObject in indirect_cull.comp
+        struct GPUIndirectObject {
+            glm::vec4 sphere; // model space, the instance matrix places it in the world
+            uint32_t instance;
+            uint32_t mesh;
+            uint32_t batch;
+            uint32_t command; // slot when commands aren't compacted
+            float scale; // largest scale of the node transform, for the level of detail
+            uint32_t padding[3];
+        };
+
+        // matches IndirectMesh in indirect_cull.comp
+        struct GPUIndirectMesh {
+            uint32_t firstIndex;
+            int32_t vertexOffset;
+            uint32_t lodCount;
+            uint32_t padding;
+            struct {
+                uint32_t indexOffset;
+                uint32_t indexCount;
+                float error;
+                uint32_t padding;
+            } lods[MESH_MAX_LODS];
+        };
+
+        struct CullPushConstant {
+            glm::mat4 viewproj;
+            glm::vec4 camera; // xyz position, w pixels per unit at distance 1
+            uint32_t objectCount;
+            float lodErrorPixels;
+            uint32_t compact;
+            uint32_t frustumCulling;
+        };
+
+        // bindless batches have no texture, their draws index the TextureTable
+        struct Batch {
+            Material *material;
+            Texture *texture;
+            VkIndexType indexType;
+            uint32_t firstCommand;
+            uint32_t commandCount;
+        };
+
+        // what the objects were built from, compared every frame
+        struct ModelKey {
+            const Model *model;
+            // a replaced model can land at the same address
+            uint64_t modelId;
+            uint32_t firstInstance;
+            size_t instanceCount;
+            size_t meshCount;
+
+            bool operator==(const ModelKey &other) const {
+                return model == other.model && modelId == other.modelId && firstInstance == other.firstInstance && instanceCount == other.instanceCount && meshCount == other.meshCount;
+            }
+        };
+
+        // capacities are in elements, one per buffer, buffers only grow, the object data is copied in when the frame's version is behind
+        struct FrameResources {
+            AllocatedBuffer objectBuffer{};
+            AllocatedBuffer drawDataBuffer{};
+            AllocatedBuffer meshBuffer{};
+            AllocatedBuffer batchBuffer{};
+            AllocatedBuffer commandBuffer{};
+            AllocatedBuffer countBuffer{};
+            VkDeviceSize objectCapacity = 0;
+            VkDeviceSize drawDataCapacity = 0;
+            VkDeviceSize meshCapacity = 0;
+            VkDeviceSize batchCapacity = 0;
+            VkDeviceSize commandCapacity = 0;
+            VkDeviceSize countCapacity = 0;
+            uint64_t version = 0;
+            size_t batchCount = 0;
+        };
+
+        ResourceHandles *_resources;
+        VkPipelineLayout _pipelineLayout;
+        VkPipeline _pipeline;
+        PFN_vkCmdDrawIndexedIndirectCountKHR _drawIndexedIndirectCount = nullptr;
+        FrameResources _frames[FRAME_OVERLAP];
+        std::vector<ModelKey> _keys;
+        // whether the batches were built for bindless textures
+        bool _bindless = false;
+        uint64_t _version = 0;
+        std::vector<GPUIndirectObject> _objects;
+        std::vector<GPUDrawData> _drawData;
+        std::vector<GPUIndirectMesh> _meshes;
+        std::vector<Batch> _batches;
+        std::vector<uint32_t> _batchCommands;
+        IndirectStats _stats;
+
+        void rebuild(std::unordered_map<std::string, Model> &models);
+
+        // copy the objects into the frame's buffers
+        void upload(FrameResources &frame);
+
+        void read_results(FrameResources &frame);
+
+        void reserve(AllocatedBuffer &buffer, VkDeviceSize &capacity, VkDeviceSize count, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+                     VmaMemoryUsage memoryUsage);
+
+        void cleanup();
+    };
+}
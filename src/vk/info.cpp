@@ -131,7 +131,7 @@ namespace VkRenderer::info {
         return info;
     }
 
-    VkImageCreateInfo image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent) {
+    VkImageCreateInfo image_create_info(VkFormat format, VkImageUsageFlags usageFlags, VkExtent3D extent, uint32_t mipLevels) {
         // describe a new VkImage
         VkImageCreateInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -139,7 +139,7 @@ namespace VkRenderer::info {
         info.imageType = VK_IMAGE_TYPE_2D;
         info.format = format;
         info.extent = extent;
-        info.mipLevels = 1;
+        info.mipLevels = mipLevels;
         info.arrayLayers = 1;
         info.samples = VK_SAMPLE_COUNT_1_BIT;
         info.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -148,7 +148,7 @@ namespace VkRenderer::info {
         return info;
     }
 
-    VkImageViewCreateInfo imageview_create_info(VkFormat format, VkImage image, VkImageAspectFlags aspectFlags) {
+    VkImageViewCreateInfo imageview_create_info(VkFormat format, VkImage image, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
         // describe a new VkImageView
         VkImageViewCreateInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -157,7 +157,7 @@ namespace VkRenderer::info {
         info.image = image;
         info.format = format;
         info.subresourceRange.baseMipLevel = 0;
-        info.subresourceRange.levelCount = 1;
+        info.subresourceRange.levelCount = mipLevels;
         info.subresourceRange.baseArrayLayer = 0;
         info.subresourceRange.layerCount = 1;
         info.subresourceRange.aspectMask = aspectFlags;
@@ -403,6 +403,11 @@ namespace VkRenderer::info {
         info.addressModeV = samplerAddressMode;
         info.addressModeW = samplerAddressMode;
 
+        // sample the whole mip chain
+        info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        info.minLod = 0.0f;
+        info.maxLod = VK_LOD_CLAMP_NONE;
+
         return info;
     }
 }
\ No newline at end of file
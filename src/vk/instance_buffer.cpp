@@ -0,0 +1,50 @@
+#include <iostream>
+#include <cstring>
+#include <vk/utils.h>
+
+#include "instance_buffer.h"
+
+namespace VkRenderer {
+    void InstanceBuffer::init(ResourceHandles *resources) {
+        _resources = resources;
+        _allocator.init(INSTANCE_CAPACITY);
+
+        // host visible and mapped for the buffer's lifetime, writes only touch changed ranges
+        for (uint32_t i = 0; i < FRAME_OVERLAP; i++) {
+            _buffers[i] = VkRenderer::utils::create_buffer(_resources->allocator, INSTANCE_CAPACITY * sizeof(glm::mat4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
+            void *data;
+            vmaMapMemory(_resources->allocator, _buffers[i]._allocation, &data);
+            _mapped[i] = static_cast<glm::mat4 *>(data);
+        }
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    bool InstanceBuffer::allocate(uint32_t count, GeometryRange &range) {
+        if (!_allocator.allocate(count, 1, range)) {
+            std::cout << "Instance buffer is full, " << count << " instances don't fit" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void InstanceBuffer::free(const GeometryRange &range) {
+        // other frames' copies are rewritten before their next use, so the range can be reused at once
+        _allocator.free(range);
+    }
+
+    void InstanceBuffer::write(uint32_t frameIndex, const GeometryRange &range, const glm::mat4 *matrices) {
+        memcpy(_mapped[frameIndex] + range.offset, matrices, range.size * sizeof(glm::mat4));
+        vmaFlushAllocation(_resources->allocator, _buffers[frameIndex]._allocation, range.offset * sizeof(glm::mat4), range.size * sizeof(glm::mat4));
+    }
+
+    void InstanceBuffer::cleanup() {
+        for (auto &buffer: _buffers) {
+            vmaUnmapMemory(_resources->allocator, buffer._allocation);
+            vmaDestroyBuffer(_resources->allocator, buffer._buffer, buffer._allocation);
+        }
+    }
+}
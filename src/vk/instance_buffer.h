@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vk/types.h>
+#include <vk/geometry.h>
+
+namespace VkRenderer {
+    // matrices in each frame's copy
+    constexpr VkDeviceSize INSTANCE_CAPACITY = 256 * 1024;
+
+    // world matrices of every model instance, vertex shaders read them with gl_InstanceIndex
+    // each frame in flight has its own persistently mapped copy, written only while that frame is recorded
+    class InstanceBuffer {
+    public:
+        void init(ResourceHandles *resources);
+
+        // range in matrices, its offset is the firstInstance of draws using it
+        bool allocate(uint32_t count, GeometryRange &range);
+
+        void free(const GeometryRange &range);
+
+        void write(uint32_t frameIndex, const GeometryRange &range, const glm::mat4 *matrices);
+
+        [[nodiscard]] VkBuffer buffer(uint32_t frameIndex) const { return _buffers[frameIndex]._buffer; }
+
+        [[nodiscard]] VkDeviceSize used() const { return _allocator.used(); }
+
+    private:
+        ResourceHandles *_resources;
+        AllocatedBuffer _buffers[FRAME_OVERLAP];
+        glm::mat4 *_mapped[FRAME_OVERLAP];
+        RangeAllocator _allocator;
+
+        void cleanup();
+    };
+}
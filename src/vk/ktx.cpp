@@ -0,0 +1,133 @@
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <algorithm>
+
+#include "ktx.h"
+
+namespace VkRenderer::ktx {
+    static uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static uint64_t level_size(VkFormat format, uint32_t width, uint32_t height, uint32_t level) {
+        uint64_t blocksWide = (std::max(width >> level, 1u) + 3) / 4;
+        uint64_t blocksHigh = (std::max(height >> level, 1u) + 3) / 4;
+        return blocksWide * blocksHigh * block_bytes(format);
+    }
+
+    uint32_t block_bytes(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+                return 8;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
+    std::string cooked_path(const std::string &sourcePath) {
+        return std::filesystem::path(sourcePath).replace_extension(COOKED_EXTENSION).string();
+    }
+
+    bool load(const std::string &sourcePath, Texture &texture) {
+        // a source edited after cooking wins over the stale cooked file
+        std::string filePath = cooked_path(sourcePath);
+        std::error_code error;
+        auto cookedTime = std::filesystem::last_write_time(filePath, error);
+        if (error) return false;
+        auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+        if (!error && sourceTime > cookedTime) {
+            std::cout << "Cooked texture " << filePath << " is older than its source, ignoring" << std::endl;
+            return false;
+        }
+
+        std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) return false;
+        texture.data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(texture.data.data()), static_cast<std::streamsize>(texture.data.size()));
+        if (!file.good()) return false;
+
+        // validate header and level table
+        const size_t levelIndexOffset = sizeof(KTX2_IDENTIFIER) + sizeof(Header) + sizeof(Index);
+        if (texture.data.size() < levelIndexOffset || memcmp(texture.data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+            std::cout << "Cooked texture " << filePath << " is not a KTX2 file" << std::endl;
+            return false;
+        }
+
+        Header header;
+        memcpy(&header, texture.data.data() + sizeof(KTX2_IDENTIFIER), sizeof(Header));
+        auto format = static_cast<VkFormat>(header.vkFormat);
+        if (block_bytes(format) == 0 || header.supercompressionScheme != 0 || header.pixelWidth == 0 || header.pixelHeight == 0 ||
+            header.levelCount == 0 || texture.data.size() < levelIndexOffset + header.levelCount * sizeof(LevelIndex)) {
+            std::cout << "Cooked texture " << filePath << " uses an unsupported layout" << std::endl;
+            return false;
+        }
+
+        texture.levels.resize(header.levelCount);
+        memcpy(texture.levels.data(), texture.data.data() + levelIndexOffset, header.levelCount * sizeof(LevelIndex));
+        for (uint32_t i = 0; i < header.levelCount; i++) {
+            const LevelIndex &level = texture.levels[i];
+            if (level.byteOffset + level.byteLength > texture.data.size() || level.byteLength != level_size(format, header.pixelWidth, header.pixelHeight, i)) {
+                std::cout << "Cooked texture " << filePath << " has a truncated mip level" << std::endl;
+                return false;
+            }
+        }
+
+        texture.format = format;
+        texture.width = header.pixelWidth;
+        texture.height = header.pixelHeight;
+        return true;
+    }
+
+    bool write(const std::string &filePath, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>> &levels) {
+        Header header = {};
+        header.vkFormat = format;
+        header.typeSize = 1;
+        header.pixelWidth = width;
+        header.pixelHeight = height;
+        header.pixelDepth = 0;
+        header.layerCount = 0;
+        header.faceCount = 1;
+        header.levelCount = static_cast<uint32_t>(levels.size());
+        header.supercompressionScheme = 0;
+        Index index = {};
+
+        // level data goes smallest mip first, each level aligned to the block size
+        std::vector<LevelIndex> levelIndex(levels.size());
+        uint64_t offset = sizeof(KTX2_IDENTIFIER) + sizeof(Header) + sizeof(Index) + levels.size() * sizeof(LevelIndex);
+        for (size_t i = levels.size(); i-- > 0;) {
+            offset = align_up(offset, block_bytes(format));
+            levelIndex[i].byteOffset = offset;
+            levelIndex[i].byteLength = levels[i].size();
+            levelIndex[i].uncompressedByteLength = levels[i].size();
+            offset += levels[i].size();
+        }
+
+        std::vector<uint8_t> fileData(offset, 0);
+        memcpy(fileData.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+        memcpy(fileData.data() + sizeof(KTX2_IDENTIFIER), &header, sizeof(Header));
+        memcpy(fileData.data() + sizeof(KTX2_IDENTIFIER) + sizeof(Header), &index, sizeof(Index));
+        memcpy(fileData.data() + sizeof(KTX2_IDENTIFIER) + sizeof(Header) + sizeof(Index), levelIndex.data(), levelIndex.size() * sizeof(LevelIndex));
+        for (size_t i = 0; i < levels.size(); i++) {
+            memcpy(fileData.data() + levelIndex[i].byteOffset, levels[i].data(), levels[i].size());
+        }
+
+        std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "Failed to write cooked texture " << filePath << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char *>(fileData.data()), static_cast<std::streamsize>(fileData.size()));
+        return file.good();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace VkRenderer::ktx {
+    constexpr uint8_t KTX2_IDENTIFIER[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    constexpr const char *COOKED_EXTENSION = ".ktx2";
+
+    // KTX2 layout: identifier, Header, Index, one LevelIndex per mip, then level data smallest mip first
+    // we write no data format descriptor or key/value data, vkFormat is all the runtime needs
+    struct Header {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+    };
+
+    struct Index {
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    struct Texture {
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> data; // whole file
+        std::vector<LevelIndex> levels; // level 0 first
+    };
+
+    // bytes per 4x4 block, 0 for formats we don't cook
+    uint32_t block_bytes(VkFormat format);
+
+    std::string cooked_path(const std::string &sourcePath);
+
+    // read the cooked version of a source image, fails if missing, malformed or older than the source
+    bool load(const std::string &sourcePath, Texture &texture);
+
+    // levels hold encoded blocks, level 0 first
+    bool write(const std::string &filePath, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>> &levels);
+}
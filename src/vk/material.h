@@ -1,37 +1,41 @@
-#pragma once
-
-#include <unordered_map>
-#include <string>
-#include <vulkan/vulkan.h>
-
-namespace VkRenderer {
-    struct MaterialCreateInfo {
-        const char *vertShaderPath;
-        const char *fragShaderPath;
-        uint32_t setLayoutCount;
-        VkDescriptorSetLayout *setLayouts;
-        VkDevice device;
-        VkExtent2D extent;
-        VkRenderPass renderPass;
-        const char *name;
-    };
-
-    struct Material {
-        VkPipeline pipeline;
-        VkPipelineLayout pipelineLayout;
-    };
-
-    class MaterialManager {
-    public:
-        Material *create_material(MaterialCreateInfo *info);
-
-        Material *get_material(const std::string &name);
-
-        void cleanup(VkDevice device);
-
-    private:
-        std::unordered_map<std::string, Material> _materials;
-
-        static bool load_shader_module(VkDevice device, const char *filePath, VkShaderModule *outShaderModule);
-    };
+#pragma once
+
+#include <unordered_map>
+#include <string>
+#include <vulkan/vulkan.h>
+#include <vk/vertex.h>
+
+namespace VkRenderer {
+    struct MaterialCreateInfo {
+        const char *vertShaderPath;
+        const char *fragShaderPath;
+        uint32_t setLayoutCount;
+        VkDescriptorSetLayout *setLayouts;
+        VkDevice device;
+        VkExtent2D extent;
+        VkRenderPass renderPass;
+        const char *name;
+        // vertex input layout, meshes drawn with the material must be uploaded in the same format
+        VertexFormat vertexFormat = VertexFormat::Standard;
+    };
+
+    struct Material {
+        VkPipeline pipeline;
+        VkPipelineLayout pipelineLayout;
+        VertexFormat vertexFormat;
+        // same material sampling the TextureTable, null if the device can't index descriptors
+        Material *bindless = nullptr;
+    };
+
+    class MaterialManager {
+    public:
+        Material *create_material(MaterialCreateInfo *info);
+
+        Material *get_material(const std::string &name);
+
+        void cleanup(VkDevice device);
+
+    private:
+        std::unordered_map<std::string, Material> _materials;
+    };
 }
\ No newline at end of file
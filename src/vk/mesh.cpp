@@ -1,90 +1,142 @@
-#include <iostream>
-#include <vk/info.h>
-#include <vk/check.h>
-#include <vk/utils.h>
-
-#include "mesh.h"
-
-namespace VkRenderer {
-    void Mesh::upload_mesh(ResourceHandles *resources) {
-        // create CPU-side staging buffers
-        VmaAllocationCreateInfo stagingAllocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_CPU_ONLY, 0);
-
-        // vertices
-        const size_t vertexBufferSize = _vertices.size() * sizeof(Vertex);
-        VkBufferCreateInfo vertexStagingInfo = VkRenderer::info::buffer_create_info(vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        AllocatedBuffer vertexStaging;
-        VK_CHECK(vmaCreateBuffer(resources->allocator, &vertexStagingInfo, &stagingAllocInfo, &vertexStaging._buffer, &vertexStaging._allocation, nullptr));
-
-        // copy data
-        void *vertexData;
-        vmaMapMemory(resources->allocator, vertexStaging._allocation, &vertexData);
-        memcpy(vertexData, _vertices.data(), _vertices.size() * sizeof(Vertex));
-        vmaUnmapMemory(resources->allocator, vertexStaging._allocation);
-
-        // indices
-        const size_t indexBufferSize = _indices.size() * sizeof(uint16_t);
-        VkBufferCreateInfo indexStagingInfo = VkRenderer::info::buffer_create_info(indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
-        AllocatedBuffer indexStaging;
-        VK_CHECK(vmaCreateBuffer(resources->allocator, &indexStagingInfo, &stagingAllocInfo, &indexStaging._buffer, &indexStaging._allocation, nullptr));
-
-        // copy data
-        void *indexData;
-        vmaMapMemory(resources->allocator, indexStaging._allocation, &indexData);
-        memcpy(indexData, _indices.data(), _indices.size() * sizeof(uint16_t));
-        vmaUnmapMemory(resources->allocator, indexStaging._allocation);
-
-        // reuse alloc info for GPU-side buffers
-        stagingAllocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-        // vertices
-        VkBufferCreateInfo vertexBufferInfo = VkRenderer::info::buffer_create_info(vertexBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        VK_CHECK(vmaCreateBuffer(resources->allocator, &vertexBufferInfo, &stagingAllocInfo, &_vertexBuffer._buffer, &_vertexBuffer._allocation, nullptr));
-        resources->mainDeletionQueue.push_function([=]() {
-            vmaDestroyBuffer(resources->allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
-        });
-
-        // copy data to GPU
-        VkRenderer::utils::immediate_submit(resources, [=](VkCommandBuffer cmd) {
-            VkBufferCopy copy;
-            copy.dstOffset = 0;
-            copy.srcOffset = 0;
-            copy.size = vertexBufferSize;
-            vkCmdCopyBuffer(cmd, vertexStaging._buffer, _vertexBuffer._buffer, 1, &copy);
-        });
-
-        // indices
-        VkBufferCreateInfo indexBufferInfo = VkRenderer::info::buffer_create_info(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-        VK_CHECK(vmaCreateBuffer(resources->allocator, &indexBufferInfo, &stagingAllocInfo, &_indexBuffer._buffer, &_indexBuffer._allocation, nullptr));
-        resources->mainDeletionQueue.push_function([=]() {
-            vmaDestroyBuffer(resources->allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
-        });
-
-        // copy data to GPU
-        VkRenderer::utils::immediate_submit(resources, [=](VkCommandBuffer cmd) {
-            VkBufferCopy copy;
-            copy.dstOffset = 0;
-            copy.srcOffset = 0;
-            copy.size = indexBufferSize;
-            vkCmdCopyBuffer(cmd, indexStaging._buffer, _indexBuffer._buffer, 1, &copy);
-        });
-
-        // we're done with the staging buffers
-        vmaDestroyBuffer(resources->allocator, vertexStaging._buffer, vertexStaging._allocation);
-        vmaDestroyBuffer(resources->allocator, indexStaging._buffer, indexStaging._allocation);
-    }
-
-    void Mesh::draw_mesh(VkCommandBuffer cmd, glm::mat4 modelMatrix) {
-        // push model matrix through push constant
-        MatrixPushConstant constant{};
-        constant.matrix = modelMatrix;
-        vkCmdPushConstants(cmd, _material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MatrixPushConstant), &constant);
-
-        // bind buffers and draw
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(cmd, 0, 1, &_vertexBuffer._buffer, &offset);
-        vkCmdBindIndexBuffer(cmd, _indexBuffer._buffer, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _material->pipelineLayout, 1, 1, &_texture->descriptor, 0, nullptr);
-        vkCmdDrawIndexed(cmd, static_cast<uint32_t>(_indices.size()), 1, 0, 0, 0);
-    }
+#include <iostream>
+#include <algorithm>
+#include <vk/info.h>
+#include <vk/check.h>
+#include <glm/gtx/transform.hpp>
+#include <vk/draw_data.h>
+
+#include "mesh.h"
+
+namespace VkRenderer {
+    void Mesh::select_index_type() {
+        _indexType = _vertices.size() <= MAX_UINT16_VERTICES ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+
+    size_t Mesh::index_size() const {
+        return _indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    void Mesh::upload_mesh(ResourceHandles *resources, UploadBatcher *uploader) {
+        compute_bounds();
+        _geometry = resources->geometryBuffer;
+
+        // nothing to draw, the ranges stay empty so every draw path skips the mesh
+        if (_vertices.empty() || _indices.empty()) {
+            std::cout << "Skipping empty mesh (" << _vertices.size() << " vertices, " << _indices.size() << " indices)" << std::endl;
+            return;
+        }
+
+        // vertices
+        bool uploaded;
+        if (_vertexFormat == VertexFormat::Compact) {
+            std::vector<CompactVertex> packed;
+            packed.reserve(_vertices.size());
+            for (auto &vertex: _vertices) {
+                packed.push_back(CompactVertex::pack(vertex, _quantizationMin, _quantizationExtent));
+            }
+            uploaded = _geometry->upload_vertices(uploader, packed.data(), packed.size() * sizeof(CompactVertex), sizeof(CompactVertex), _vertexRange);
+        } else {
+            uploaded = _geometry->upload_vertices(uploader, _vertices.data(), _vertices.size() * sizeof(Vertex), sizeof(Vertex), _vertexRange);
+        }
+        if (!uploaded) return;
+
+        // indices, half the bandwidth when they fit in 16 bits
+        const size_t indexBufferSize = _indices.size() * index_size();
+        if (_indexType == VK_INDEX_TYPE_UINT16) {
+            std::vector<uint16_t> narrowed(_indices.begin(), _indices.end());
+            uploaded = _geometry->upload_indices(uploader, narrowed.data(), indexBufferSize, sizeof(uint16_t), _indexRange);
+        } else {
+            uploaded = _geometry->upload_indices(uploader, _indices.data(), indexBufferSize, sizeof(uint32_t), _indexRange);
+        }
+        if (!uploaded) {
+            _geometry->free(_vertexRange, _indexRange, _meshletRange);
+            _vertexRange = {};
+            return;
+        }
+
+        // culling falls back to drawing the whole mesh without meshlets
+        if (!_meshlets.empty()) {
+            _geometry->upload_meshlets(uploader, _meshlets.data(), _meshlets.size() * sizeof(Meshlet), sizeof(Meshlet), _meshletRange);
+        }
+    }
+
+    void Mesh::add_draws(DrawList &drawList, DrawDataBuffer *drawData, uint32_t firstInstance, uint32_t instanceCount, const DrawBounds *bounds,
+                         const glm::vec3 &cameraPosition, VkDescriptorSet textureTable) {
+        if (_indexRange.size == 0) return;
+
+        // with the table every draw of the material shares one set, so the list orders them by depth alone
+        const Material *material = textureTable != VK_NULL_HANDLE ? _material->bindless : _material;
+        VkDescriptorSet descriptor = textureTable != VK_NULL_HANDLE ? textureTable : _texture->descriptor;
+
+        const MeshLod &lod = _lods[_lod];
+        VkDrawIndexedIndirectCommand command{};
+        command.indexCount = lod.indexCount;
+        command.instanceCount = instanceCount;
+        command.firstIndex = static_cast<uint32_t>(_indexRange.offset / index_size()) + lod.indexOffset;
+        command.vertexOffset = static_cast<int32_t>(_vertexRange.offset / vertex_stride(_vertexFormat));
+        for (size_t i = 0; i < _transforms.size(); i++) {
+            if (!visible(i)) continue;
+
+            // the draw's index reaches the shader as gl_BaseInstance, instances are found through the draw data
+            uint32_t drawIndex = drawData->add(draw_data(_transforms[i], firstInstance));
+            if (drawIndex == DRAW_DATA_FULL) return;
+            command.firstInstance = drawIndex;
+
+            // distance to the nearest point of the bounding sphere, zero when the camera is inside it
+            float depth = std::max(glm::length(bounds[i].center - cameraPosition) - bounds[i].radius, 0.0f);
+            if (!drawList.add(material, descriptor, _indexType, command, depth)) return;
+        }
+    }
+
+    void Mesh::draw_mesh_indirect(VkCommandBuffer cmd, VkBuffer commandBuffer, VkDeviceSize offset) {
+        vkCmdDrawIndexedIndirect(cmd, commandBuffer, offset, 1, sizeof(VkDrawIndexedIndirectCommand));
+    }
+
+    GPUDrawData Mesh::draw_data(const glm::mat4 &transform, uint32_t firstInstance) const {
+        GPUDrawData data{};
+        data.matrix = transform * _dequantization;
+        data.instanceOffset = firstInstance;
+        data.textureIndex = _texture->tableSlot;
+        return data;
+    }
+
+    void Mesh::set_quantization(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) {
+        // flat boxes still need a usable scale on the degenerate axis
+        _vertexFormat = VertexFormat::Compact;
+        _quantizationMin = boundsMin;
+        _quantizationExtent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+        _dequantization = glm::translate(_quantizationMin) * glm::scale(_quantizationExtent);
+    }
+
+    void Mesh::compute_bounds() {
+        if (_vertices.empty()) {
+            _bounds = glm::vec4(0.0f);
+            _boundsMin = glm::vec3(0.0f);
+            _boundsMax = glm::vec3(0.0f);
+            return;
+        }
+
+        // sphere around the box center, loose but cheap
+        glm::vec3 minPosition = _vertices[0].position;
+        glm::vec3 maxPosition = _vertices[0].position;
+        for (auto &vertex: _vertices) {
+            minPosition = glm::min(minPosition, vertex.position);
+            maxPosition = glm::max(maxPosition, vertex.position);
+        }
+        glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+        float radius = 0.0f;
+        for (auto &vertex: _vertices) {
+            radius = std::max(radius, glm::length(vertex.position - center));
+        }
+        _bounds = glm::vec4(center, radius);
+        _boundsMin = minPosition;
+        _boundsMax = maxPosition;
+    }
+
+    void Mesh::destroy(ResourceHandles *resources) {
+        resources->geometryBuffer->free(_vertexRange, _indexRange, _meshletRange);
+        _vertexRange = {};
+        _indexRange = {};
+        _meshletRange = {};
+    }
 }
\ No newline at end of file
@@ -1,22 +1,89 @@
-#pragma once
-
-#include <vector>
-#include <vk/vertex.h>
-#include <vk/types.h>
-#include <vk/material.h>
-#include <vk/texture.h>
-
-namespace VkRenderer {
-    struct Mesh {
-        std::vector<Vertex> _vertices;
-        std::vector<uint16_t> _indices;
-        AllocatedBuffer _vertexBuffer;
-        AllocatedBuffer _indexBuffer;
-        Texture *_texture;
-        Material *_material;
-
-        void upload_mesh(ResourceHandles *resources);
-
-        void draw_mesh(VkCommandBuffer cmd, glm::mat4 modelMatrix);
-    };
+#pragma once
+
+#include <vector>
+#include <string>
+#include <vk/vertex.h>
+#include <vk/types.h>
+#include <vk/material.h>
+#include <vk/texture.h>
+#include <vk/upload.h>
+#include <vk/geometry.h>
+#include <vk/meshlet.h>
+#include <vk/mesh_lod.h>
+#include <vk/draw_data.h>
+#include <vk/draw_list.h>
+
+namespace VkRenderer {
+    // meshes with more vertices than this are drawn with 32-bit indices
+    constexpr size_t MAX_UINT16_VERTICES = 65536;
+
+    // world space volume of a draw, the box and the sphere share their center
+    struct DrawBounds {
+        glm::vec3 center;
+        glm::vec3 extent; // half size of the box
+        float radius;
+    };
+
+    struct Mesh {
+        std::vector<Vertex> _vertices;
+        // 32-bit on the CPU, narrowed at upload when _indexType is 16-bit, every level of detail back to back
+        std::vector<uint32_t> _indices;
+        VkIndexType _indexType = VK_INDEX_TYPE_UINT16;
+        // index ranges of _indices, level 0 is full detail
+        std::vector<MeshLod> _lods;
+        // level drawn this frame
+        uint32_t _lod = 0;
+        // index ranges of the full detail level with their culling bounds
+        std::vector<Meshlet> _meshlets;
+        // node transforms within the model, drawn once each, batched meshes have theirs baked into the vertices
+        std::vector<glm::mat4> _transforms = {glm::mat4(1.0f)};
+        // per node transform, cleared by the frustum culler for draws outside the view, empty draws everything
+        std::vector<uint8_t> _visible;
+        // ranges in the shared geometry buffers, the mesh isn't drawn if they couldn't be allocated
+        GeometryBuffer *_geometry = nullptr;
+        GeometryRange _vertexRange;
+        GeometryRange _indexRange;
+        GeometryRange _meshletRange;
+        std::string _texturePath;
+        Texture *_texture;
+        Material *_material;
+        // bounding sphere in model space, xyz center and w radius, centered on the box
+        glm::vec4 _bounds;
+        glm::vec3 _boundsMin = glm::vec3(0.0f);
+        glm::vec3 _boundsMax = glm::vec3(0.0f);
+        // layout of the vertex buffer, compact positions are mapped back into model space by _dequantization
+        VertexFormat _vertexFormat = VertexFormat::Standard;
+        glm::vec3 _quantizationMin = glm::vec3(0.0f);
+        glm::vec3 _quantizationExtent = glm::vec3(1.0f);
+        glm::mat4 _dequantization = glm::mat4(1.0f);
+
+        // upload in the compact format with positions quantized to the box [boundsMin, boundsMax]
+        void set_quantization(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax);
+
+        // narrowest index type that addresses every vertex
+        void select_index_type();
+
+        [[nodiscard]] size_t index_size() const;
+
+        void upload_mesh(ResourceHandles *resources, UploadBatcher *uploader);
+
+        // instances [firstInstance, firstInstance + instanceCount) of the instance buffer place the model in the world,
+        // one draw per visible node transform goes into drawData and drawList, bounds holds the world bounds of each transform,
+        // draws use the bindless material and textureTable unless it is VK_NULL_HANDLE
+        void add_draws(DrawList &drawList, DrawDataBuffer *drawData, uint32_t firstInstance, uint32_t instanceCount, const DrawBounds *bounds,
+                       const glm::vec3 &cameraPosition, VkDescriptorSet textureTable);
+
+        // draw with the command at offset in commandBuffer, the caller binds the index buffer it refers to and the texture set,
+        // and puts the index of the mesh's draw data in the command's firstInstance
+        void draw_mesh_indirect(VkCommandBuffer cmd, VkBuffer commandBuffer, VkDeviceSize offset);
+
+        // shader data for one draw, transform places the mesh within its model
+        [[nodiscard]] GPUDrawData draw_data(const glm::mat4 &transform, uint32_t firstInstance) const;
+
+        [[nodiscard]] bool visible(size_t transformIndex) const { return _visible.empty() || _visible[transformIndex]; }
+
+        void compute_bounds();
+
+        void destroy(ResourceHandles *resources);
+    };
 }
\ No newline at end of file
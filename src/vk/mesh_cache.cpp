@@ -0,0 +1,319 @@
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <filesystem>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mesh_cache.h"
+
+namespace VkRenderer::cache {
+    // whether [begin + offset, begin + offset + size) lies within [begin, end), without overflowing
+    static bool range_fits(uint64_t begin, uint64_t end, uint64_t offset, uint64_t size) {
+        return begin <= end && offset <= end - begin && size <= end - begin - offset;
+    }
+
+    // every range an entry points at stays inside its own section
+    static bool entry_fits(const FileHeader &header, const MeshEntry &entry) {
+        if (entry.indexSize != sizeof(uint16_t) && entry.indexSize != sizeof(uint32_t)) return false;
+        if (entry.lodCount > MESH_MAX_LODS) return false;
+        for (uint32_t i = 0; i < entry.lodCount; i++) {
+            if (!range_fits(0, entry.indexCount, entry.lods[i].indexOffset, entry.lods[i].indexCount)) return false;
+        }
+        return range_fits(header.stringTableOffset, header.vertexDataOffset, entry.texturePathOffset, entry.texturePathLength) &&
+               range_fits(header.vertexDataOffset, header.indexDataOffset, entry.vertexOffset, uint64_t{entry.vertexCount} * sizeof(Vertex)) &&
+               range_fits(header.indexDataOffset, header.meshletDataOffset, entry.indexOffset, uint64_t{entry.indexCount} * entry.indexSize) &&
+               range_fits(header.meshletDataOffset, header.transformDataOffset, uint64_t{entry.meshletOffset} * sizeof(Meshlet),
+                          uint64_t{entry.meshletCount} * sizeof(Meshlet)) &&
+               range_fits(header.transformDataOffset, header.fileSize, uint64_t{entry.transformOffset} * sizeof(glm::mat4),
+                          uint64_t{entry.transformCount} * sizeof(glm::mat4));
+    }
+
+    static uint64_t align_up(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    MappedFile::~MappedFile() {
+        close();
+    }
+
+    bool MappedFile::open(const std::string &filePath) {
+        close();
+#ifdef _WIN32
+        HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return false;
+        }
+
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+
+        _file = file;
+        _mapping = mapping;
+        _data = static_cast<const uint8_t *>(view);
+        _size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(filePath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat fileStat{};
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        void *view = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) {
+            return false;
+        }
+
+        _data = static_cast<const uint8_t *>(view);
+        _size = static_cast<size_t>(fileStat.st_size);
+#endif
+        return true;
+    }
+
+    void MappedFile::close() {
+        if (!_data) return;
+#ifdef _WIN32
+        UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+        _mapping = nullptr;
+        _file = nullptr;
+#else
+        munmap(const_cast<uint8_t *>(_data), _size);
+#endif
+        _data = nullptr;
+        _size = 0;
+    }
+
+    bool MeshCache::open(const std::string &sourcePath, uint32_t importFlags, uint32_t importOptions) {
+        int64_t sourceTime;
+        uint64_t sourceSize;
+        if (!source_stamp(sourcePath, sourceTime, sourceSize)) {
+            return false;
+        }
+
+        if (!_file.open(cache_path(sourcePath))) {
+            return false;
+        }
+
+        // validate header against the source file
+        bool valid = _file.size() >= sizeof(FileHeader);
+        if (valid) {
+            _header = reinterpret_cast<const FileHeader *>(_file.data());
+            valid = _header->magic == MESH_CACHE_MAGIC &&
+                    _header->version == MESH_CACHE_VERSION &&
+                    _header->importFlags == importFlags &&
+                    _header->importOptions == importOptions &&
+                    _header->sourceTime == sourceTime &&
+                    _header->sourceSize == sourceSize &&
+                    _header->fileSize == _file.size() &&
+                    range_fits(_header->meshTableOffset, _header->stringTableOffset, 0, uint64_t{_header->meshCount} * sizeof(MeshEntry)) &&
+                    range_fits(_header->stringTableOffset, _header->vertexDataOffset, _header->sourcePathOffset, _header->sourcePathLength) &&
+                    _header->vertexDataOffset <= _header->indexDataOffset && _header->indexDataOffset <= _header->meshletDataOffset &&
+                    _header->meshletDataOffset <= _header->transformDataOffset && _header->transformDataOffset <= _header->fileSize;
+        }
+
+        // a damaged file can keep a plausible header, so every mesh's data must be inside it too
+        for (uint32_t i = 0; valid && i < _header->meshCount; i++) {
+            valid = entry_fits(*_header, mesh_entry(i));
+        }
+
+        // the path hash could collide, so compare the stored path too
+        if (valid) {
+            const char *storedPath = reinterpret_cast<const char *>(_file.data() + _header->stringTableOffset + _header->sourcePathOffset);
+            valid = sourcePath == std::string(storedPath, _header->sourcePathLength);
+        }
+
+        if (!valid) {
+            std::cout << "Mesh cache for " << sourcePath << " is stale, rebuilding" << std::endl;
+            _file.close();
+            _header = nullptr;
+            return false;
+        }
+
+        std::cout << "Loaded mesh cache for " << sourcePath << std::endl;
+        return true;
+    }
+
+    uint32_t MeshCache::mesh_count() const {
+        return _header->meshCount;
+    }
+
+    const MeshEntry &MeshCache::mesh_entry(uint32_t index) const {
+        return reinterpret_cast<const MeshEntry *>(_file.data() + _header->meshTableOffset)[index];
+    }
+
+    const Vertex *MeshCache::vertices(uint32_t index) const {
+        return reinterpret_cast<const Vertex *>(_file.data() + _header->vertexDataOffset + mesh_entry(index).vertexOffset);
+    }
+
+    const uint8_t *MeshCache::index_data(uint32_t index) const {
+        return _file.data() + _header->indexDataOffset + mesh_entry(index).indexOffset;
+    }
+
+    const Meshlet *MeshCache::meshlets(uint32_t index) const {
+        return reinterpret_cast<const Meshlet *>(_file.data() + _header->meshletDataOffset) + mesh_entry(index).meshletOffset;
+    }
+
+    const glm::mat4 *MeshCache::transforms(uint32_t index) const {
+        return reinterpret_cast<const glm::mat4 *>(_file.data() + _header->transformDataOffset) + mesh_entry(index).transformOffset;
+    }
+
+    std::string MeshCache::texture_path(uint32_t index) const {
+        const MeshEntry &entry = mesh_entry(index);
+        const char *path = reinterpret_cast<const char *>(_file.data() + _header->stringTableOffset + entry.texturePathOffset);
+        return {path, entry.texturePathLength};
+    }
+
+    bool MeshCache::write(const std::string &sourcePath, uint32_t importFlags, uint32_t importOptions, const std::vector<Mesh> &meshes) {
+        FileHeader header = {};
+        header.magic = MESH_CACHE_MAGIC;
+        header.version = MESH_CACHE_VERSION;
+        header.importFlags = importFlags;
+        header.importOptions = importOptions;
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        if (!source_stamp(sourcePath, header.sourceTime, header.sourceSize)) {
+            return false;
+        }
+
+        // build mesh table and string table, source path goes first
+        std::vector<MeshEntry> entries(meshes.size());
+        std::string strings = sourcePath;
+        header.sourcePathOffset = 0;
+        header.sourcePathLength = static_cast<uint32_t>(sourcePath.size());
+
+        uint64_t vertexBytes = 0;
+        uint64_t indexBytes = 0;
+        uint32_t meshletCount = 0;
+        uint32_t transformCount = 0;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            entries[i].vertexOffset = vertexBytes;
+            entries[i].vertexCount = static_cast<uint32_t>(meshes[i]._vertices.size());
+            entries[i].indexOffset = indexBytes;
+            entries[i].indexCount = static_cast<uint32_t>(meshes[i]._indices.size());
+            entries[i].indexSize = static_cast<uint32_t>(meshes[i].index_size());
+            entries[i].meshletOffset = meshletCount;
+            entries[i].meshletCount = static_cast<uint32_t>(meshes[i]._meshlets.size());
+            entries[i].lodCount = static_cast<uint32_t>(std::min<size_t>(meshes[i]._lods.size(), MESH_MAX_LODS));
+            std::copy_n(meshes[i]._lods.begin(), entries[i].lodCount, entries[i].lods);
+            meshletCount += entries[i].meshletCount;
+            entries[i].transformOffset = transformCount;
+            entries[i].transformCount = static_cast<uint32_t>(meshes[i]._transforms.size());
+            transformCount += entries[i].transformCount;
+            entries[i].texturePathOffset = static_cast<uint32_t>(strings.size());
+            entries[i].texturePathLength = static_cast<uint32_t>(meshes[i]._texturePath.size());
+            strings += meshes[i]._texturePath;
+
+            vertexBytes = align_up(vertexBytes + entries[i].vertexCount * sizeof(Vertex), 16);
+            indexBytes = align_up(indexBytes + entries[i].indexCount * entries[i].indexSize, 16);
+        }
+
+        // lay out sections
+        header.meshTableOffset = align_up(sizeof(FileHeader), 16);
+        header.stringTableOffset = header.meshTableOffset + entries.size() * sizeof(MeshEntry);
+        header.vertexDataOffset = align_up(header.stringTableOffset + strings.size(), 16);
+        header.indexDataOffset = header.vertexDataOffset + vertexBytes;
+        header.meshletDataOffset = header.indexDataOffset + indexBytes;
+        header.transformDataOffset = align_up(header.meshletDataOffset + meshletCount * sizeof(Meshlet), 16);
+        header.fileSize = header.transformDataOffset + transformCount * sizeof(glm::mat4);
+
+        std::vector<uint8_t> fileData(header.fileSize, 0);
+        memcpy(fileData.data(), &header, sizeof(FileHeader));
+        memcpy(fileData.data() + header.meshTableOffset, entries.data(), entries.size() * sizeof(MeshEntry));
+        memcpy(fileData.data() + header.stringTableOffset, strings.data(), strings.size());
+        for (size_t i = 0; i < meshes.size(); i++) {
+            memcpy(fileData.data() + header.vertexDataOffset + entries[i].vertexOffset, meshes[i]._vertices.data(), entries[i].vertexCount * sizeof(Vertex));
+            uint8_t *indexData = fileData.data() + header.indexDataOffset + entries[i].indexOffset;
+            if (meshes[i]._indexType == VK_INDEX_TYPE_UINT16) {
+                // stored at draw width so small meshes take half the space
+                std::vector<uint16_t> narrowed(meshes[i]._indices.begin(), meshes[i]._indices.end());
+                memcpy(indexData, narrowed.data(), entries[i].indexCount * sizeof(uint16_t));
+            } else {
+                memcpy(indexData, meshes[i]._indices.data(), entries[i].indexCount * sizeof(uint32_t));
+            }
+            memcpy(fileData.data() + header.meshletDataOffset + entries[i].meshletOffset * sizeof(Meshlet), meshes[i]._meshlets.data(),
+                   entries[i].meshletCount * sizeof(Meshlet));
+            memcpy(fileData.data() + header.transformDataOffset + entries[i].transformOffset * sizeof(glm::mat4), meshes[i]._transforms.data(),
+                   entries[i].transformCount * sizeof(glm::mat4));
+        }
+
+        // write to a temporary file and swap it in, so a crash never leaves a torn entry
+        std::error_code error;
+        std::filesystem::create_directories(MESH_CACHE_DIRECTORY, error);
+        std::string finalPath = cache_path(sourcePath);
+        std::string tempPath = finalPath + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cout << "Failed to write mesh cache " << tempPath << std::endl;
+                return false;
+            }
+            file.write(reinterpret_cast<const char *>(fileData.data()), static_cast<std::streamsize>(fileData.size()));
+            if (!file.good()) {
+                std::cout << "Failed to write mesh cache " << tempPath << std::endl;
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, finalPath, error);
+        if (error) {
+            std::cout << "Failed to replace mesh cache " << finalPath << std::endl;
+            std::filesystem::remove(tempPath, error);
+            return false;
+        }
+
+        std::cout << "Wrote mesh cache for " << sourcePath << std::endl;
+        return true;
+    }
+
+    std::string MeshCache::cache_path(const std::string &sourcePath) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.meshcache", static_cast<unsigned long long>(std::hash<std::string>()(sourcePath)));
+        return std::string(MESH_CACHE_DIRECTORY) + name;
+    }
+
+    bool MeshCache::source_stamp(const std::string &sourcePath, int64_t &time, uint64_t &size) {
+        std::error_code error;
+        auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+        if (error) return false;
+        size = std::filesystem::file_size(sourcePath, error);
+        if (error) return false;
+        time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+
+        return true;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vk/vertex.h>
+#include <vk/meshlet.h>
+#include <vk/mesh_lod.h>
+#include <vk/mesh.h>
+
+namespace VkRenderer::cache {
+    constexpr uint32_t MESH_CACHE_MAGIC = 0x48534D56; // "VMSH"
+    constexpr uint32_t MESH_CACHE_VERSION = 6;
+    constexpr const char *MESH_CACHE_DIRECTORY = "../cache/";
+
+    // on-disk layout: FileHeader, MeshEntry table, string table, vertex blob, index blob, meshlet blob, transform blob
+    // blobs are 16-byte aligned so they can be copied straight out of the mapping
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t importFlags;
+        uint32_t importOptions;
+        uint32_t meshCount;
+        uint32_t padding;
+        int64_t sourceTime;
+        uint64_t sourceSize;
+        uint32_t sourcePathOffset;
+        uint32_t sourcePathLength;
+        uint64_t meshTableOffset;
+        uint64_t stringTableOffset;
+        uint64_t vertexDataOffset;
+        uint64_t indexDataOffset;
+        uint64_t meshletDataOffset;
+        uint64_t transformDataOffset;
+        uint64_t fileSize;
+    };
+
+    struct MeshEntry {
+        uint64_t vertexOffset; // bytes, relative to vertex blob
+        uint64_t indexOffset; // bytes, relative to index blob
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexSize; // bytes per index, the width the mesh is drawn with
+        uint32_t meshletOffset; // meshlets, relative to meshlet blob
+        uint32_t meshletCount;
+        uint32_t transformOffset; // matrices, relative to transform blob
+        uint32_t transformCount;
+        uint32_t texturePathOffset; // bytes, relative to string table
+        uint32_t texturePathLength;
+        uint32_t lodCount;
+        MeshLod lods[MESH_MAX_LODS]; // offsets relative to the mesh's indices
+    };
+
+    class MappedFile {
+    public:
+        ~MappedFile();
+
+        bool open(const std::string &filePath);
+
+        void close();
+
+        [[nodiscard]] const uint8_t *data() const { return _data; }
+
+        [[nodiscard]] size_t size() const { return _size; }
+
+    private:
+        const uint8_t *_data = nullptr;
+        size_t _size = 0;
+#ifdef _WIN32
+        void *_file = nullptr;
+        void *_mapping = nullptr;
+#endif
+    };
+
+    class MeshCache {
+    public:
+        // map the cache entry for a source file, fails if missing or stale
+        bool open(const std::string &sourcePath, uint32_t importFlags, uint32_t importOptions);
+
+        [[nodiscard]] uint32_t mesh_count() const;
+
+        [[nodiscard]] const MeshEntry &mesh_entry(uint32_t index) const;
+
+        [[nodiscard]] const Vertex *vertices(uint32_t index) const;
+
+        // mesh_entry(index).indexSize bytes per index
+        [[nodiscard]] const uint8_t *index_data(uint32_t index) const;
+
+        [[nodiscard]] const Meshlet *meshlets(uint32_t index) const;
+
+        [[nodiscard]] const glm::mat4 *transforms(uint32_t index) const;
+
+        [[nodiscard]] std::string texture_path(uint32_t index) const;
+
+        // serialize processed meshes, replacing any existing entry
+        static bool write(const std::string &sourcePath, uint32_t importFlags, uint32_t importOptions, const std::vector<Mesh> &meshes);
+
+    private:
+        MappedFile _file;
+        const FileHeader *_header = nullptr;
+
+        static std::string cache_path(const std::string &sourcePath);
+
+        static bool source_stamp(const std::string &sourcePath, int64_t &time, uint64_t &size);
+    };
+}
@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+#include <vk/utils.h>
+#include <vk/mesh_optimize.h>
+
+#include "mesh_lod.h"
+
+namespace VkRenderer::lod {
+    // levels that keep more than this fraction of the previous level's triangles aren't worth storing
+    constexpr float LOD_MIN_REDUCTION = 0.85f;
+    constexpr size_t LOD_MIN_TRIANGLES = 16;
+    // collapses may rotate a face by at most this much (dot of the normals)
+    constexpr double MAX_NORMAL_CHANGE = 0.2;
+
+    // sum of area weighted plane equations, evaluates to the squared distance to those planes
+    struct Quadric {
+        double a2, b2, c2, d2, ab, ac, ad, bc, bd, cd, weight;
+
+        void add(const Quadric &other) {
+            a2 += other.a2;
+            b2 += other.b2;
+            c2 += other.c2;
+            d2 += other.d2;
+            ab += other.ab;
+            ac += other.ac;
+            ad += other.ad;
+            bc += other.bc;
+            bd += other.bd;
+            cd += other.cd;
+            weight += other.weight;
+        }
+
+        [[nodiscard]] double evaluate(const glm::vec3 &p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double error = a2 * x * x + b2 * y * y + c2 * z * z + d2 +
+                           2.0 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+            return std::max(error, 0.0);
+        }
+    };
+
+    static Quadric plane_quadric(double a, double b, double c, double d, double weight) {
+        return {a * a * weight, b * b * weight, c * c * weight, d * d * weight, a * b * weight, a * c * weight, a * d * weight,
+                b * c * weight, b * d * weight, c * d * weight, weight};
+    }
+
+    static glm::vec3 triangle_normal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2) {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+
+    static uint64_t edge_key(uint32_t a, uint32_t b) {
+        return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+    }
+
+    struct PositionHash {
+        const std::vector<Vertex> *vertices;
+
+        size_t operator()(uint32_t index) const {
+            return VkRenderer::utils::hash_bytes(&(*vertices)[index].position, sizeof(glm::vec3));
+        }
+    };
+
+    struct PositionEqual {
+        const std::vector<Vertex> *vertices;
+
+        bool operator()(uint32_t a, uint32_t b) const {
+            return memcmp(&(*vertices)[a].position, &(*vertices)[b].position, sizeof(glm::vec3)) == 0;
+        }
+    };
+
+    std::vector<uint32_t> simplify(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, size_t targetIndexCount, float &error) {
+        const size_t vertexCount = vertices.size();
+        error = 0.0f;
+
+        // vertices at the same position differ in other attributes (uv seams), they're tracked as one for topology
+        std::unordered_map<uint32_t, uint32_t, PositionHash, PositionEqual> unique(vertexCount, PositionHash{&vertices}, PositionEqual{&vertices});
+        std::vector<uint32_t> positionGroup(vertexCount);
+        std::vector<uint32_t> groupSize(vertexCount, 0);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            positionGroup[i] = unique.emplace(i, i).first->second;
+            groupSize[positionGroup[i]]++;
+        }
+
+        // seams and open or non-manifold edges are locked so the silhouette and texture mapping stay intact
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                edgeUses[edge_key(positionGroup[indices[i + k]], positionGroup[indices[i + (k + 1) % 3]])]++;
+            }
+        }
+        std::vector<bool> lockedGroup(vertexCount, false);
+        for (auto &it: edgeUses) {
+            if (it.second != 2) {
+                lockedGroup[it.first >> 32] = true;
+                lockedGroup[it.first & 0xFFFFFFFF] = true;
+            }
+        }
+        std::vector<bool> locked(vertexCount);
+        for (uint32_t i = 0; i < vertexCount; i++) {
+            locked[i] = lockedGroup[positionGroup[i]] || groupSize[positionGroup[i]] > 1;
+        }
+
+        // unlocked vertices are alone in their group, so quadrics can be kept per vertex
+        std::vector<Quadric> quadrics(vertexCount, Quadric{});
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            const glm::vec3 &p0 = vertices[indices[i]].position;
+            glm::vec3 normal = triangle_normal(p0, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position);
+            float length = glm::length(normal);
+            if (length == 0.0f) continue;
+            normal = normal / length;
+            Quadric quadric = plane_quadric(normal.x, normal.y, normal.z, -glm::dot(normal, p0), length * 0.5f);
+            for (int k = 0; k < 3; k++) {
+                quadrics[indices[i + k]].add(quadric);
+            }
+        }
+
+        std::vector<uint32_t> result = indices;
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> fill;
+        std::vector<uint32_t> remap(vertexCount);
+        std::vector<bool> touched(vertexCount);
+        std::vector<double> bestCost(vertexCount);
+        std::vector<uint32_t> bestTarget(vertexCount);
+        std::vector<uint32_t> candidates;
+        double maxCost = 0.0;
+
+        auto collapse_cost = [&](uint32_t from, uint32_t to) {
+            Quadric quadric = quadrics[from];
+            quadric.add(quadrics[to]);
+            return quadric.weight > 0.0 ? quadric.evaluate(vertices[to].position) / quadric.weight : 0.0;
+        };
+
+        // every pass collapses an independent set of edges, cheapest first
+        while (result.size() > targetIndexCount) {
+            std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+            for (uint32_t index: result) {
+                adjacencyOffsets[index + 1]++;
+            }
+            for (size_t i = 0; i < vertexCount; i++) {
+                adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+            }
+            adjacency.resize(result.size());
+            fill.assign(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++) {
+                adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+
+            // cheapest collapse out of each unlocked vertex along its edges
+            std::fill(bestCost.begin(), bestCost.end(), std::numeric_limits<double>::max());
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (int k = 0; k < 3; k++) {
+                    uint32_t from = result[i + k];
+                    uint32_t to = result[i + (k + 1) % 3];
+                    if (locked[from]) continue;
+                    double cost = collapse_cost(from, to);
+                    if (cost < bestCost[from]) {
+                        bestCost[from] = cost;
+                        bestTarget[from] = to;
+                    }
+                }
+            }
+            candidates.clear();
+            for (uint32_t i = 0; i < vertexCount; i++) {
+                if (bestCost[i] != std::numeric_limits<double>::max()) {
+                    candidates.push_back(i);
+                }
+            }
+            std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+                return bestCost[a] < bestCost[b] || (bestCost[a] == bestCost[b] && a < b);
+            });
+
+            // a collapse removes about two triangles
+            const size_t collapseLimit = std::max<size_t>((result.size() - targetIndexCount) / 6, 1);
+            size_t collapses = 0;
+            std::fill(touched.begin(), touched.end(), false);
+            for (uint32_t i = 0; i < vertexCount; i++) {
+                remap[i] = i;
+            }
+
+            for (uint32_t from: candidates) {
+                if (collapses >= collapseLimit) break;
+                uint32_t to = bestTarget[from];
+                if (touched[from] || touched[to]) continue;
+
+                // reject collapses that fold or flip the faces around from
+                bool flips = false;
+                const glm::vec3 &target = vertices[to].position;
+                for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1] && !flips; a++) {
+                    const uint32_t *triangle = &result[adjacency[a] * 3];
+                    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+                    glm::vec3 p[3];
+                    glm::vec3 moved[3];
+                    for (int k = 0; k < 3; k++) {
+                        p[k] = vertices[triangle[k]].position;
+                        moved[k] = triangle[k] == from ? target : p[k];
+                    }
+                    glm::vec3 before = triangle_normal(p[0], p[1], p[2]);
+                    glm::vec3 after = triangle_normal(moved[0], moved[1], moved[2]);
+                    double lengths = static_cast<double>(glm::length(before)) * glm::length(after);
+                    flips = lengths == 0.0 || glm::dot(before, after) <= MAX_NORMAL_CHANGE * lengths;
+                }
+                if (flips) continue;
+
+                // the neighbourhood stays fixed for the rest of the pass so the flip test above holds
+                for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; a++) {
+                    const uint32_t *triangle = &result[adjacency[a] * 3];
+                    touched[triangle[0]] = true;
+                    touched[triangle[1]] = true;
+                    touched[triangle[2]] = true;
+                }
+
+                remap[from] = to;
+                quadrics[to].add(quadrics[from]);
+                maxCost = std::max(maxCost, bestCost[from]);
+                collapses++;
+            }
+            if (collapses == 0) break;
+
+            // drop triangles that lost an edge, including ones collapsed onto two wedges of a seam
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                uint32_t a = remap[result[i]];
+                uint32_t b = remap[result[i + 1]];
+                uint32_t c = remap[result[i + 2]];
+                if (positionGroup[a] == positionGroup[b] || positionGroup[b] == positionGroup[c] || positionGroup[a] == positionGroup[c]) continue;
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        error = static_cast<float>(std::sqrt(maxCost));
+        return result;
+    }
+
+    std::vector<MeshLod> build_lods(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, uint32_t maxLods) {
+        std::vector<MeshLod> lods;
+        lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+        // each level simplifies the previous one, so errors add up
+        std::vector<uint32_t> previous = indices;
+        while (lods.size() < maxLods) {
+            size_t target = static_cast<size_t>(static_cast<float>(previous.size() / 3) * MESH_LOD_REDUCTION) * 3;
+            if (target < LOD_MIN_TRIANGLES * 3) break;
+
+            float error;
+            std::vector<uint32_t> level = simplify(vertices, previous, target, error);
+            if (level.empty() || static_cast<float>(level.size()) > static_cast<float>(previous.size()) * LOD_MIN_REDUCTION) break;
+
+            VkRenderer::optimize::optimize_vertex_cache(level, vertices.size());
+            lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(level.size()), lods.back().error + error});
+            indices.insert(indices.end(), level.begin(), level.end());
+            previous = std::move(level);
+        }
+
+        return lods;
+    }
+}
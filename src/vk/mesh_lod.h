@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vk/vertex.h>
+
+namespace VkRenderer {
+    // levels per mesh including the full detail one
+    constexpr uint32_t MESH_MAX_LODS = 6;
+    // each level aims for this fraction of the previous one's triangles
+    constexpr float MESH_LOD_REDUCTION = 0.5f;
+
+    // one detail level, every level shares the mesh's vertices
+    struct MeshLod {
+        uint32_t indexOffset; // into the mesh's indices
+        uint32_t indexCount;
+        float error; // model space distance from the full detail surface
+    };
+
+    struct LodStats {
+        size_t meshCount = 0;
+        size_t reducedMeshCount = 0;
+        size_t baseTriangles = 0;
+        size_t selectedTriangles = 0;
+    };
+}
+
+namespace VkRenderer::lod {
+    // collapse edges in order of quadric error until at most targetIndexCount indices remain or nothing can collapse,
+    // vertices only move onto existing ones so the result indexes the same vertex buffer
+    std::vector<uint32_t> simplify(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, size_t targetIndexCount, float &error);
+
+    // level 0 is indices as they are, coarser levels are appended to indices
+    std::vector<MeshLod> build_lods(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, uint32_t maxLods = MESH_MAX_LODS);
+}
@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vk/utils.h>
+
+#include "mesh_optimize.h"
+
+namespace VkRenderer::optimize {
+    // Forsyth scoring parameters
+    constexpr uint32_t SCORE_CACHE_SIZE = 32;
+    constexpr float CACHE_DECAY_POWER = 1.5f;
+    constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+    constexpr float VALENCE_BOOST_SCALE = 2.0f;
+    constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+    // overdraw rasterizer resolution per view
+    constexpr int OVERDRAW_GRID_SIZE = 256;
+
+    struct VertexHash {
+        const std::vector<Vertex> *vertices;
+
+        size_t operator()(uint32_t index) const {
+            return VkRenderer::utils::hash_bytes(&(*vertices)[index], sizeof(Vertex));
+        }
+    };
+
+    struct VertexEqual {
+        const std::vector<Vertex> *vertices;
+
+        bool operator()(uint32_t a, uint32_t b) const {
+            return memcmp(&(*vertices)[a], &(*vertices)[b], sizeof(Vertex)) == 0;
+        }
+    };
+
+    size_t weld_vertices(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+        std::unordered_map<uint32_t, uint32_t, VertexHash, VertexEqual> unique(vertices.size(), VertexHash{&vertices}, VertexEqual{&vertices});
+        std::vector<uint32_t> remap(vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(vertices.size());
+        for (uint32_t i = 0; i < vertices.size(); i++) {
+            auto [it, inserted] = unique.emplace(i, static_cast<uint32_t>(welded.size()));
+            if (inserted) {
+                welded.push_back(vertices[i]);
+            }
+            remap[i] = it->second;
+        }
+
+        for (uint32_t &index: indices) {
+            index = remap[index];
+        }
+        size_t removed = vertices.size() - welded.size();
+        vertices = std::move(welded);
+        return removed;
+    }
+
+    static float vertex_score(int cachePosition, uint32_t remainingTriangles) {
+        if (remainingTriangles == 0) return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // the last triangle's vertices score a fixed amount so it isn't simply repeated
+                score = LAST_TRIANGLE_SCORE;
+            } else {
+                float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+                score = std::pow(1.0f - static_cast<float>(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        // favour vertices with few triangles left so they can be finished off
+        score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+        return score;
+    }
+
+    void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertexCount) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return;
+
+        // vertex to triangle adjacency
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (uint32_t index: indices) remaining[index]++;
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; i++) offsets[i + 1] = offsets[i] + remaining[i];
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++) vertexScores[i] = vertex_score(-1, remaining[i]);
+
+        std::vector<bool> emitted(triangleCount, false);
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> newCache;
+        size_t scanPosition = 0;
+        int64_t bestTriangle = -1;
+
+        for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++) {
+            if (bestTriangle < 0) {
+                // nothing in the cache has work left, take the next unemitted triangle
+                while (emitted[scanPosition]) scanPosition++;
+                bestTriangle = static_cast<int64_t>(scanPosition);
+            }
+
+            auto triangle = static_cast<size_t>(bestTriangle);
+            emitted[triangle] = true;
+            const uint32_t *corners = &indices[triangle * 3];
+            result.insert(result.end(), corners, corners + 3);
+
+            // drop the triangle from its vertices' adjacency
+            for (int k = 0; k < 3; k++) {
+                uint32_t vertex = corners[k];
+                uint32_t *begin = &adjacency[offsets[vertex]];
+                uint32_t *end = begin + remaining[vertex];
+                *std::find(begin, end, static_cast<uint32_t>(triangle)) = *(end - 1);
+                remaining[vertex]--;
+            }
+
+            // move its vertices to the front of the LRU cache
+            newCache.assign(corners, corners + 3);
+            for (uint32_t vertex: cache) {
+                if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) {
+                    newCache.push_back(vertex);
+                }
+            }
+            for (size_t i = SCORE_CACHE_SIZE; i < newCache.size(); i++) {
+                cachePosition[newCache[i]] = -1;
+                vertexScores[newCache[i]] = vertex_score(-1, remaining[newCache[i]]);
+            }
+            if (newCache.size() > SCORE_CACHE_SIZE) newCache.resize(SCORE_CACHE_SIZE);
+            std::swap(cache, newCache);
+
+            // rescore cached vertices and find the best triangle touching them
+            for (size_t i = 0; i < cache.size(); i++) {
+                cachePosition[cache[i]] = static_cast<int>(i);
+                vertexScores[cache[i]] = vertex_score(static_cast<int>(i), remaining[cache[i]]);
+            }
+            float bestScore = -1.0f;
+            bestTriangle = -1;
+            for (uint32_t vertex: cache) {
+                for (uint32_t i = 0; i < remaining[vertex]; i++) {
+                    uint32_t t = adjacency[offsets[vertex] + i];
+                    float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                    if (score > bestScore) {
+                        bestScore = score;
+                        bestTriangle = t;
+                    }
+                }
+            }
+        }
+
+        indices = std::move(result);
+    }
+
+    // simulates a FIFO cache, returns misses for the triangle and updates the cache
+    struct FifoCache {
+        std::vector<uint32_t> timestamps;
+        uint32_t time;
+        uint32_t size;
+
+        FifoCache(size_t vertexCount, uint32_t cacheSize) : timestamps(vertexCount, 0), time(cacheSize + 1), size(cacheSize) {}
+
+        uint32_t add_triangle(const uint32_t *corners) {
+            uint32_t misses = 0;
+            for (int k = 0; k < 3; k++) {
+                if (time - timestamps[corners[k]] > size) {
+                    timestamps[corners[k]] = time++;
+                    misses++;
+                }
+            }
+            return misses;
+        }
+
+        void reset() {
+            time += size + 1;
+        }
+    };
+
+    float analyze_acmr(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return 0.0f;
+
+        FifoCache cache(vertexCount, cacheSize);
+        size_t misses = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            misses += cache.add_triangle(&indices[t * 3]);
+        }
+        return static_cast<float>(misses) / static_cast<float>(triangleCount);
+    }
+
+    void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices, float threshold) {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0) return;
+
+        // hard boundaries where the cache starts over, every vertex of the triangle missed
+        std::vector<size_t> clusters;
+        FifoCache cache(vertices.size(), VERTEX_CACHE_SIZE);
+        std::vector<uint32_t> misses(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            misses[t] = cache.add_triangle(&indices[t * 3]);
+            if (t == 0 || misses[t] == 3) clusters.push_back(t);
+        }
+        clusters.push_back(triangleCount);
+
+        // split further wherever the running ACMR is already as good as the whole cluster's
+        std::vector<size_t> softClusters;
+        for (size_t c = 0; c + 1 < clusters.size(); c++) {
+            size_t start = clusters[c];
+            size_t end = clusters[c + 1];
+            uint32_t clusterMisses = 0;
+            for (size_t t = start; t < end; t++) clusterMisses += misses[t];
+            float clusterThreshold = static_cast<float>(clusterMisses) / static_cast<float>(end - start) * threshold;
+
+            cache.reset();
+            softClusters.push_back(start);
+            size_t runStart = start;
+            uint32_t runMisses = 0;
+            for (size_t t = start; t < end; t++) {
+                runMisses += cache.add_triangle(&indices[t * 3]);
+                if (t + 1 < end && static_cast<float>(runMisses) / static_cast<float>(t + 1 - runStart) <= clusterThreshold) {
+                    softClusters.push_back(t + 1);
+                    runStart = t + 1;
+                    runMisses = 0;
+                    cache.reset();
+                }
+            }
+        }
+        softClusters.push_back(triangleCount);
+
+        // area weighted centroid and normal of each cluster
+        glm::vec3 meshCentroid = glm::vec3(0.0f);
+        for (const Vertex &vertex: vertices) meshCentroid += vertex.position;
+        meshCentroid /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+        size_t clusterCount = softClusters.size() - 1;
+        std::vector<float> sortKeys(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++) {
+            glm::vec3 centroid = glm::vec3(0.0f);
+            glm::vec3 normal = glm::vec3(0.0f);
+            float area = 0.0f;
+            for (size_t t = softClusters[c]; t < softClusters[c + 1]; t++) {
+                const glm::vec3 &p0 = vertices[indices[t * 3]].position;
+                const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].position;
+                const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].position;
+                glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+                float triangleArea = glm::length(cross);
+                centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+                normal += cross;
+                area += triangleArea;
+            }
+            centroid = area > 0.0f ? centroid / area : vertices[indices[softClusters[c] * 3]].position;
+            float normalLength = glm::length(normal);
+            normal = normalLength > 0.0f ? normal / normalLength : glm::vec3(0.0f);
+
+            // clusters on the outside facing out are drawn first, they are likely to occlude the rest
+            sortKeys[c] = glm::dot(centroid - meshCentroid, normal);
+        }
+
+        std::vector<size_t> order(clusterCount);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+        std::vector<uint32_t> result;
+        result.reserve(indices.size());
+        for (size_t c: order) {
+            result.insert(result.end(), indices.begin() + softClusters[c] * 3, indices.begin() + softClusters[c + 1] * 3);
+        }
+        indices = std::move(result);
+    }
+
+    void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+        for (uint32_t &index: indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = static_cast<uint32_t>(reordered.size());
+                reordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(reordered);
+    }
+
+    float analyze_overdraw(const std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices) {
+        if (indices.empty()) return 0.0f;
+
+        glm::vec3 minPosition = vertices[indices[0]].position;
+        glm::vec3 maxPosition = minPosition;
+        for (uint32_t index: indices) {
+            minPosition = glm::min(minPosition, vertices[index].position);
+            maxPosition = glm::max(maxPosition, vertices[index].position);
+        }
+        glm::vec3 extent = maxPosition - minPosition;
+        float scale = static_cast<float>(OVERDRAW_GRID_SIZE - 1) / std::max({extent.x, extent.y, extent.z, 1e-6f});
+
+        std::vector<float> depth(OVERDRAW_GRID_SIZE * OVERDRAW_GRID_SIZE);
+        size_t shaded = 0;
+        size_t covered = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            for (float direction: {1.0f, -1.0f}) {
+                std::fill(depth.begin(), depth.end(), 2.0f);
+                int u = (axis + 1) % 3;
+                int v = (axis + 2) % 3;
+
+                for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                    // project onto the grid, depth normalized to [0, 1]
+                    glm::vec3 p[3];
+                    for (int k = 0; k < 3; k++) {
+                        glm::vec3 local = (vertices[indices[t + k]].position - minPosition) * scale;
+                        float z = local[axis] / static_cast<float>(OVERDRAW_GRID_SIZE);
+                        // mirror one axis when looking down the positive direction so front faces keep positive area
+                        p[k] = glm::vec3(local[u], direction > 0.0f ? static_cast<float>(OVERDRAW_GRID_SIZE - 1) - local[v] : local[v],
+                                         direction > 0.0f ? z : 1.0f - z);
+                    }
+
+                    // back faces are culled, as they would be on the GPU
+                    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[2].x - p[0].x) * (p[1].y - p[0].y);
+                    if (area <= 0.0f) continue;
+
+                    int minX = std::max(0, static_cast<int>(std::floor(std::min({p[0].x, p[1].x, p[2].x}))));
+                    int maxX = std::min(OVERDRAW_GRID_SIZE - 1, static_cast<int>(std::ceil(std::max({p[0].x, p[1].x, p[2].x}))));
+                    int minY = std::max(0, static_cast<int>(std::floor(std::min({p[0].y, p[1].y, p[2].y}))));
+                    int maxY = std::min(OVERDRAW_GRID_SIZE - 1, static_cast<int>(std::ceil(std::max({p[0].y, p[1].y, p[2].y}))));
+                    for (int y = minY; y <= maxY; y++) {
+                        for (int x = minX; x <= maxX; x++) {
+                            float px = static_cast<float>(x) + 0.5f;
+                            float py = static_cast<float>(y) + 0.5f;
+                            float w0 = (p[2].x - p[1].x) * (py - p[1].y) - (p[2].y - p[1].y) * (px - p[1].x);
+                            float w1 = (p[0].x - p[2].x) * (py - p[2].y) - (p[0].y - p[2].y) * (px - p[2].x);
+                            float w2 = (p[1].x - p[0].x) * (py - p[0].y) - (p[1].y - p[0].y) * (px - p[0].x);
+                            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+                            float z = (w0 * p[0].z + w1 * p[1].z + w2 * p[2].z) / area;
+                            float &stored = depth[y * OVERDRAW_GRID_SIZE + x];
+                            if (z < stored) {
+                                if (stored > 1.0f) covered++;
+                                stored = z;
+                                shaded++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        return covered > 0 ? static_cast<float>(shaded) / static_cast<float>(covered) : 0.0f;
+    }
+
+    MeshReport optimize_mesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices) {
+        MeshReport report = {};
+        report.vertexCountBefore = vertices.size();
+        report.acmrBefore = analyze_acmr(indices, vertices.size());
+        report.overdrawBefore = analyze_overdraw(indices, vertices);
+
+        weld_vertices(vertices, indices);
+        optimize_vertex_cache(indices, vertices.size());
+        optimize_overdraw(indices, vertices);
+        optimize_vertex_fetch(vertices, indices);
+
+        report.vertexCountAfter = vertices.size();
+        report.acmrAfter = analyze_acmr(indices, vertices.size());
+        report.overdrawAfter = analyze_overdraw(indices, vertices);
+        return report;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <vk/vertex.h>
+
+namespace VkRenderer::optimize {
+    // FIFO cache size used for ACMR and overdraw clustering, close to what post-transform caches behave like
+    constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+    // clusters may be split for overdraw ordering as long as ACMR stays within this factor
+    constexpr float OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+    struct MeshReport {
+        size_t vertexCountBefore;
+        size_t vertexCountAfter;
+        float acmrBefore;
+        float acmrAfter;
+        float overdrawBefore;
+        float overdrawAfter;
+    };
+
+    // merge bitwise identical vertices, returns the number removed
+    size_t weld_vertices(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+    // reorder triangles for post-transform cache hits (Forsyth's linear-speed optimizer)
+    void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+    // reorder cache-friendly clusters of triangles so outward facing ones draw first
+    void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices, float threshold = OVERDRAW_ACMR_THRESHOLD);
+
+    // renumber vertices in order of first use, unused vertices are dropped
+    void optimize_vertex_fetch(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+
+    // average cache misses per triangle with a FIFO cache
+    float analyze_acmr(const std::vector<uint32_t> &indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+    // shaded over covered pixels, rasterized with depth testing from the six axis directions
+    float analyze_overdraw(const std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices);
+
+    // every pass in order, measured before and after
+    MeshReport optimize_mesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices);
+}
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "meshlet.h"
+
+namespace VkRenderer::meshlet {
+    // cones wider than this (dot of the axis with the furthest normal) never cull anything
+    constexpr float CONE_MIN_DOT = 0.1f;
+
+    std::vector<Meshlet> build_meshlets(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, uint32_t maxVertices, uint32_t maxTriangles) {
+        const size_t triangleCount = indices.size() / 3;
+        std::vector<Meshlet> meshlets;
+        if (triangleCount == 0) return meshlets;
+
+        // triangles around each vertex
+        std::vector<uint32_t> adjacencyOffsets(vertices.size() + 1, 0);
+        for (uint32_t index: indices) {
+            adjacencyOffsets[index + 1]++;
+        }
+        for (size_t i = 0; i < vertices.size(); i++) {
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++) {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        // meshlet each vertex was last added to, avoids clearing a set per meshlet
+        std::vector<uint32_t> vertexMeshlet(vertices.size(), std::numeric_limits<uint32_t>::max());
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint32_t> reordered;
+        reordered.reserve(indices.size());
+        size_t cursor = 0;
+
+        auto new_vertices = [&](size_t triangle, uint32_t meshletIndex) {
+            uint32_t count = 0;
+            for (int k = 0; k < 3; k++) {
+                count += vertexMeshlet[indices[triangle * 3 + k]] != meshletIndex;
+            }
+            return count;
+        };
+
+        while (reordered.size() < indices.size()) {
+            auto meshletIndex = static_cast<uint32_t>(meshlets.size());
+            Meshlet meshlet{};
+            meshlet.indexOffset = static_cast<uint32_t>(reordered.size());
+            meshletVertices.clear();
+
+            auto add_triangle = [&](size_t triangle) {
+                for (int k = 0; k < 3; k++) {
+                    uint32_t index = indices[triangle * 3 + k];
+                    if (vertexMeshlet[index] != meshletIndex) {
+                        vertexMeshlet[index] = meshletIndex;
+                        meshletVertices.push_back(index);
+                    }
+                    reordered.push_back(index);
+                }
+                emitted[triangle] = true;
+                meshlet.indexCount += 3;
+            };
+
+            while (meshlet.indexCount / 3 < maxTriangles) {
+                // grow through shared vertices, preferring triangles that add the fewest new ones
+                size_t best = triangleCount;
+                uint32_t bestNew = 4;
+                for (size_t v = 0; v < meshletVertices.size() && bestNew > 0; v++) {
+                    uint32_t vertex = meshletVertices[v];
+                    for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+                        uint32_t triangle = adjacency[a];
+                        if (emitted[triangle]) continue;
+                        uint32_t added = new_vertices(triangle, meshletIndex);
+                        if (meshletVertices.size() + added <= maxVertices && (added < bestNew || (added == bestNew && triangle < best))) {
+                            best = triangle;
+                            bestNew = added;
+                        }
+                    }
+                }
+
+                // nothing connected fits, continue with the next triangle in the optimized order
+                if (best == triangleCount) {
+                    while (cursor < triangleCount && emitted[cursor]) cursor++;
+                    if (cursor == triangleCount || meshletVertices.size() + new_vertices(cursor, meshletIndex) > maxVertices) break;
+                    best = cursor;
+                }
+                add_triangle(best);
+            }
+
+            compute_bounds(meshlet, vertices, reordered);
+            meshlets.push_back(meshlet);
+        }
+
+        indices = std::move(reordered);
+        return meshlets;
+    }
+
+    void compute_bounds(Meshlet &meshlet, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) {
+        const uint32_t begin = meshlet.indexOffset;
+        const uint32_t end = meshlet.indexOffset + meshlet.indexCount;
+
+        // sphere around the box center
+        glm::vec3 minPosition(std::numeric_limits<float>::max());
+        glm::vec3 maxPosition(-std::numeric_limits<float>::max());
+        for (uint32_t i = begin; i < end; i++) {
+            minPosition = glm::min(minPosition, vertices[indices[i]].position);
+            maxPosition = glm::max(maxPosition, vertices[indices[i]].position);
+        }
+        glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+        float radius = 0.0f;
+        for (uint32_t i = begin; i < end; i++) {
+            radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+        }
+        meshlet.sphere = glm::vec4(center, radius);
+
+        // cone around the average face normal, degenerate triangles face nowhere and are skipped
+        std::vector<glm::vec3> normals;
+        glm::vec3 axis(0.0f);
+        for (uint32_t i = begin; i < end; i += 3) {
+            glm::vec3 p0 = vertices[indices[i]].position;
+            glm::vec3 normal = glm::cross(vertices[indices[i + 1]].position - p0, vertices[indices[i + 2]].position - p0);
+            float length = glm::length(normal);
+            if (length > 0.0f) {
+                normals.push_back(normal / length);
+                axis = axis + normal / length;
+            }
+        }
+
+        meshlet.cone = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        float axisLength = glm::length(axis);
+        if (normals.empty() || axisLength == 0.0f) return;
+        axis = axis / axisLength;
+
+        float minDot = 1.0f;
+        for (auto &normal: normals) {
+            minDot = std::min(minDot, glm::dot(axis, normal));
+        }
+        if (minDot <= CONE_MIN_DOT) {
+            meshlet.cone = glm::vec4(axis, 1.0f);
+            return;
+        }
+        meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    }
+}
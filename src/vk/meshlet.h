@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <vk/vertex.h>
+
+namespace VkRenderer {
+    // small enough that one workgroup can cull a meshlet and copy out its triangles
+    constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+    constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+    // matches Meshlet in meshlet_cull.comp
+    struct Meshlet {
+        glm::vec4 sphere; // model space, xyz center and w radius
+        glm::vec4 cone; // xyz average facing, w sine of the spread, 1 if it can't be back-face culled
+        uint32_t indexOffset; // into the mesh's indices
+        uint32_t indexCount;
+        uint32_t padding[2];
+    };
+}
+
+namespace VkRenderer::meshlet {
+    // regroup triangles into meshlets of connected geometry, each meshlet's triangles end up contiguous in indices
+    std::vector<Meshlet> build_meshlets(const std::vector<Vertex> &vertices, std::vector<uint32_t> &indices,
+                                        uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    // bounding sphere and normal cone of triangles [indexOffset, indexOffset + indexCount)
+    void compute_bounds(Meshlet &meshlet, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+}
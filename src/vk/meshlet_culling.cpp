@@ -0,0 +1,362 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <vk/check.h>
+#include <vk/info.h>
+#include <vk/utils.h>
+#include <vk/pipeline.h>
+#include <vk/geometry.h>
+#include <vk/draw_data.h>
+#include <vk/depth_pyramid.h>
+#include <vk/texture_table.h>
+
+#include "meshlet_culling.h"
+
+namespace VkRenderer {
+    // largest dispatch dimension every device supports
+    constexpr uint32_t MAX_DISPATCH_GROUPS = 65535;
+
+    void MeshletCuller::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        // meshlets, source indices, draws, jobs, output indices, commands, visibility, depth pyramid
+        VkDescriptorSetLayoutBinding bindings[8];
+        for (uint32_t i = 0; i < 7; i++) {
+            bindings[i] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+        }
+        bindings[7] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT, 7);
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo = VkRenderer::info::descriptor_set_layout_create_info(8, bindings, 0);
+        _setLayout = _resources->descriptorLayoutCache->create_descriptor_layout(&setLayoutInfo);
+
+        VkPushConstantRange pushConstant;
+        pushConstant.offset = 0;
+        pushConstant.size = sizeof(CullPushConstant);
+        pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = VkRenderer::info::pipeline_layout_create_info();
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &_setLayout;
+        VK_CHECK(vkCreatePipelineLayout(_resources->device, &pipelineLayoutInfo, nullptr, &_pipelineLayout));
+
+        VkShaderModule shader;
+        if (!VkRenderer::utils::load_shader_module(_resources->device, "../shaders/meshlet_cull.comp.spv", &shader)) {
+            std::cout << "Error building meshlet culling shader module" << std::endl;
+        }
+        _pipeline = VkRenderer::pipeline::build_compute_pipeline(_resources->device, shader, _pipelineLayout);
+        vkDestroyShaderModule(_resources->device, shader, nullptr);
+
+        // one slot per meshlet in the geometry buffer to start with, cleared when the first models are laid out
+        _visibilityCapacity = std::max<VkDeviceSize>(_resources->geometryBuffer->stats().meshletCapacity / sizeof(Meshlet), 1);
+        _visibilityBuffer = VkRenderer::utils::create_buffer(_resources->allocator, _visibilityCapacity * sizeof(uint32_t),
+                                                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    void MeshletCuller::cull(VkCommandBuffer cmd, uint32_t frameIndex, VkRenderer::descriptor::Allocator *descriptorAllocator,
+                             std::unordered_map<std::string, Model> &models, const glm::mat4 &viewproj, const glm::vec3 &cameraPosition, const DepthPyramid &pyramid,
+                             bool occlusion, DeletionQueue &frameDeletion) {
+        FrameResources &frame = _frames[frameIndex];
+
+        // this frame's fence has been waited on, so last use's results are complete
+        read_results(frame);
+
+        // one draw per mesh, one job per meshlet
+        frame.records.clear();
+        frame.occlusion = occlusion;
+        std::vector<GPUMeshletDraw> draws;
+        std::vector<GPUCullCommand> commands;
+        std::vector<uint32_t> jobs;
+        std::vector<VisibilityKey> visibilityLayout;
+        uint32_t visibilitySlots = 0;
+        uint32_t outputIndices = 0;
+        for (auto &it: models) {
+            // instanced models are drawn with instanceCount instead
+            Model &model = it.second;
+            if (model.instance_count() != 1 || !model.instances_allocated()) continue;
+
+            for (size_t m = 0; m < model.meshes.size(); m++) {
+                Mesh &mesh = model.meshes[m];
+                if (mesh._meshletRange.size == 0 || mesh._indexRange.size == 0) continue;
+
+                // each node transform keeps its own history, laid out whether or not it is drawn this frame so the offsets stay put
+                auto meshletCount = static_cast<uint32_t>(mesh._meshlets.size());
+                auto transformCount = static_cast<uint32_t>(mesh._transforms.size());
+                uint32_t meshVisibility = visibilitySlots;
+                visibilityLayout.push_back({model.id, static_cast<uint32_t>(m), meshletCount, transformCount});
+                visibilitySlots += meshletCount * transformCount;
+
+                // coarser levels have no meshlets and are drawn directly
+                if (mesh._lod != 0) continue;
+
+                // one draw per node transform, culled in that instance's space
+                for (size_t t = 0; t < mesh._transforms.size(); t++) {
+                    if (!mesh.visible(t)) continue;
+
+                    const glm::mat4 &transform = mesh._transforms[t];
+                    uint32_t drawDataIndex = _resources->drawData->add(mesh.draw_data(transform, model.first_instance()));
+                    if (drawDataIndex == DRAW_DATA_FULL) continue;
+
+                    // the matrix the vertex shader reads through the draw data's instance
+                    glm::mat4 matrix = model.instance_matrices()[0] * transform;
+                    glm::vec3 meshCamera = glm::vec3(glm::inverse(matrix) * glm::vec4(cameraPosition, 1.0f));
+                    float maxScale = std::max({glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))});
+
+                    auto drawIndex = static_cast<uint32_t>(draws.size());
+                    GPUMeshletDraw draw{};
+                    draw.matrix = matrix;
+                    draw.cameraPosition = glm::vec4(meshCamera, maxScale);
+                    draw.firstMeshlet = static_cast<uint32_t>(mesh._meshletRange.offset / sizeof(Meshlet));
+                    draw.firstIndex = static_cast<uint32_t>(mesh._indexRange.offset / mesh.index_size());
+                    draw.indexType32 = mesh._indexType == VK_INDEX_TYPE_UINT32;
+                    draw.outputOffset = outputIndices;
+                    draw.visibilityOffset = meshVisibility + static_cast<uint32_t>(t) * meshletCount;
+                    draws.push_back(draw);
+
+                    // the shader adds surviving indices to indexCount
+                    GPUCullCommand command{};
+                    command.command.indexCount = 0;
+                    command.command.instanceCount = 1;
+                    command.command.firstIndex = outputIndices;
+                    command.command.vertexOffset = static_cast<int32_t>(mesh._vertexRange.offset / vertex_stride(mesh._vertexFormat));
+                    command.command.firstInstance = drawDataIndex;
+                    commands.push_back(command);
+
+                    for (uint32_t i = 0; i < mesh._meshlets.size(); i++) {
+                        jobs.push_back(drawIndex);
+                        jobs.push_back(i);
+                    }
+                    outputIndices += mesh._lods[0].indexCount;
+                    frame.records.push_back({&mesh, mesh._material});
+                }
+            }
+        }
+
+        // history of a different set of draws means nothing
+        if (visibilityLayout != _visibilityLayout) {
+            _visibilityLayout = std::move(visibilityLayout);
+            reset_visibility(cmd, visibilitySlots, frameDeletion);
+        }
+
+        auto jobCount = static_cast<uint32_t>(jobs.size() / 2);
+        _stats.drawCount = draws.size();
+        _stats.meshletCount = jobCount;
+        _stats.submittedTriangles = outputIndices / 3;
+        if (jobCount == 0) {
+            frame.records.clear();
+            return;
+        }
+
+        // the late phase's commands follow, its firstIndex is set by the shader once the early phase's count is known
+        size_t drawCount = commands.size();
+        if (occlusion) {
+            commands.insert(commands.end(), commands.begin(), commands.end());
+        }
+
+        // previous contents were consumed before the fence, buffers can be replaced or rewritten
+        reserve(frame.drawBuffer, frame.drawCapacity, draws.size(), sizeof(GPUMeshletDraw), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.commandBuffer, frame.commandCapacity, commands.size(), sizeof(GPUCullCommand),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.jobBuffer, frame.jobCapacity, jobCount, 2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+        reserve(frame.outputBuffer, frame.outputCapacity, outputIndices, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VMA_MEMORY_USAGE_GPU_ONLY);
+
+        void *data;
+        vmaMapMemory(_resources->allocator, frame.drawBuffer._allocation, &data);
+        memcpy(data, draws.data(), draws.size() * sizeof(GPUMeshletDraw));
+        vmaUnmapMemory(_resources->allocator, frame.drawBuffer._allocation);
+        vmaMapMemory(_resources->allocator, frame.commandBuffer._allocation, &data);
+        memcpy(data, commands.data(), commands.size() * sizeof(GPUCullCommand));
+        vmaUnmapMemory(_resources->allocator, frame.commandBuffer._allocation);
+        vmaMapMemory(_resources->allocator, frame.jobBuffer._allocation, &data);
+        memcpy(data, jobs.data(), jobs.size() * sizeof(uint32_t));
+        vmaUnmapMemory(_resources->allocator, frame.jobBuffer._allocation);
+
+        VkRenderer::GeometryStats geometryStats = _resources->geometryBuffer->stats();
+        VkDescriptorBufferInfo meshletInfo = VkRenderer::info::descriptor_buffer_info(_resources->geometryBuffer->meshlet_buffer(), 0,
+                                                                                      static_cast<uint32_t>(geometryStats.meshletCapacity));
+        VkDescriptorBufferInfo sourceInfo = VkRenderer::info::descriptor_buffer_info(_resources->geometryBuffer->index_buffer(), 0,
+                                                                                     static_cast<uint32_t>(geometryStats.indexCapacity));
+        VkDescriptorBufferInfo drawInfo = VkRenderer::info::descriptor_buffer_info(frame.drawBuffer._buffer, 0, static_cast<uint32_t>(draws.size() * sizeof(GPUMeshletDraw)));
+        VkDescriptorBufferInfo jobInfo = VkRenderer::info::descriptor_buffer_info(frame.jobBuffer._buffer, 0, static_cast<uint32_t>(jobs.size() * sizeof(uint32_t)));
+        VkDescriptorBufferInfo outputInfo = VkRenderer::info::descriptor_buffer_info(frame.outputBuffer._buffer, 0, outputIndices * static_cast<uint32_t>(sizeof(uint32_t)));
+        VkDescriptorBufferInfo commandInfo = VkRenderer::info::descriptor_buffer_info(frame.commandBuffer._buffer, 0,
+                                                                                      static_cast<uint32_t>(commands.size() * sizeof(GPUCullCommand)));
+        VkDescriptorBufferInfo visibilityInfo = VkRenderer::info::descriptor_buffer_info(_visibilityBuffer._buffer, 0,
+                                                                                         static_cast<uint32_t>(_visibilityCapacity * sizeof(uint32_t)));
+        VkDescriptorImageInfo pyramidInfo = pyramid.image_info();
+        VkRenderer::descriptor::Builder::begin(_resources->descriptorLayoutCache, descriptorAllocator)
+                .bind_buffer(0, &meshletInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(1, &sourceInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(2, &drawInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(3, &jobInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(4, &outputInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(5, &commandInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_buffer(6, &visibilityInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .bind_image(7, &pyramidInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+                .build(frame.cullSet);
+
+        frame.constant = {};
+        frame.constant.viewproj = viewproj;
+        frame.constant.pyramidSize = pyramid.size();
+        frame.constant.jobCount = jobCount;
+        frame.constant.coneCulling = _resources->settings.coneCulling;
+        frame.constant.phase = occlusion ? CULL_PHASE_EARLY : CULL_PHASE_SINGLE;
+        frame.constant.drawCount = static_cast<uint32_t>(drawCount);
+
+        // the previous frame's late phase wrote the visibility this phase reads
+        VkMemoryBarrier visibilityBarrier = {};
+        visibilityBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        visibilityBarrier.pNext = nullptr;
+        visibilityBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        visibilityBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &visibilityBarrier, 0, nullptr, 0, nullptr);
+
+        dispatch(cmd, frame);
+    }
+
+    void MeshletCuller::cull_late(VkCommandBuffer cmd, uint32_t frameIndex) {
+        FrameResources &frame = _frames[frameIndex];
+        if (!frame.occlusion || frame.records.empty()) return;
+
+        // reads the early phase's counts, the pyramid's levels were made visible as they were written
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        frame.constant.phase = CULL_PHASE_LATE;
+        dispatch(cmd, frame);
+    }
+
+    void MeshletCuller::dispatch(VkCommandBuffer cmd, FrameResources &frame) {
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pipelineLayout, 0, 1, &frame.cullSet, 0, nullptr);
+        vkCmdPushConstants(cmd, _pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstant), &frame.constant);
+        uint32_t groupsX = std::min(frame.constant.jobCount, MAX_DISPATCH_GROUPS);
+        vkCmdDispatch(cmd, groupsX, (frame.constant.jobCount + groupsX - 1) / groupsX, 1);
+
+        // indices and counts feed the draws, counts are also read back once the frame completes
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void MeshletCuller::draw(VkCommandBuffer cmd, uint32_t frameIndex, bool late) {
+        FrameResources &frame = _frames[frameIndex];
+        if (frame.records.empty() || (late && !frame.occlusion)) return;
+
+        vkCmdBindIndexBuffer(cmd, frame.outputBuffer._buffer, 0, VK_INDEX_TYPE_UINT32);
+        bool bindless = _resources->settings.bindlessTextures;
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        VkDescriptorSet boundTextures = VK_NULL_HANDLE;
+        for (size_t i = 0; i < frame.records.size(); i++) {
+            DrawRecord &record = frame.records[i];
+            const Material *material = bindless ? record.material->bindless : record.material;
+            if (material->pipeline != boundPipeline) {
+                boundPipeline = material->pipeline;
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipeline);
+            }
+            VkDescriptorSet textures = bindless ? _resources->textureTable->descriptor(frameIndex) : record.mesh->_texture->descriptor;
+            if (textures != boundTextures) {
+                boundTextures = textures;
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 1, 1, &boundTextures, 0, nullptr);
+            }
+            size_t command = late ? frame.records.size() + i : i;
+            record.mesh->draw_mesh_indirect(cmd, frame.commandBuffer._buffer, command * sizeof(GPUCullCommand));
+        }
+    }
+
+    MeshletStats MeshletCuller::stats() const {
+        return _stats;
+    }
+
+    void MeshletCuller::read_results(FrameResources &frame) {
+        _stats.visibleTriangles = 0;
+        _stats.occludedDraws = 0;
+        _stats.occludedMeshlets = 0;
+        _stats.occludedTriangles = 0;
+        if (frame.records.empty()) return;
+
+        void *data;
+        vmaInvalidateAllocation(_resources->allocator, frame.commandBuffer._allocation, 0, VK_WHOLE_SIZE);
+        vmaMapMemory(_resources->allocator, frame.commandBuffer._allocation, &data);
+        const auto *commands = static_cast<const GPUCullCommand *>(data);
+        size_t indices = 0;
+        size_t occludedIndices = 0;
+        size_t commandCount = frame.occlusion ? 2 * frame.records.size() : frame.records.size();
+        for (size_t i = 0; i < commandCount; i++) {
+            indices += commands[i].command.indexCount;
+            occludedIndices += commands[i].occludedIndices;
+            _stats.occludedMeshlets += commands[i].occludedMeshlets;
+            // a draw is hidden when every meshlet the frustum and cone left was occluded
+            if (commands[i].candidateMeshlets != 0 && commands[i].occludedMeshlets == commands[i].candidateMeshlets) {
+                _stats.occludedDraws++;
+            }
+        }
+        vmaUnmapMemory(_resources->allocator, frame.commandBuffer._allocation);
+        _stats.visibleTriangles = indices / 3;
+        _stats.occludedTriangles = occludedIndices / 3;
+    }
+
+    void MeshletCuller::reset_visibility(VkCommandBuffer cmd, uint32_t slots, DeletionQueue &frameDeletion) {
+        // the frame in flight may still use the old buffer
+        if (slots > _visibilityCapacity) {
+            AllocatedBuffer oldBuffer = _visibilityBuffer;
+            frameDeletion.push_function([=]() {
+                vmaDestroyBuffer(_resources->allocator, oldBuffer._buffer, oldBuffer._allocation);
+            });
+            _visibilityCapacity = std::max<VkDeviceSize>(slots, _visibilityCapacity * 2);
+            _visibilityBuffer = VkRenderer::utils::create_buffer(_resources->allocator, _visibilityCapacity * sizeof(uint32_t),
+                                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+        }
+
+        // nothing counts as visible, so the next frame draws everything in its late phase, after the previous frame's writes
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        vkCmdFillBuffer(cmd, _visibilityBuffer._buffer, 0, VK_WHOLE_SIZE, 0);
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void MeshletCuller::reserve(AllocatedBuffer &buffer, VkDeviceSize &capacity, VkDeviceSize count, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+                                VmaMemoryUsage memoryUsage) {
+        // capacity is in elements, every buffer has its own
+        if (count <= capacity && buffer._buffer != VK_NULL_HANDLE) return;
+        if (buffer._buffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(_resources->allocator, buffer._buffer, buffer._allocation);
+        }
+
+        // grow geometrically so a growing scene doesn't reallocate every frame
+        capacity = std::max(count, capacity * 2);
+        buffer = VkRenderer::utils::create_buffer(_resources->allocator, capacity * elementSize, usage, memoryUsage);
+    }
+
+    void MeshletCuller::cleanup() {
+        for (auto &frame: _frames) {
+            AllocatedBuffer *buffers[] = {&frame.drawBuffer, &frame.jobBuffer, &frame.commandBuffer, &frame.outputBuffer};
+            for (AllocatedBuffer *buffer: buffers) {
+                if (buffer->_buffer != VK_NULL_HANDLE) {
+                    vmaDestroyBuffer(_resources->allocator, buffer->_buffer, buffer->_allocation);
+                }
+            }
+        }
+        vmaDestroyBuffer(_resources->allocator, _visibilityBuffer._buffer, _visibilityBuffer._allocation);
+        vkDestroyPipeline(_resources->device, _pipeline, nullptr);
+        vkDestroyPipelineLayout(_resources->device, _pipelineLayout, nullptr);
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include <vk/types.h>
+#include <vk/model.h>
+
+namespace VkRenderer {
+    class DepthPyramid;
+}
+
+namespace VkRenderer {
+    struct MeshletStats {
+        size_t drawCount = 0;
+        size_t meshletCount = 0;
+        size_t submittedTriangles = 0;
+        // read back from the frame that last used the same buffers, so it lags by FRAME_OVERLAP frames
+        size_t visibleTriangles = 0;
+        // late occlusion phase, only counts what was neither drawn early nor culled by the frustum or cone, lags like visibleTriangles
+        size_t occludedDraws = 0;
+        size_t occludedMeshlets = 0;
+        size_t occludedTriangles = 0;
+    };
+
+    // culls meshlets against the frustum and by normal cone in a compute pass, surviving triangles are
+    // compacted into one index stream per frame and each mesh is drawn with an indirect draw,
+    // only meshes at full detail go through it
+    // with occlusion culling the frame is split in two phases: the early one draws the meshlets that were visible last frame,
+    // the late one tests the rest against a depth pyramid built from the early phase's depth and draws what it doesn't hide
+    class MeshletCuller {
+    public:
+        void init(ResourceHandles *resources);
+
+        // record the culling dispatch for every mesh with meshlets, the early phase's with occlusion, must be outside a render pass,
+        // the draws' data is added to the frame's DrawDataBuffer
+        // a grown visibility history buffer is retired through frameDeletion
+        void cull(VkCommandBuffer cmd, uint32_t frameIndex, VkRenderer::descriptor::Allocator *descriptorAllocator, std::unordered_map<std::string, Model> &models,
+                  const glm::mat4 &viewproj, const glm::vec3 &cameraPosition, const DepthPyramid &pyramid, bool occlusion, DeletionQueue &frameDeletion);
+
+        // record the late phase's dispatch after the pyramid was built, does nothing if cull was called without occlusion
+        void cull_late(VkCommandBuffer cmd, uint32_t frameIndex);
+
+        // draw what cull or cull_late recorded, the geometry vertex buffer must be bound
+        void draw(VkCommandBuffer cmd, uint32_t frameIndex, bool late);
+
+        [[nodiscard]] MeshletStats stats() const;
+
+    private:
+        // matches MeshletDraw in meshlet_cull.comp
+        struct GPUMeshletDraw {
+            glm::mat4 matrix;
+            glm::vec4 cameraPosition;
+            uint32_t firstMeshlet;
+            uint32_t firstIndex;
+            uint32_t indexType32;
+            uint32_t outputOffset;
+            uint32_t visibilityOffset; // first history slot of the draw, one per meshlet
+            uint32_t padding[3];
+        };
+
+        // matches DrawCommand in meshlet_cull.comp
+        struct GPUCullCommand {
+            VkDrawIndexedIndirectCommand command;
+            uint32_t candidateMeshlets;
+            uint32_t occludedMeshlets;
+            uint32_t occludedIndices;
+        };
+
+        enum CullPhase : uint32_t {
+            CULL_PHASE_SINGLE = 0,
+            CULL_PHASE_EARLY = 1,
+            CULL_PHASE_LATE = 2,
+        };
+
+        struct CullPushConstant {
+            glm::mat4 viewproj;
+            glm::vec2 pyramidSize;
+            uint32_t jobCount;
+            uint32_t coneCulling;
+            uint32_t phase;
+            uint32_t drawCount;
+        };
+
+        // a mesh's share of the visibility history, every node transform of it has a slot per meshlet
+        struct VisibilityKey {
+            uint64_t modelId;
+            uint32_t meshIndex;
+            uint32_t meshletCount;
+            uint32_t transformCount;
+
+            bool operator==(const VisibilityKey &other) const {
+                return modelId == other.modelId && meshIndex == other.meshIndex && meshletCount == other.meshletCount && transformCount == other.transformCount;
+            }
+        };
+
+        struct DrawRecord {
+            Mesh *mesh;
+            Material *material;
+        };
+
+        // capacities are in elements, buffers only grow
+        struct FrameResources {
+            AllocatedBuffer drawBuffer{};
+            AllocatedBuffer jobBuffer{};
+            AllocatedBuffer commandBuffer{};
+            AllocatedBuffer outputBuffer{};
+            VkDeviceSize drawCapacity = 0;
+            VkDeviceSize commandCapacity = 0;
+            VkDeviceSize jobCapacity = 0;
+            VkDeviceSize outputCapacity = 0;
+            std::vector<DrawRecord> records;
+            // the late phase reuses the early phase's set and constants
+            bool occlusion = false;
+            VkDescriptorSet cullSet = VK_NULL_HANDLE;
+            CullPushConstant constant{};
+        };
+
+        ResourceHandles *_resources;
+        VkDescriptorSetLayout _setLayout;
+        VkPipelineLayout _pipelineLayout;
+        VkPipeline _pipeline;
+        // one flag per meshlet of every draw, shared by the frames, slots are handed out in _visibilityLayout order
+        AllocatedBuffer _visibilityBuffer;
+        VkDeviceSize _visibilityCapacity;
+        std::vector<VisibilityKey> _visibilityLayout;
+        FrameResources _frames[FRAME_OVERLAP];
+        MeshletStats _stats;
+
+        // results of the last time this frame's buffers were used
+        void read_results(FrameResources &frame);
+
+        // bind the frame's set and constants and dispatch a job per meshlet
+        void dispatch(VkCommandBuffer cmd, FrameResources &frame);
+
+        // clear the history for a new layout of slots, growing the buffer if needed
+        void reset_visibility(VkCommandBuffer cmd, uint32_t slots, DeletionQueue &frameDeletion);
+
+        void reserve(AllocatedBuffer &buffer, VkDeviceSize &capacity, VkDeviceSize count, VkDeviceSize elementSize, VkBufferUsageFlags usage,
+                     VmaMemoryUsage memoryUsage);
+
+        void cleanup();
+    };
+}
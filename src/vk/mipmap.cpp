@@ -0,0 +1,90 @@
+#include <cmath>
+#include <algorithm>
+
+#include "mipmap.h"
+
+namespace VkRenderer::mipmap {
+    // lookup tables for sRGB <-> linear, built on first use
+    struct SrgbTables {
+        float toLinear[256];
+        uint8_t toSrgb[4096];
+
+        SrgbTables() {
+            for (int i = 0; i < 256; i++) {
+                float c = static_cast<float>(i) / 255.0f;
+                toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            for (int i = 0; i < 4096; i++) {
+                float l = static_cast<float>(i) / 4095.0f;
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                toSrgb[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+            }
+        }
+    };
+
+    static const SrgbTables &srgb_tables() {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    static void downsample(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, bool srgb) {
+        const SrgbTables &tables = srgb_tables();
+        const uint32_t colorChannels = srgb ? 3 : 0;
+        for (uint32_t y = 0; y < dstHeight; y++) {
+            // odd dimensions clamp to the last row/column
+            const uint8_t *row0 = src + static_cast<size_t>(std::min(y * 2, srcHeight - 1)) * srcWidth * 4;
+            const uint8_t *row1 = src + static_cast<size_t>(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+            uint8_t *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                uint32_t x0 = std::min(x * 2, srcWidth - 1) * 4;
+                uint32_t x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+                for (uint32_t c = 0; c < colorChannels; c++) {
+                    float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] +
+                                tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+                    out[x * 4 + c] = tables.toSrgb[static_cast<uint32_t>(sum * 0.25f * 4095.0f + 0.5f)];
+                }
+                for (uint32_t c = colorChannels; c < 4; c++) {
+                    out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+        }
+    }
+
+    uint32_t level_count(uint32_t width, uint32_t height) {
+        uint32_t levels = 1;
+        uint32_t size = std::max(width, height);
+        while (size > 1) {
+            size /= 2;
+            levels++;
+        }
+        return levels;
+    }
+
+    void generate_chain(const uint8_t *pixels, uint32_t width, uint32_t height, std::vector<uint8_t> &chain, bool srgb) {
+        // size the whole chain up front so level pointers stay valid
+        size_t chainSize = 0;
+        for (uint32_t w = width, h = height; w > 1 || h > 1;) {
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+            chainSize += static_cast<size_t>(w) * h * 4;
+        }
+        chain.resize(chainSize);
+
+        // each level is filtered from the one above it
+        const uint8_t *src = pixels;
+        uint8_t *dst = chain.data();
+        uint32_t srcWidth = width;
+        uint32_t srcHeight = height;
+        while (srcWidth > 1 || srcHeight > 1) {
+            uint32_t dstWidth = std::max(srcWidth / 2, 1u);
+            uint32_t dstHeight = std::max(srcHeight / 2, 1u);
+            downsample(src, srcWidth, srcHeight, dst, dstWidth, dstHeight, srgb);
+
+            src = dst;
+            dst += static_cast<size_t>(dstWidth) * dstHeight * 4;
+            srcWidth = dstWidth;
+            srcHeight = dstHeight;
+        }
+    }
+}
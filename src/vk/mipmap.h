@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace VkRenderer::mipmap {
+    uint32_t level_count(uint32_t width, uint32_t height);
+
+    // box filters an RGBA8 image down to 1x1, levels 1..n are stored back to back in chain
+    // sRGB color is averaged in linear space, alpha and non-color data as stored
+    void generate_chain(const uint8_t *pixels, uint32_t width, uint32_t height, std::vector<uint8_t> &chain, bool srgb = true);
+}
@@ -1,134 +1,579 @@
-#include <iostream>
-#include <assimp/Importer.hpp>
-#include <assimp/postprocess.h>
-#include <vk/check.h>
-#include <vk/utils.h>
-#include <vk/info.h>
-
-#define STB_IMAGE_IMPLEMENTATION
-
-#include <stb_image.h>
-
-#include "model.h"
-
-namespace VkRenderer {
-    void Model::set_model(const std::string &filePath, ResourceHandles *resources) {
-        _textureManager = new TextureManager;
-        _textureManager->init(resources);
-
-        Assimp::Importer importer;
-        const aiScene *modelScene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_FlipUVs);
-
-        if (!modelScene || modelScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !modelScene->mRootNode) {
-            std::cout << "Assimp error: " << importer.GetErrorString() << std::endl;
-            return;
-        }
-
-        _directory = filePath.substr(0, filePath.find_last_of('/'));
-        process_node(modelScene->mRootNode, modelScene);
-    }
-
-    void Model::update_transform() {
-        glm::mat4 newTransform = glm::mat4{1.0f};
-
-        // translate
-        newTransform = glm::translate(newTransform, glm::vec3(translation[0], translation[1], translation[2]));
-
-        // rotate by each XYZ value
-        newTransform = glm::rotate(newTransform, glm::radians(rotation[0]), glm::vec3(1.0f, 0.0f, 0.0f));
-        newTransform = glm::rotate(newTransform, glm::radians(rotation[1]), glm::vec3(0.0f, 1.0f, 0.0f));
-        newTransform = glm::rotate(newTransform, glm::radians(rotation[2]), glm::vec3(0.0f, 0.0f, 1.0f));
-
-        // scale
-        newTransform = glm::scale(newTransform, glm::vec3(scale[0], scale[1], scale[2]));
-
-        _modelMatrix = newTransform;
-    }
-
-    void Model::draw_model(VkCommandBuffer cmd) {
-        for (auto &mesh: meshes) {
-            mesh.draw_mesh(cmd, _modelMatrix);
-        }
-    }
-
-    void Model::process_node(aiNode *node, const aiScene *scene) {
-        for (size_t i = 0; i < node->mNumMeshes; i++) {
-            aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(process_mesh(mesh, scene));
-        }
-        for (size_t i = 0; i < node->mNumChildren; i++) {
-            process_node(node->mChildren[i], scene);
-        }
-    }
-
-    Mesh Model::process_mesh(aiMesh *mesh, const aiScene *scene) {
-        Mesh newMesh;
-        newMesh._material = defaultMaterial;
-        for (size_t i = 0; i < mesh->mNumVertices; i++) {
-            Vertex newVertex;
-            newVertex.position.x = mesh->mVertices[i].x;
-            newVertex.position.y = mesh->mVertices[i].y;
-            newVertex.position.z = mesh->mVertices[i].z;
-            if (mesh->HasNormals()) {
-                newVertex.normal.x = mesh->mNormals[i].x;
-                newVertex.normal.y = mesh->mNormals[i].y;
-                newVertex.normal.z = mesh->mNormals[i].z;
-                newVertex.color.x = mesh->mNormals[i].x;
-                newVertex.color.y = mesh->mNormals[i].y;
-                newVertex.color.z = mesh->mNormals[i].z;
-            } else {
-                newVertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
-            }
-            if (mesh->mTextureCoords[0]) {
-                newVertex.uv.x = mesh->mTextureCoords[0][i].x;
-                newVertex.uv.y = mesh->mTextureCoords[0][i].y;
-            }
-            newMesh._vertices.push_back(newVertex);
-        }
-        for (size_t i = 0; i < mesh->mNumFaces; i++) {
-            aiFace face = mesh->mFaces[i];
-            for (size_t j = 0; j < face.mNumIndices; j++) {
-                newMesh._indices.push_back(face.mIndices[j]);
-            }
-        }
-
-        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
-        for (size_t i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); i++) {
-            aiString str;
-            material->GetTexture(aiTextureType_DIFFUSE, i, &str);
-            std::string fullPath = _directory + '/' + str.C_Str();
-
-            // check if the texture already exists
-            Texture *existingTexture = _textureManager->get_texture(fullPath);
-            if (existingTexture) {
-                // use existing texture
-                newMesh._texture = existingTexture;
-            } else {
-                // create new texture
-                newMesh._texture = _textureManager->create_texture(fullPath, "texture_diffuse");
-            }
-        }
-
-        return newMesh;
-    }
-
-    void Model::upload_meshes(ResourceHandles *resources) {
-        for (auto &mesh: meshes) {
-            mesh.upload_mesh(resources);
-        }
-    }
-
-    void ModelManager::init(ResourceHandles *resources) {
-        _resources = resources;
-    }
-
-    Model *ModelManager::create_model(const std::string &filePath, const std::string &name, Material *defaultMaterial) {
-        Model newModel;
-        newModel.defaultMaterial = defaultMaterial;
-        newModel.set_model(filePath, _resources);
-        newModel.upload_meshes(_resources);
-        models[name] = newModel;
-
-        return &models[name];
-    }
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <assimp/Importer.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <vk/check.h>
+#include <vk/utils.h>
+#include <vk/info.h>
+#include <vk/mesh_cache.h>
+#include <vk/mesh_optimize.h>
+#include <vk/meshlet.h>
+#include <vk/mesh_lod.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stb_image.h>
+
+#include "model.h"
+
+namespace VkRenderer {
+    void Model::set_model(const std::string &filePath, ResourceHandles *resources, UploadBatcher *uploader) {
+        _textureManager = resources->textureManager;
+        _uploader = uploader;
+        _directory = filePath.substr(0, filePath.find_last_of('/'));
+
+        // skip the importer entirely if processed geometry is cached
+        if (load_from_cache(filePath)) {
+            _textureManager->flush_uploads(uploader);
+            return;
+        }
+
+        Assimp::Importer importer;
+        const aiScene *modelScene = importer.ReadFile(filePath, MODEL_IMPORT_FLAGS);
+
+        if (!modelScene || modelScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !modelScene->mRootNode) {
+            std::cout << "Assimp error: " << importer.GetErrorString() << std::endl;
+            return;
+        }
+
+        // the mesh walk only queues texture decodes, upload them once it's done
+        std::vector<std::vector<glm::mat4>> meshTransforms(modelScene->mNumMeshes);
+        process_node(modelScene->mRootNode, glm::mat4(1.0f), meshTransforms);
+        build_meshes(modelScene, meshTransforms);
+        _textureManager->flush_uploads(uploader);
+
+        // store processed geometry for the next launch
+        VkRenderer::cache::MeshCache::write(filePath, MODEL_IMPORT_FLAGS, importOptions, meshes);
+    }
+
+    void Model::update_transform() {
+        glm::mat4 newTransform = glm::mat4{1.0f};
+
+        // translate
+        newTransform = glm::translate(newTransform, glm::vec3(translation[0], translation[1], translation[2]));
+
+        // rotate by each XYZ value
+        newTransform = glm::rotate(newTransform, glm::radians(rotation[0]), glm::vec3(1.0f, 0.0f, 0.0f));
+        newTransform = glm::rotate(newTransform, glm::radians(rotation[1]), glm::vec3(0.0f, 1.0f, 0.0f));
+        newTransform = glm::rotate(newTransform, glm::radians(rotation[2]), glm::vec3(0.0f, 0.0f, 1.0f));
+
+        // scale
+        newTransform = glm::scale(newTransform, glm::vec3(scale[0], scale[1], scale[2]));
+
+        if (newTransform != _modelMatrix) {
+            _modelMatrix = newTransform;
+            _instanceVersion++;
+        }
+    }
+
+    void Model::set_instances(const std::vector<glm::mat4> &transforms) {
+        _instances = transforms;
+        _instanceVersion++;
+    }
+
+    void Model::update_instances(InstanceBuffer *instanceBuffer, uint32_t frameIndex) {
+        // ranges are allocated on first use, so copies made while loading never own one
+        if (_instanceRange.size != instance_count()) {
+            // only retried once the count changes
+            if (_failedInstanceCount == instance_count()) return;
+            instanceBuffer->free(_instanceRange);
+            _instanceRange = {};
+            if (!instanceBuffer->allocate(static_cast<uint32_t>(instance_count()), _instanceRange)) {
+                _failedInstanceCount = instance_count();
+                return;
+            }
+            _failedInstanceCount = 0;
+            _instanceVersion++;
+        }
+        if (_writtenVersion[frameIndex] == _instanceVersion) return;
+
+        if (_matrixVersion != _instanceVersion) {
+            _instanceMatrices.resize(instance_count());
+            if (_instances.empty()) {
+                _instanceMatrices[0] = _modelMatrix;
+            }
+            for (size_t i = 0; i < _instances.size(); i++) {
+                _instanceMatrices[i] = _modelMatrix * _instances[i];
+            }
+            _matrixVersion = _instanceVersion;
+        }
+        instanceBuffer->write(frameIndex, _instanceRange, _instanceMatrices.data());
+        _writtenVersion[frameIndex] = _instanceVersion;
+    }
+
+    float Model::bounding_radius() const {
+        float radius = 0.0f;
+        for (auto &mesh: meshes) {
+            for (auto &transform: mesh._transforms) {
+                float maxScale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))});
+                glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(mesh._bounds), 1.0f));
+                radius = std::max(radius, glm::length(center) + mesh._bounds.w * maxScale);
+            }
+        }
+        return radius;
+    }
+
+    const std::vector<DrawBounds> &Model::draw_bounds() {
+        if (_boundsVersion == _matrixVersion) return _drawBounds;
+
+        _drawBounds.clear();
+        for (auto &mesh: meshes) {
+            glm::vec3 localCenter = (mesh._boundsMin + mesh._boundsMax) * 0.5f;
+            glm::vec3 localExtent = (mesh._boundsMax - mesh._boundsMin) * 0.5f;
+            for (auto &transform: mesh._transforms) {
+                // box of each instance's transformed box, with a single instance the transformed sphere is usually tighter
+                glm::vec3 boundsMin(std::numeric_limits<float>::max());
+                glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+                float radius = 0.0f;
+                for (auto &instance: _instanceMatrices) {
+                    glm::mat4 matrix = instance * transform;
+                    glm::vec3 center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+                    glm::vec3 extent = glm::abs(glm::vec3(matrix[0])) * localExtent.x + glm::abs(glm::vec3(matrix[1])) * localExtent.y +
+                                       glm::abs(glm::vec3(matrix[2])) * localExtent.z;
+                    boundsMin = glm::min(boundsMin, center - extent);
+                    boundsMax = glm::max(boundsMax, center + extent);
+                    float maxScale = std::max({glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))});
+                    radius = mesh._bounds.w * maxScale;
+                }
+
+                DrawBounds bounds{};
+                bounds.center = (boundsMin + boundsMax) * 0.5f;
+                bounds.extent = (boundsMax - boundsMin) * 0.5f;
+                bounds.radius = _instanceMatrices.size() == 1 ? radius : glm::length(bounds.extent);
+                _drawBounds.push_back(bounds);
+            }
+        }
+        _boundsVersion = _matrixVersion;
+        return _drawBounds;
+    }
+
+    void Model::draw_model(DrawList &drawList, DrawDataBuffer *drawData, const glm::vec3 &cameraPosition, const RenderSettings &settings,
+                           VkDescriptorSet textureTable) {
+        if (!instances_allocated()) return;
+
+        const std::vector<DrawBounds> &bounds = draw_bounds();
+        size_t boundsOffset = 0;
+        for (auto &mesh: meshes) {
+            // meshes with meshlets are drawn by the culling pass instead
+            bool meshletDrawn = settings.meshletCulling && mesh._meshletRange.size > 0 && mesh._lod == 0 && instance_count() == 1;
+            if (!meshletDrawn) {
+                mesh.add_draws(drawList, drawData, first_instance(), static_cast<uint32_t>(instance_count()), &bounds[boundsOffset], cameraPosition,
+                               textureTable);
+            }
+            boundsOffset += mesh._transforms.size();
+        }
+    }
+
+    void Model::request_textures(TextureStreamer *streamer, const glm::vec3 &cameraPosition, const glm::mat4 &projection, VkExtent2D extent) {
+        for (auto &mesh: meshes) {
+            // projected diameter of the bounding sphere in pixels
+            float pixels = pixels_per_unit(mesh, cameraPosition, projection, extent);
+            float screenSize = pixels == std::numeric_limits<float>::max() ? pixels : 2.0f * mesh._bounds.w * pixels;
+            streamer->request(mesh._texture, screenSize);
+        }
+    }
+
+    void Model::select_lods(const glm::vec3 &cameraPosition, const glm::mat4 &projection, VkExtent2D extent, float errorPixels, LodStats &stats) {
+        for (auto &mesh: meshes) {
+            // errors only grow with the level, so take the last one that stays under the threshold
+            float pixels = pixels_per_unit(mesh, cameraPosition, projection, extent);
+            mesh._lod = 0;
+            while (mesh._lod + 1 < mesh._lods.size() && mesh._lods[mesh._lod + 1].error * pixels <= errorPixels) {
+                mesh._lod++;
+            }
+
+            stats.meshCount++;
+            stats.reducedMeshCount += mesh._lod != 0;
+            stats.baseTriangles += mesh._lods[0].indexCount / 3;
+            stats.selectedTriangles += mesh._lods[mesh._lod].indexCount / 3;
+        }
+    }
+
+    float Model::pixels_per_unit(const Mesh &mesh, const glm::vec3 &cameraPosition, const glm::mat4 &projection, VkExtent2D extent) const {
+        // measured at the nearest point of the bounding sphere, instanced meshes take their closest instance
+        float pixels = 0.0f;
+        for (auto &instance: _instanceMatrices) {
+            for (auto &transform: mesh._transforms) {
+                glm::mat4 matrix = instance * transform;
+                float maxScale = std::max({glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))});
+                glm::vec3 center = glm::vec3(matrix * glm::vec4(glm::vec3(mesh._bounds), 1.0f));
+                float radius = mesh._bounds.w * maxScale;
+                float distance = glm::length(center - cameraPosition);
+                if (distance <= radius) {
+                    return std::numeric_limits<float>::max();
+                }
+                pixels = std::max(pixels, maxScale * projection[1][1] * 0.5f * static_cast<float>(extent.height) / distance);
+            }
+        }
+        return pixels;
+    }
+
+    void Model::register_textures(TextureStreamer *streamer) {
+        for (auto &mesh: meshes) {
+            // the default texture's handles are shared by failed loads, so it stays as is
+            if (mesh._texture != _textureManager->get_default_texture() && mesh._texture->source) {
+                streamer->register_texture(mesh._texture);
+            }
+        }
+    }
+
+    void Model::destroy(ResourceHandles *resources) {
+        resources->instanceBuffer->free(_instanceRange);
+        _instanceRange = {};
+        for (auto &mesh: meshes) {
+            mesh.destroy(resources);
+            _textureManager->release(mesh._texture);
+        }
+        meshes.clear();
+    }
+
+    void Model::process_node(aiNode *node, const glm::mat4 &parentTransform, std::vector<std::vector<glm::mat4>> &meshTransforms) {
+        // assimp matrices are row major
+        glm::mat4 transform = parentTransform * glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+        for (size_t i = 0; i < node->mNumMeshes; i++) {
+            meshTransforms[node->mMeshes[i]].push_back(transform);
+        }
+        for (size_t i = 0; i < node->mNumChildren; i++) {
+            process_node(node->mChildren[i], transform, meshTransforms);
+        }
+    }
+
+    void Model::build_meshes(const aiScene *scene, const std::vector<std::vector<glm::mat4>> &meshTransforms) {
+        const bool batching = importOptions & MODEL_OPTION_STATIC_BATCHING;
+
+        // batches are keyed by texture, every mesh of a model shares its material, ordered so the cache is deterministic
+        std::map<std::string, Mesh> batches;
+        size_t batchedCount = 0;
+        size_t instancedCount = 0;
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+            if (meshTransforms[i].empty()) continue;
+
+            aiMesh *sourceMesh = scene->mMeshes[i];
+            if (batching && meshTransforms[i].size() == 1) {
+                Mesh mesh = process_mesh(sourceMesh, scene, meshTransforms[i][0]);
+                Mesh &batch = batches[mesh._texturePath];
+                auto baseVertex = static_cast<uint32_t>(batch._vertices.size());
+                batch._vertices.insert(batch._vertices.end(), mesh._vertices.begin(), mesh._vertices.end());
+                for (uint32_t index: mesh._indices) {
+                    batch._indices.push_back(baseVertex + index);
+                }
+                batchedCount++;
+                continue;
+            }
+
+            // drawn once per node that references it, geometry stays in mesh space
+            Mesh mesh = process_mesh(sourceMesh, scene, glm::mat4(1.0f));
+            mesh._transforms = meshTransforms[i];
+            instancedCount += meshTransforms[i].size() > 1;
+            finish_mesh(mesh, sourceMesh->mName.C_Str());
+            meshes.push_back(std::move(mesh));
+        }
+
+        for (auto &it: batches) {
+            it.second._texturePath = it.first;
+            finish_mesh(it.second, "batch " + (it.first.empty() ? std::string("untextured") : it.first.substr(it.first.find_last_of('/') + 1)));
+            meshes.push_back(std::move(it.second));
+        }
+        if (batching) {
+            std::cout << "Batched " << batchedCount << " static meshes into " << batches.size() << " meshes, " << instancedCount << " instanced meshes kept"
+                      << std::endl;
+        }
+    }
+
+    Mesh Model::process_mesh(aiMesh *mesh, const aiScene *scene, const glm::mat4 &transform) {
+        Mesh newMesh;
+        glm::mat3 normalTransform = glm::transpose(glm::inverse(glm::mat3(transform)));
+        for (size_t i = 0; i < mesh->mNumVertices; i++) {
+            // zeroed so missing attributes don't stop identical vertices from welding
+            Vertex newVertex{};
+            newVertex.position = glm::vec3(transform * glm::vec4(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z, 1.0f));
+            if (mesh->HasNormals()) {
+                newVertex.normal = glm::normalize(normalTransform * glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z));
+                newVertex.color = newVertex.normal;
+            } else {
+                newVertex.color = glm::vec3(1.0f, 1.0f, 1.0f);
+            }
+            if (mesh->mTextureCoords[0]) {
+                newVertex.uv.x = mesh->mTextureCoords[0][i].x;
+                newVertex.uv.y = mesh->mTextureCoords[0][i].y;
+            }
+            newMesh._vertices.push_back(newVertex);
+        }
+
+        // mirroring transforms flip the winding
+        const bool flipWinding = glm::determinant(glm::mat3(transform)) < 0.0f;
+        for (size_t i = 0; i < mesh->mNumFaces; i++) {
+            aiFace face = mesh->mFaces[i];
+            for (size_t j = 0; j < face.mNumIndices; j++) {
+                newMesh._indices.push_back(face.mIndices[flipWinding ? face.mNumIndices - 1 - j : j]);
+            }
+        }
+
+        aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
+        for (size_t i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); i++) {
+            aiString str;
+            material->GetTexture(aiTextureType_DIFFUSE, i, &str);
+            newMesh._texturePath = _directory + '/' + str.C_Str();
+        }
+
+        return newMesh;
+    }
+
+    void Model::finish_mesh(Mesh &newMesh, const std::string &name) {
+        newMesh._material = defaultMaterial;
+
+        // weld and reorder for the vertex cache, overdraw and fetch, the mesh cache stores the result
+        std::vector<uint32_t> indices = std::move(newMesh._indices);
+        VkRenderer::optimize::MeshReport report = VkRenderer::optimize::optimize_mesh(newMesh._vertices, indices);
+        newMesh._meshlets = VkRenderer::meshlet::build_meshlets(newMesh._vertices, indices);
+        newMesh._lods = VkRenderer::lod::build_lods(newMesh._vertices, indices);
+        newMesh._indices = std::move(indices);
+        newMesh.select_index_type();
+        std::cout << "Optimized mesh " << name << ": " << report.vertexCountBefore << " -> " << report.vertexCountAfter << " vertices, ACMR "
+                  << report.acmrBefore << " -> " << report.acmrAfter << ", overdraw " << report.overdrawBefore << " -> " << report.overdrawAfter
+                  << ", " << newMesh._meshlets.size() << " meshlets, " << newMesh._lods.size() << " LODs down to " << newMesh._lods.back().indexCount / 3
+                  << " triangles" << (newMesh._indexType == VK_INDEX_TYPE_UINT32 ? ", 32-bit indices" : "") << std::endl;
+
+        newMesh._texture = load_texture(newMesh._texturePath);
+    }
+
+    bool Model::load_from_cache(const std::string &filePath) {
+        VkRenderer::cache::MeshCache meshCache;
+        if (!meshCache.open(filePath, MODEL_IMPORT_FLAGS, importOptions)) {
+            return false;
+        }
+
+        meshes.resize(meshCache.mesh_count());
+        for (uint32_t i = 0; i < meshCache.mesh_count(); i++) {
+            const VkRenderer::cache::MeshEntry &entry = meshCache.mesh_entry(i);
+            Mesh &mesh = meshes[i];
+            mesh._material = defaultMaterial;
+
+            // bulk copy out of the mapping, no per-vertex work
+            mesh._vertices.assign(meshCache.vertices(i), meshCache.vertices(i) + entry.vertexCount);
+            if (entry.indexSize == sizeof(uint16_t)) {
+                const auto *indices = reinterpret_cast<const uint16_t *>(meshCache.index_data(i));
+                mesh._indices.assign(indices, indices + entry.indexCount);
+                mesh._indexType = VK_INDEX_TYPE_UINT16;
+            } else {
+                const auto *indices = reinterpret_cast<const uint32_t *>(meshCache.index_data(i));
+                mesh._indices.assign(indices, indices + entry.indexCount);
+                mesh._indexType = VK_INDEX_TYPE_UINT32;
+            }
+            mesh._meshlets.assign(meshCache.meshlets(i), meshCache.meshlets(i) + entry.meshletCount);
+            mesh._lods.assign(entry.lods, entry.lods + entry.lodCount);
+            mesh._transforms.assign(meshCache.transforms(i), meshCache.transforms(i) + entry.transformCount);
+            mesh._texturePath = meshCache.texture_path(i);
+            mesh._texture = load_texture(mesh._texturePath);
+        }
+
+        return true;
+    }
+
+    Texture *Model::load_texture(const std::string &filePath) {
+        if (filePath.empty()) {
+            return _textureManager->get_default_texture();
+        }
+
+        // every mesh holds its own reference, textures shared with other models are not loaded again
+        return _textureManager->create_texture(filePath, "texture_diffuse", _uploader);
+    }
+
+    void Model::upload_meshes(ResourceHandles *resources, UploadBatcher *uploader) {
+        if (defaultMaterial->vertexFormat == VertexFormat::Compact) {
+            // one quantization box for the whole model, so vertices on seams between meshes land on the same grid
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+            for (auto &mesh: meshes) {
+                for (auto &vertex: mesh._vertices) {
+                    boundsMin = glm::min(boundsMin, vertex.position);
+                    boundsMax = glm::max(boundsMax, vertex.position);
+                }
+            }
+            for (auto &mesh: meshes) {
+                mesh.set_quantization(boundsMin, boundsMax);
+            }
+        }
+
+        for (auto &mesh: meshes) {
+            mesh.upload_mesh(resources, uploader);
+        }
+    }
+
+    void ModelManager::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        // background loads record their uploads on the transfer queue
+        _transferUploader.init(_resources, _resources->transferQueue, _resources->transferQueueFamily);
+        _loaderThread = std::thread(&ModelManager::loader_loop, this);
+    }
+
+    Model *ModelManager::create_model(const std::string &filePath, const std::string &name, Material *defaultMaterial, uint32_t importOptions) {
+        Model newModel;
+        newModel.defaultMaterial = defaultMaterial;
+        newModel.importOptions = importOptions;
+        newModel.set_model(filePath, _resources, _resources->uploader);
+        newModel.upload_meshes(_resources, _resources->uploader);
+
+        // one submission for every texture and mesh in the model
+        _resources->uploader->flush();
+        models[name] = newModel;
+        models[name].id = _nextModelId++;
+        models[name].register_textures(_resources->textureStreamer);
+
+        return &models[name];
+    }
+
+    std::string ModelManager::create_model_async(const std::string &filePath, const std::string &name, Material *defaultMaterial, uint32_t importOptions,
+                                                 std::function<void(Model &model)> onLoaded) {
+        PendingModel pending;
+        pending.filePath = filePath;
+        pending.defaultMaterial = defaultMaterial;
+        pending.importOptions = importOptions;
+        pending.onLoaded = std::move(onLoaded);
+
+        std::string reservedName;
+        {
+            std::lock_guard<std::mutex> lock(_loaderMutex);
+            reservedName = unique_name(name);
+            pending.name = reservedName;
+            _pendingNames.insert(reservedName);
+            _queuedModels.push_back(std::move(pending));
+            _pendingCount++;
+        }
+        _loaderCondition.notify_one();
+        return reservedName;
+    }
+
+    void ModelManager::update(VkCommandBuffer cmd) {
+        // take loads whose uploads have landed, without blocking on the loader or the GPU
+        std::list<PendingModel> loaded;
+        {
+            std::lock_guard<std::mutex> lock(_loaderMutex);
+            for (auto it = _loadedModels.begin(); it != _loadedModels.end();) {
+                auto next = std::next(it);
+                if (_transferUploader.is_complete(it->uploadTicket)) {
+                    loaded.splice(loaded.end(), _loadedModels, it);
+                }
+                it = next;
+            }
+            _pendingCount -= loaded.size();
+            for (auto &pending: loaded) {
+                // create_model may have taken the name since the load was queued, existing models are never overwritten
+                if (models.count(pending.name)) {
+                    std::string name = unique_name(pending.name);
+                    std::cout << "Model " << pending.name << " already exists, adding the loaded model as " << name << std::endl;
+                    _pendingNames.erase(pending.name);
+                    _pendingNames.insert(name);
+                    pending.name = name;
+                }
+            }
+            // names stay reserved until every rename above is picked
+            for (auto &pending: loaded) {
+                _pendingNames.erase(pending.name);
+            }
+        }
+
+        // before any model using them is published, every completed batch's textures are acquired
+        _resources->textureManager->acquire(cmd, &_transferUploader);
+
+        for (auto &pending: loaded) {
+            // the transfer batch has completed, so only the ownership acquire is left
+            if (!pending.bufferAcquires.empty() || !pending.imageAcquires.empty()) {
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                     VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                                     0, nullptr,
+                                     static_cast<uint32_t>(pending.bufferAcquires.size()), pending.bufferAcquires.data(),
+                                     static_cast<uint32_t>(pending.imageAcquires.size()), pending.imageAcquires.data());
+            }
+
+            models[pending.name] = pending.model;
+            models[pending.name].id = _nextModelId++;
+            models[pending.name].register_textures(_resources->textureStreamer);
+            if (pending.onLoaded) {
+                pending.onLoaded(models[pending.name]);
+            }
+            std::cout << "Finished loading model " << pending.name << std::endl;
+        }
+    }
+
+    void ModelManager::remove_model(const std::string &name, DeletionQueue &frameDeletion) {
+        auto it = models.find(name);
+        if (it == models.end()) return;
+
+        Model model = it->second;
+        models.erase(it);
+        ResourceHandles *resources = _resources;
+        frameDeletion.push_function([=]() mutable {
+            model.destroy(resources);
+        });
+    }
+
+    std::string ModelManager::unique_name(const std::string &name) {
+        std::string uniqueName = name;
+        for (int i = 1; models.count(uniqueName) || _pendingNames.count(uniqueName); i++) {
+            uniqueName = name + " (" + std::to_string(i) + ")";
+        }
+        return uniqueName;
+    }
+
+    size_t ModelManager::pending_count() {
+        std::lock_guard<std::mutex> lock(_loaderMutex);
+        return _pendingCount;
+    }
+
+    void ModelManager::cleanup() {
+        {
+            std::lock_guard<std::mutex> lock(_loaderMutex);
+            _stopping = true;
+            _queuedModels.clear();
+            _pendingNames.clear();
+        }
+        _loaderCondition.notify_all();
+        if (_loaderThread.joinable()) {
+            _loaderThread.join();
+        }
+
+        // the last load may have been submitted after the device went idle
+        for (auto &pending: _loadedModels) {
+            _transferUploader.wait(pending.uploadTicket);
+            pending.model.destroy(_resources);
+        }
+        _loadedModels.clear();
+        for (auto &it: models) {
+            it.second.destroy(_resources);
+        }
+        models.clear();
+    }
+
+    void ModelManager::loader_loop() {
+        while (true) {
+            std::list<PendingModel> current;
+            {
+                std::unique_lock<std::mutex> lock(_loaderMutex);
+                _loaderCondition.wait(lock, [this]() { return _stopping || !_queuedModels.empty(); });
+                if (_stopping) return;
+                current.splice(current.end(), _queuedModels, _queuedModels.begin());
+            }
+
+            // import, decode and record uploads entirely on this thread
+            PendingModel &pending = current.front();
+            pending.model.defaultMaterial = pending.defaultMaterial;
+            pending.model.importOptions = pending.importOptions;
+            pending.model.set_model(pending.filePath, _resources, &_transferUploader);
+            pending.model.upload_meshes(_resources, &_transferUploader);
+
+            // submit without waiting, update() polls the ticket and records the acquire barriers
+            pending.uploadTicket = _transferUploader.submit();
+            _transferUploader.take_acquires(pending.bufferAcquires, pending.imageAcquires);
+            // textures can be shared with other models, so the cache acquires them exactly once
+            _resources->textureManager->submitted(&_transferUploader, pending.uploadTicket, pending.imageAcquires);
+
+            std::lock_guard<std::mutex> lock(_loaderMutex);
+            _loadedModels.splice(_loadedModels.end(), current);
+        }
+    }
 }
\ No newline at end of file
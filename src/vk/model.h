@@ -1,54 +1,187 @@
-#pragma once
-
-#include <vk/types.h>
-#include <vector>
-#include <unordered_map>
-#include <string>
-#include <glm/glm.hpp>
-#include <assimp/scene.h>
-#include <vulkan/vulkan.h>
-#include <vk/mesh.h>
-#include <vk/material.h>
-#include <vk/texture.h>
-
-namespace VkRenderer {
-    class Model {
-    public:
-        void set_model(const std::string &filePath, ResourceHandles *resources);
-
-        void update_transform();
-
-        void upload_meshes(ResourceHandles *resources);
-
-        void draw_model(VkCommandBuffer cmd);
-
-        std::vector<Mesh> meshes;
-        Material *defaultMaterial;
-
-        // using public float arrays so imgui can update them
-        float translation[3] = {0.0f, 0.0f, 0.0f};
-        float rotation[3] = {0.0f, 0.0f, 0.0f};
-        float scale[3] = {1.0f, 1.0f, 1.0f};
-
-    private:
-        glm::mat4 _modelMatrix = glm::mat4{1.0f};
-        TextureManager *_textureManager;
-        std::string _directory;
-
-        void process_node(aiNode *node, const aiScene *scene);
-
-        Mesh process_mesh(aiMesh *mesh, const aiScene *scene);
-    };
-
-    class ModelManager {
-    public:
-        std::unordered_map<std::string, Model> models;
-
-        void init(ResourceHandles *resources);
-
-        Model *create_model(const std::string &filePath, const std::string &name, Material *defaultMaterial);
-
-    private:
-        ResourceHandles *_resources;
-    };
+#pragma once
+
+#include <vk/types.h>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <string>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <glm/glm.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <vulkan/vulkan.h>
+#include <vk/mesh.h>
+#include <vk/material.h>
+#include <vk/texture.h>
+#include <vk/upload.h>
+#include <vk/streaming.h>
+#include <vk/instance_buffer.h>
+
+namespace VkRenderer {
+    // import flags are part of the mesh cache key, changing them invalidates cached geometry
+    constexpr unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
+    // bake node transforms into meshes used by a single node and merge them into one mesh per texture
+    constexpr uint32_t MODEL_OPTION_STATIC_BATCHING = 1 << 0;
+
+    class Model {
+    public:
+        void set_model(const std::string &filePath, ResourceHandles *resources, UploadBatcher *uploader);
+
+        void update_transform();
+
+        [[nodiscard]] const glm::mat4 &model_matrix() const { return _modelMatrix; }
+
+        // draw the model once per transform, relative to the model transform, empty draws it once
+        void set_instances(const std::vector<glm::mat4> &transforms);
+
+        [[nodiscard]] size_t instance_count() const { return std::max<size_t>(_instances.size(), 1); }
+
+        [[nodiscard]] uint32_t first_instance() const { return static_cast<uint32_t>(_instanceRange.offset); }
+
+        // false until update_instances has found room in the instance buffer
+        [[nodiscard]] bool instances_allocated() const { return _instanceRange.size != 0; }
+
+        // copy world matrices into this frame's instance buffer if they changed since it was last written
+        void update_instances(InstanceBuffer *instanceBuffer, uint32_t frameIndex);
+
+        // model matrix applied to each instance, current after update_instances
+        [[nodiscard]] const std::vector<glm::mat4> &instance_matrices() const { return _instanceMatrices; }
+
+        // bounding radius around the model origin in model space
+        [[nodiscard]] float bounding_radius() const;
+
+        // world space bounds of every mesh draw around all instances, meshes in order with their transforms within,
+        // rebuilt when the instance matrices change
+        const std::vector<DrawBounds> &draw_bounds();
+
+        // changes whenever draw_bounds rebuilt them
+        [[nodiscard]] uint64_t bounds_version() const { return _boundsVersion; }
+
+        void upload_meshes(ResourceHandles *resources, UploadBatcher *uploader);
+
+        // add the draws of every mesh not handled by the meshlet culling pass to drawList, textureTable is the frame's
+        // TextureTable set when drawing bindless and VK_NULL_HANDLE otherwise
+        void draw_model(DrawList &drawList, DrawDataBuffer *drawData, const glm::vec3 &cameraPosition, const RenderSettings &settings,
+                        VkDescriptorSet textureTable);
+
+        // ask the streamer for texture detail based on how large each mesh appears from the camera
+        void request_textures(TextureStreamer *streamer, const glm::vec3 &cameraPosition, const glm::mat4 &projection, VkExtent2D extent);
+
+        // pick each mesh's level of detail from its simplification error projected to the screen
+        void select_lods(const glm::vec3 &cameraPosition, const glm::mat4 &projection, VkExtent2D extent, float errorPixels, LodStats &stats);
+
+        void register_textures(TextureStreamer *streamer);
+
+        // free mesh buffers and drop texture references, the GPU must be done with the model
+        void destroy(ResourceHandles *resources);
+
+        std::vector<Mesh> meshes;
+        Material *defaultMaterial;
+        // MODEL_OPTION flags, part of the mesh cache key like the import flags
+        uint32_t importOptions = MODEL_OPTION_STATIC_BATCHING;
+        // set by the ModelManager when the model is published and never reused, so a model
+        // allocated where a removed one lived isn't mistaken for it
+        uint64_t id = 0;
+
+        // using public float arrays so imgui can update them
+        float translation[3] = {0.0f, 0.0f, 0.0f};
+        float rotation[3] = {0.0f, 0.0f, 0.0f};
+        float scale[3] = {1.0f, 1.0f, 1.0f};
+
+    private:
+        glm::mat4 _modelMatrix = glm::mat4{1.0f};
+        std::vector<glm::mat4> _instances;
+        // model matrix applied to each instance, rebuilt when either changes
+        std::vector<glm::mat4> _instanceMatrices;
+        GeometryRange _instanceRange;
+        uint64_t _instanceVersion = 1;
+        uint64_t _matrixVersion = 0;
+        uint64_t _writtenVersion[FRAME_OVERLAP] = {};
+        size_t _failedInstanceCount = 0;
+        std::vector<DrawBounds> _drawBounds;
+        uint64_t _boundsVersion = 0;
+        TextureManager *_textureManager;
+        UploadBatcher *_uploader;
+        std::string _directory;
+
+        // pixels covered by one model space unit at the mesh's distance, unbounded once the camera is inside its bounds
+        [[nodiscard]] float pixels_per_unit(const Mesh &mesh, const glm::vec3 &cameraPosition, const glm::mat4 &projection, VkExtent2D extent) const;
+
+        // collect the accumulated node transforms each aiMesh is referenced with
+        void process_node(aiNode *node, const glm::mat4 &parentTransform, std::vector<std::vector<glm::mat4>> &meshTransforms);
+
+        // meshes referenced by several nodes stay instanced, the rest are batched if importOptions asks for it
+        void build_meshes(const aiScene *scene, const std::vector<std::vector<glm::mat4>> &meshTransforms);
+
+        // raw geometry with transform applied, not yet optimized
+        Mesh process_mesh(aiMesh *mesh, const aiScene *scene, const glm::mat4 &transform);
+
+        // optimize, split into meshlets and levels of detail, and load the texture
+        void finish_mesh(Mesh &mesh, const std::string &name);
+
+        bool load_from_cache(const std::string &filePath);
+
+        Texture *load_texture(const std::string &filePath);
+    };
+
+    struct PendingModel {
+        std::string filePath;
+        std::string name;
+        Material *defaultMaterial;
+        uint32_t importOptions;
+        std::function<void(Model &model)> onLoaded;
+        Model model;
+        uint64_t uploadTicket;
+        std::vector<VkBufferMemoryBarrier> bufferAcquires;
+        std::vector<VkImageMemoryBarrier> imageAcquires;
+    };
+
+    class ModelManager {
+    public:
+        std::unordered_map<std::string, Model> models;
+
+        void init(ResourceHandles *resources);
+
+        Model *create_model(const std::string &filePath, const std::string &name, Material *defaultMaterial, uint32_t importOptions = MODEL_OPTION_STATIC_BATCHING);
+
+        // import and record uploads on the loader thread, the model is added to models once the GPU has finished them
+        // name is reserved until then, a taken name gets a " (n)" suffix, returns the name the model will be added under
+        std::string create_model_async(const std::string &filePath, const std::string &name, Material *defaultMaterial, uint32_t importOptions = MODEL_OPTION_STATIC_BATCHING,
+                                std::function<void(Model &model)> onLoaded = nullptr);
+
+        // publish finished async loads, acquire barriers are recorded into cmd before the models are drawn
+        void update(VkCommandBuffer cmd);
+
+        // the model is destroyed once frames that may still draw it have finished
+        void remove_model(const std::string &name, DeletionQueue &frameDeletion);
+
+        [[nodiscard]] size_t pending_count();
+
+        void cleanup();
+
+    private:
+        ResourceHandles *_resources;
+
+        // loader thread state, uploads go through the transfer queue
+        UploadBatcher _transferUploader;
+        std::thread _loaderThread;
+        std::mutex _loaderMutex;
+        std::condition_variable _loaderCondition;
+        std::list<PendingModel> _queuedModels;
+        std::list<PendingModel> _loadedModels;
+        size_t _pendingCount = 0;
+        // names of queued and loaded models not yet in models
+        std::unordered_set<std::string> _pendingNames;
+        bool _stopping = false;
+        uint64_t _nextModelId = 1;
+
+        void loader_loop();
+
+        // first of name, "name (1)", "name (2)"... not in models or _pendingNames, _loaderMutex must be held
+        std::string unique_name(const std::string &name);
+    };
 }
\ No newline at end of file
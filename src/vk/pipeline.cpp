@@ -1,62 +1,79 @@
-#include <iostream>
-
-#include "pipeline.h"
-
-namespace VkRenderer::pipeline {
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state() {
-        // describe a new color blend attachment state
-        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        // disable blending
-        colorBlendAttachment.blendEnable = VK_FALSE;
-
-        return colorBlendAttachment;
-    }
-
-    VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass) {
-        // describe new viewport state
-        VkPipelineViewportStateCreateInfo viewportState = {};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.pNext = nullptr;
-        viewportState.viewportCount = 1;
-        viewportState.pViewports = &_viewport;
-        viewportState.scissorCount = 1;
-        viewportState.pScissors = &_scissor;
-
-        // describe dummy color blend state
-        VkPipelineColorBlendStateCreateInfo colorBlending = {};
-        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        colorBlending.pNext = nullptr;
-        colorBlending.logicOpEnable = VK_FALSE;
-        colorBlending.logicOp = VK_LOGIC_OP_COPY;
-        colorBlending.attachmentCount = 1;
-        colorBlending.pAttachments = &_colorBlendAttachment;
-
-        // describe new pipeline
-        VkGraphicsPipelineCreateInfo pipelineInfo = {};
-        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        pipelineInfo.pNext = nullptr;
-        pipelineInfo.stageCount = _shaderStages.size();
-        pipelineInfo.pStages = _shaderStages.data();
-        pipelineInfo.pVertexInputState = &_vertexInputInfo;
-        pipelineInfo.pInputAssemblyState = &_inputAssembly;
-        pipelineInfo.pViewportState = &viewportState;
-        pipelineInfo.pRasterizationState = &_rasterizer;
-        pipelineInfo.pMultisampleState = &_multisampling;
-        pipelineInfo.pDepthStencilState = &_depthStencil;
-        pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.layout = _pipelineLayout;
-        pipelineInfo.renderPass = pass;
-        pipelineInfo.subpass = 0;
-        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-        // create new pipeline and check - don't use VK_CHECK as errors are common
-        VkPipeline newPipeline;
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
-            std::cout << "Failed to create pipeline" << std::endl;
-            return VK_NULL_HANDLE;
-        } else {
-            return newPipeline;
-        }
-    }
+#include <iostream>
+#include <vk/info.h>
+
+#include "pipeline.h"
+
+namespace VkRenderer::pipeline {
+    VkPipelineColorBlendAttachmentState color_blend_attachment_state() {
+        // describe a new color blend attachment state
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        // disable blending
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        return colorBlendAttachment;
+    }
+
+    VkPipeline build_compute_pipeline(VkDevice device, VkShaderModule shader, VkPipelineLayout layout) {
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = nullptr;
+        pipelineInfo.stage = VkRenderer::info::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, shader);
+        pipelineInfo.layout = layout;
+
+        // same as graphics pipelines, report and carry on
+        VkPipeline newPipeline;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+            std::cout << "Failed to create compute pipeline" << std::endl;
+            return VK_NULL_HANDLE;
+        }
+        return newPipeline;
+    }
+
+    VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass) {
+        // describe new viewport state
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.pNext = nullptr;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = &_viewport;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = &_scissor;
+
+        // describe dummy color blend state
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.pNext = nullptr;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.logicOp = VK_LOGIC_OP_COPY;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &_colorBlendAttachment;
+
+        // describe new pipeline
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.pNext = nullptr;
+        pipelineInfo.stageCount = _shaderStages.size();
+        pipelineInfo.pStages = _shaderStages.data();
+        pipelineInfo.pVertexInputState = &_vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &_inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &_rasterizer;
+        pipelineInfo.pMultisampleState = &_multisampling;
+        pipelineInfo.pDepthStencilState = &_depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.layout = _pipelineLayout;
+        pipelineInfo.renderPass = pass;
+        pipelineInfo.subpass = 0;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        // create new pipeline and check - don't use VK_CHECK as errors are common
+        VkPipeline newPipeline;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &newPipeline) != VK_SUCCESS) {
+            std::cout << "Failed to create pipeline" << std::endl;
+            return VK_NULL_HANDLE;
+        } else {
+            return newPipeline;
+        }
+    }
 }
\ No newline at end of file
@@ -1,24 +1,26 @@
-#pragma once
-
-#include <vector>
-#include <vulkan/vulkan.h>
-
-namespace VkRenderer::pipeline {
-    VkPipelineColorBlendAttachmentState color_blend_attachment_state();
-
-    class PipelineBuilder {
-    public:
-        std::vector<VkPipelineShaderStageCreateInfo> _shaderStages;
-        VkPipelineVertexInputStateCreateInfo _vertexInputInfo;
-        VkPipelineInputAssemblyStateCreateInfo _inputAssembly;
-        VkPipelineRasterizationStateCreateInfo _rasterizer;
-        VkPipelineColorBlendAttachmentState _colorBlendAttachment;
-        VkPipelineMultisampleStateCreateInfo _multisampling;
-        VkPipelineDepthStencilStateCreateInfo _depthStencil;
-        VkPipelineLayout _pipelineLayout;
-        VkViewport _viewport;
-        VkRect2D _scissor;
-
-        VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
-    };
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace VkRenderer::pipeline {
+    VkPipelineColorBlendAttachmentState color_blend_attachment_state();
+
+    VkPipeline build_compute_pipeline(VkDevice device, VkShaderModule shader, VkPipelineLayout layout);
+
+    class PipelineBuilder {
+    public:
+        std::vector<VkPipelineShaderStageCreateInfo> _shaderStages;
+        VkPipelineVertexInputStateCreateInfo _vertexInputInfo;
+        VkPipelineInputAssemblyStateCreateInfo _inputAssembly;
+        VkPipelineRasterizationStateCreateInfo _rasterizer;
+        VkPipelineColorBlendAttachmentState _colorBlendAttachment;
+        VkPipelineMultisampleStateCreateInfo _multisampling;
+        VkPipelineDepthStencilStateCreateInfo _depthStencil;
+        VkPipelineLayout _pipelineLayout;
+        VkViewport _viewport;
+        VkRect2D _scissor;
+
+        VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
+    };
 }
\ No newline at end of file
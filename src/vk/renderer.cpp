@@ -3,6 +3,8 @@
 #include <vk_mem_alloc.h>
 
 #include <iostream>
+#include <cmath>
+#include <cstring>
 #include <SDL.h>
 #include <SDL_vulkan.h>
 #include <glm/gtx/transform.hpp>
@@ -14,6 +16,13 @@
 #include <vk/check.h>
 #include <vk/info.h>
 #include <vk/utils.h>
+#include <vk/upload.h>
+#include <vk/streaming.h>
+#include <vk/texture.h>
+#include <vk/geometry.h>
+#include <vk/instance_buffer.h>
+#include <vk/draw_data.h>
+#include <vk/texture_table.h>
 
 #include "renderer.h"
 
@@ -37,6 +46,11 @@ namespace VkRenderer {
         _resources.flyCamera = new FlyCamera(
                 glm::perspective(glm::radians(90.0f), (float) _resources.windowExtent.width / (float) _resources.windowExtent.height, 0.1f, 2000.0f));
 
+        // worker threads for asset decoding, leave a core for the main thread
+        uint32_t coreCount = std::thread::hardware_concurrency();
+        _resources.threadPool = new ThreadPool;
+        _resources.threadPool->init(coreCount > 1 ? coreCount - 1 : 1);
+
         init_vulkan();
         init_swapchain();
         init_commands();
@@ -74,16 +88,65 @@ namespace VkRenderer {
         vkb::PhysicalDevice physicalDevice = selector
                 .set_minimum_version(1, 1)
                 .set_surface(_resources.surface)
+                .add_desired_extension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+                .add_desired_extension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
                 .select()
                 .value();
 
+        // enable BC sampling when the device has it, cooked textures need it
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supportedFeatures);
+        _resources.textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+        physicalDevice.features.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        if (!_resources.textureCompressionBC) {
+            std::cout << "BC texture compression unsupported, cooked textures are ignored" << std::endl;
+        }
+
+        // GPU-driven drawing, culled draws keep their firstInstance as the draw data index
+        physicalDevice.features.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        physicalDevice.features.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        _resources.multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(physicalDevice.physical_device, nullptr, &extensionCount, extensions.data());
+        bool hasDescriptorIndexing = false;
+        for (auto &extension: extensions) {
+            _resources.drawIndirectCount |= strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+            hasDescriptorIndexing |= strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0;
+        }
+        if (!_resources.drawIndirectCount) {
+            std::cout << "Indirect draw count unsupported, GPU-driven draws keep culled commands" << std::endl;
+        }
+
+        // bindless textures, one partially bound image array indexed per fragment with nonuniformEXT
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT supportedIndexing = {};
+        supportedIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        supportedIndexing.pNext = nullptr;
+        VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+        supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supportedFeatures2.pNext = &supportedIndexing;
+        vkGetPhysicalDeviceFeatures2(physicalDevice.physical_device, &supportedFeatures2);
+        _resources.descriptorIndexing = hasDescriptorIndexing && supportedIndexing.shaderSampledImageArrayNonUniformIndexing &&
+                                        supportedIndexing.descriptorBindingPartiallyBound && supportedIndexing.runtimeDescriptorArray;
+
         // create the device
         vkb::DeviceBuilder deviceBuilder{physicalDevice};
         VkPhysicalDeviceShaderDrawParametersFeatures shader_draw_parameters_features = {};
         shader_draw_parameters_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
         shader_draw_parameters_features.pNext = nullptr;
         shader_draw_parameters_features.shaderDrawParameters = VK_TRUE;
-        vkb::Device vkbDevice = deviceBuilder.add_pNext(&shader_draw_parameters_features).build().value();
+        deviceBuilder.add_pNext(&shader_draw_parameters_features);
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptor_indexing_features = {};
+        descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+        descriptor_indexing_features.pNext = nullptr;
+        descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+        descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+        descriptor_indexing_features.runtimeDescriptorArray = VK_TRUE;
+        if (_resources.descriptorIndexing) {
+            deviceBuilder.add_pNext(&descriptor_indexing_features);
+        }
+        vkb::Device vkbDevice = deviceBuilder.build().value();
 
         // set the device handles
         _resources.device = vkbDevice.device;
@@ -96,9 +159,27 @@ namespace VkRenderer {
         _resources.graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
         _resources.graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+        // prefer a transfer-only queue for background uploads, fall back to sharing the graphics queue
+        auto dedicatedTransferQueue = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+        if (dedicatedTransferQueue.has_value()) {
+            _resources.transferQueue = dedicatedTransferQueue.value();
+            _resources.transferQueueFamily = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+            std::cout << "Using dedicated transfer queue family " << _resources.transferQueueFamily << std::endl;
+        } else {
+            _resources.transferQueue = _resources.graphicsQueue;
+            _resources.transferQueueFamily = _resources.graphicsQueueFamily;
+            std::cout << "No dedicated transfer queue, uploading on the graphics queue" << std::endl;
+        }
+
         // initialize memory allocator
         VmaAllocatorCreateInfo allocatorInfo = VkRenderer::info::allocator_create_info(_resources.chosenGPU, _resources.device, _resources.instance);
         vmaCreateAllocator(&allocatorInfo, &_resources.allocator);
+
+        // device-local memory the CPU can write means uploads can skip the staging copy
+        _resources.hostVisibleDeviceMemory = VkRenderer::utils::has_host_visible_device_memory(_resources.chosenGPU);
+        if (_resources.hostVisibleDeviceMemory) {
+            std::cout << "Device memory is host-visible, geometry can be written in place" << std::endl;
+        }
     }
 
     void Renderer::init_swapchain() {
@@ -124,7 +205,9 @@ namespace VkRenderer {
                 1
         };
         _resources.depthFormat = VK_FORMAT_D32_SFLOAT;
-        VkImageCreateInfo depthImageInfo = VkRenderer::info::image_create_info(_resources.depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthImageExtent);
+        // also sampled to build the occlusion culling depth pyramid
+        VkImageCreateInfo depthImageInfo = VkRenderer::info::image_create_info(_resources.depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                                                               depthImageExtent);
 
         // allocate memory on GPU only
         VmaAllocationCreateInfo depthImageAllocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_GPU_ONLY,
@@ -151,7 +234,7 @@ namespace VkRenderer {
             VkCommandBufferAllocateInfo cmdAllocInfo = VkRenderer::info::command_buffer_allocate_info(_frame._commandPool, 1);
             VK_CHECK(vkAllocateCommandBuffers(_resources.device, &cmdAllocInfo, &_frame._mainCommandBuffer));
 
-            _resources.mainDeletionQueue.push_function([=]() {
+            _resources.mainDeletionQueue.push_function([=, &_frame]() {
                 vkDestroyCommandPool(_resources.device, _frame._commandPool, nullptr);
             });
         }
@@ -166,6 +249,10 @@ namespace VkRenderer {
         // allocate command buffer too
         VkCommandBufferAllocateInfo uploadCmdAllocInfo = VkRenderer::info::command_buffer_allocate_info(_resources.uploadContext._commandPool, 1);
         VK_CHECK(vkAllocateCommandBuffers(_resources.device, &uploadCmdAllocInfo, &_resources.uploadContext._commandBuffer));
+
+        // batched uploads for synchronous loads on the graphics queue
+        _resources.uploader = new UploadBatcher;
+        _resources.uploader->init(&_resources, _resources.graphicsQueue, _resources.graphicsQueueFamily);
     }
 
     void Renderer::init_default_renderpass() {
@@ -202,7 +289,38 @@ namespace VkRenderer {
         VkRenderPassCreateInfo render_pass_info = VkRenderer::info::renderpass_create_info(2, &attachments[0], 2, &dependencies[0], 1, &subpass);
         VK_CHECK(vkCreateRenderPass(_resources.device, &render_pass_info, nullptr, &_resources.renderPass));
 
+        // occlusion culling's early pass clears like the one above, but leaves color to the late pass and depth readable by the pyramid build
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        VkSubpassDependency pyramid_dependency = VkRenderer::info::subpass_dependency(0, VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                                                                      VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                                                                      VK_ACCESS_SHADER_READ_BIT);
+        VkSubpassDependency early_dependencies[3] = {color_dependency, depth_dependency, pyramid_dependency};
+        VkRenderPassCreateInfo early_pass_info = VkRenderer::info::renderpass_create_info(2, &attachments[0], 3, &early_dependencies[0], 1, &subpass);
+        VK_CHECK(vkCreateRenderPass(_resources.device, &early_pass_info, nullptr, &_resources.earlyRenderPass));
+
+        // the late pass continues on top of the early pass's color and depth once the pyramid is built
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        VkSubpassDependency late_color_dependency = VkRenderer::info::subpass_dependency(VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                                                         VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                                                                                         VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+        VkSubpassDependency late_depth_dependency = VkRenderer::info::subpass_dependency(VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                                                                         VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                                                                                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                                                                         VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        VkSubpassDependency late_dependencies[2] = {late_color_dependency, late_depth_dependency};
+        VkRenderPassCreateInfo late_pass_info = VkRenderer::info::renderpass_create_info(2, &attachments[0], 2, &late_dependencies[0], 1, &subpass);
+        VK_CHECK(vkCreateRenderPass(_resources.device, &late_pass_info, nullptr, &_resources.lateRenderPass));
+
         _resources.mainDeletionQueue.push_function([=]() {
+            vkDestroyRenderPass(_resources.device, _resources.lateRenderPass, nullptr);
+            vkDestroyRenderPass(_resources.device, _resources.earlyRenderPass, nullptr);
             vkDestroyRenderPass(_resources.device, _resources.renderPass, nullptr);
         });
     }
@@ -238,13 +356,13 @@ namespace VkRenderer {
         VkSemaphoreCreateInfo semaphoreCreateInfo = VkRenderer::info::semaphore_create_info();
         for (auto &_frame: _frames) {
             VK_CHECK(vkCreateFence(_resources.device, &fenceCreateInfo, nullptr, &_frame._renderFence));
-            _resources.mainDeletionQueue.push_function([=]() {
+            _resources.mainDeletionQueue.push_function([=, &_frame]() {
                 vkDestroyFence(_resources.device, _frame._renderFence, nullptr);
             });
 
             VK_CHECK(vkCreateSemaphore(_resources.device, &semaphoreCreateInfo, nullptr, &_frame._presentSemaphore));
             VK_CHECK(vkCreateSemaphore(_resources.device, &semaphoreCreateInfo, nullptr, &_frame._renderSemaphore));
-            _resources.mainDeletionQueue.push_function([=]() {
+            _resources.mainDeletionQueue.push_function([=, &_frame]() {
                 vkDestroySemaphore(_resources.device, _frame._presentSemaphore, nullptr);
                 vkDestroySemaphore(_resources.device, _frame._renderSemaphore, nullptr);
             });
@@ -262,18 +380,31 @@ namespace VkRenderer {
         // create the layout cache
         _resources.descriptorLayoutCache = new VkRenderer::descriptor::LayoutCache{};
         _resources.descriptorLayoutCache->init(_resources.device);
-
-        // create global set layout
-        VkDescriptorSetLayoutBinding camBufferBinding = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-        VkDescriptorSetLayoutCreateInfo globalLayoutInfo = VkRenderer::info::descriptor_set_layout_create_info(1, &camBufferBinding, 0);
+        _resources.samplerCache = new VkRenderer::descriptor::SamplerCache{};
+        _resources.samplerCache->init(_resources.device);
+
+        // create global set layout, camera, instance matrices and per-draw data
+        VkDescriptorSetLayoutBinding globalBindings[] = {
+                VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0),
+                VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 1),
+                VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 2)
+        };
+        VkDescriptorSetLayoutCreateInfo globalLayoutInfo = VkRenderer::info::descriptor_set_layout_create_info(3, globalBindings, 0);
         _resources.globalSetLayout = _resources.descriptorLayoutCache->create_descriptor_layout(&globalLayoutInfo);
 
-        // create texture set layout
+        // create texture set layout, every texture is sampled the same way so the sampler is immutable
+        VkSamplerCreateInfo samplerInfo = VkRenderer::info::sampler_create_info(VK_FILTER_LINEAR);
+        _resources.textureSampler = _resources.samplerCache->create_sampler(&samplerInfo);
         VkDescriptorSetLayoutBinding textureBind = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT,
                                                                                                          0);
+        textureBind.pImmutableSamplers = &_resources.textureSampler;
         VkDescriptorSetLayoutCreateInfo textureLayoutInfo = VkRenderer::info::descriptor_set_layout_create_info(1, &textureBind, 0);
         _resources.textureSetLayout = _resources.descriptorLayoutCache->create_descriptor_layout(&textureLayoutInfo);
 
+        // every texture again in one array for bindless materials, textures join it as they are uploaded
+        _resources.textureTable = new TextureTable;
+        _resources.textureTable->init(&_resources);
+
         // set up buffers for each frame in flight
         for (auto &_frame: _frames) {
             // create descriptor allocators
@@ -282,7 +413,7 @@ namespace VkRenderer {
 
             // create camera buffer
             _frame.cameraBuffer = VkRenderer::utils::create_buffer(_resources.allocator, sizeof(GPUCameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-            _resources.mainDeletionQueue.push_function([=]() {
+            _resources.mainDeletionQueue.push_function([=, &_frame]() {
                 vmaDestroyBuffer(_resources.allocator, _frame.cameraBuffer._buffer, _frame.cameraBuffer._allocation);
             });
         }
@@ -320,6 +451,28 @@ namespace VkRenderer {
         texturedMaterialInfo.name = "textured_mesh";
         _materialManager.create_material(&texturedMaterialInfo);
 
+        // same material reading the compact vertex format
+        texturedMaterialInfo.vertShaderPath = "../shaders/default_mesh_compact.vert.spv";
+        texturedMaterialInfo.name = "textured_mesh_compact";
+        texturedMaterialInfo.vertexFormat = VertexFormat::Compact;
+        _materialManager.create_material(&texturedMaterialInfo);
+
+        // both textured materials again, sampling the texture table with the index from the draw data
+        if (_resources.textureTable->supported()) {
+            VkDescriptorSetLayout bindlessSetLayouts[] = {_resources.globalSetLayout, _resources.textureTable->layout()};
+            texturedMaterialInfo.setLayouts = bindlessSetLayouts;
+            texturedMaterialInfo.fragShaderPath = "../shaders/textured_lit_bindless.frag.spv";
+            texturedMaterialInfo.vertShaderPath = "../shaders/default_mesh.vert.spv";
+            texturedMaterialInfo.name = "textured_mesh_bindless";
+            texturedMaterialInfo.vertexFormat = VertexFormat::Standard;
+            _materialManager.get_material("textured_mesh")->bindless = _materialManager.create_material(&texturedMaterialInfo);
+
+            texturedMaterialInfo.vertShaderPath = "../shaders/default_mesh_compact.vert.spv";
+            texturedMaterialInfo.name = "textured_mesh_compact_bindless";
+            texturedMaterialInfo.vertexFormat = VertexFormat::Compact;
+            _materialManager.get_material("textured_mesh_compact")->bindless = _materialManager.create_material(&texturedMaterialInfo);
+        }
+
         _resources.mainDeletionQueue.push_function([=]() {
             _materialManager.cleanup(_resources.device);
         });
@@ -377,14 +530,49 @@ namespace VkRenderer {
     }
 
     void Renderer::init_scene() {
+        // one texture cache shared by every model
+        _resources.textureManager = new TextureManager;
+        _resources.textureManager->init(&_resources);
+        _resources.mainDeletionQueue.push_function([=]() {
+            _resources.textureManager->cleanup();
+        });
+
+        // every model's geometry is sub-allocated from one vertex and one index buffer
+        _resources.geometryBuffer = new GeometryBuffer;
+        _resources.geometryBuffer->init(&_resources);
+        _meshletCuller.init(&_resources);
+        _depthPyramid.init(&_resources);
+        _indirectScene.init(&_resources);
+        _drawList.init(&_resources);
+
+        // model placement, models copy their instance matrices in as they change
+        _resources.instanceBuffer = new InstanceBuffer;
+        _resources.instanceBuffer->init(&_resources);
+
+        // refilled by every frame's draws
+        _resources.drawData = new DrawDataBuffer;
+        _resources.drawData->init(&_resources);
+        _sceneBvh.init(&_resources);
+
+        // models register their textures as they are published
+        _resources.textureStreamer = new TextureStreamer;
+        _resources.textureStreamer->init(&_resources);
         _modelManager.init(&_resources);
 
-        _modelManager.create_model("../assets/sponza-gltf-pbr/sponza.glb", "sponza", _materialManager.get_material("textured_mesh"));
+        _modelManager.create_model("../assets/sponza-gltf-pbr/sponza.glb", "sponza", get_model_material(), get_import_options());
         _modelManager.models["sponza"].scale[0] = 0.1f;
         _modelManager.models["sponza"].scale[1] = 0.1f;
         _modelManager.models["sponza"].scale[2] = 0.1f;
 
-        _modelManager.create_model("../assets/SciFiHelmet.gltf", "helmet", _materialManager.get_material("textured_mesh"));
+        _modelManager.create_model("../assets/SciFiHelmet.gltf", "helmet", get_model_material(), get_import_options());
+    }
+
+    Material *Renderer::get_model_material() {
+        return _materialManager.get_material(_resources.settings.compactVertices ? "textured_mesh_compact" : "textured_mesh");
+    }
+
+    uint32_t Renderer::get_import_options() {
+        return _resources.settings.staticBatching ? MODEL_OPTION_STATIC_BATCHING : 0;
     }
 
     FrameData &Renderer::get_current_frame() {
@@ -424,18 +612,162 @@ namespace VkRenderer {
         ImGui::SetNextWindowPos(sceneWindowPos, 0, sceneWindowPivot);
         ImGui::SetNextWindowSize(sceneWindowSize);
         ImGui::Begin("Scene", nullptr);
+
+        // load models in the background while rendering continues
+        static char modelPath[256] = "../assets/SciFiHelmet.gltf";
+        ImGui::InputText("##ModelPath", modelPath, sizeof(modelPath));
+        ImGui::SameLine();
+        if (ImGui::Button("Load")) {
+            std::string path = modelPath;
+            // loading the same file again adds another copy, the manager picks a free name
+            std::string name = path.substr(path.find_last_of('/') + 1);
+            _modelManager.create_model_async(path, name, get_model_material(), get_import_options());
+        }
+        size_t pendingModels = _modelManager.pending_count();
+        if (pendingModels > 0) {
+            ImGui::Text("Loading %zu model(s)...", pendingModels);
+        }
+        ImGui::Separator();
+
+        if (ImGui::CollapsingHeader("Rendering")) {
+            // negative values sharpen, positive values trade detail for texture bandwidth
+            ImGui::SliderFloat("LOD Bias", &_resources.settings.lodBias, -4.0f, 4.0f, "%.2f");
+
+            // the smallest mips of every texture stay resident regardless of the budget
+            ImGui::SliderInt("Texture Budget", &_resources.settings.textureBudgetMB, 64, 4096, "%d MB");
+            StreamingStats streamingStats = _resources.textureStreamer->stats();
+            ImGui::Text("Texture memory: %.1f / %.0f MB", static_cast<double>(streamingStats.residentBytes) / (1024.0 * 1024.0),
+                        static_cast<double>(streamingStats.budgetBytes) / (1024.0 * 1024.0));
+            ImGui::Text("Full detail: %zu / %zu textures, %zu uploads in flight", streamingStats.fullyResident, streamingStats.textureCount,
+                        streamingStats.uploadsInFlight);
+            ImGui::Text("Texture cache: %zu unique textures, %zu samplers", _resources.textureManager->texture_count(),
+                        _resources.samplerCache->sampler_count());
+
+            // only affects models loaded afterwards, their buffers are packed at upload
+            ImGui::Checkbox("Compact Vertices", &_resources.settings.compactVertices);
+            ImGui::SameLine();
+            ImGui::Checkbox("Static Batching", &_resources.settings.staticBatching);
+            size_t meshCount = 0;
+            size_t meshDraws = 0;
+            size_t instanceCount = 0;
+            for (auto &it: _modelManager.models) {
+                for (auto &mesh: it.second.meshes) {
+                    meshCount++;
+                    meshDraws += mesh._transforms.size();
+                }
+                instanceCount += it.second.instance_count();
+            }
+            ImGui::Text("Meshes: %zu, %zu draws, %zu model instances", meshCount, meshDraws, instanceCount);
+            GeometryStats geometryStats = _resources.geometryBuffer->stats();
+            ImGui::Text("Vertex buffer: %.1f / %.0f MB", static_cast<double>(geometryStats.vertexBytes) / (1024.0 * 1024.0),
+                        static_cast<double>(geometryStats.vertexCapacity) / (1024.0 * 1024.0));
+            ImGui::Text("Index buffer: %.1f / %.0f MB", static_cast<double>(geometryStats.indexBytes) / (1024.0 * 1024.0),
+                        static_cast<double>(geometryStats.indexCapacity) / (1024.0 * 1024.0));
+
+            // 0 keeps everything at full detail apart from lossless simplifications
+            ImGui::SliderFloat("LOD Error", &_resources.settings.lodErrorPixels, 0.0f, 8.0f, "%.1f px");
+            ImGui::Text("LOD triangles: %zu / %zu, %zu of %zu meshes reduced", _lodStats.selectedTriangles, _lodStats.baseTriangles,
+                        _lodStats.reducedMeshCount, _lodStats.meshCount);
+
+            ImGui::Checkbox("Frustum Culling", &_resources.settings.frustumCulling);
+            FrustumStats frustumStats = _frustumCuller.stats();
+            ImGui::Text("Frustum: %zu / %zu draws visible, %zu nodes visited, %.0f us", frustumStats.visibleCount, frustumStats.drawCount,
+                        frustumStats.visitedNodes, frustumStats.cullTime);
+            BvhStats bvhStats = _sceneBvh.stats();
+            ImGui::Text("Scene BVH: %zu nodes, %zu builds, %zu refits, %.0f us", bvhStats.nodeCount, bvhStats.builds, bvhStats.refits, bvhStats.updateTime);
+
+            ImGui::Checkbox("Meshlet Culling", &_resources.settings.meshletCulling);
+            ImGui::SameLine();
+            ImGui::Checkbox("Cone Culling", &_resources.settings.coneCulling);
+            ImGui::SameLine();
+            ImGui::Checkbox("Occlusion Culling", &_resources.settings.occlusionCulling);
+            if (_resources.settings.meshletCulling) {
+                MeshletStats meshletStats = _meshletCuller.stats();
+                ImGui::Text("Triangles: %zu visible / %zu, %zu meshlets in %zu draws", meshletStats.visibleTriangles, meshletStats.submittedTriangles,
+                            meshletStats.meshletCount, meshletStats.drawCount);
+                if (_resources.settings.occlusionCulling) {
+                    ImGui::Text("Occluded: %zu meshes, %zu meshlets, %zu triangles", meshletStats.occludedDraws, meshletStats.occludedMeshlets,
+                                meshletStats.occludedTriangles);
+                }
+            }
+
+            ImGui::Checkbox("GPU Driven", &_resources.settings.gpuDriven);
+            if (_resources.textureTable->supported()) {
+                ImGui::SameLine();
+                ImGui::Checkbox("Bindless Textures", &_resources.settings.bindlessTextures);
+                if (_resources.settings.bindlessTextures) {
+                    ImGui::Text("Texture table: %u / %u slots", _resources.textureTable->count(), _resources.textureTable->capacity());
+                }
+            }
+            if (_resources.settings.gpuDriven) {
+                IndirectStats indirectStats = _indirectScene.stats();
+                ImGui::Text("Indirect: %zu / %zu objects visible in %zu batches, %zu rebuilds", indirectStats.visibleCount, indirectStats.objectCount,
+                            indirectStats.batchCount, indirectStats.rebuilds);
+            }
+
+            // cpu time spent recording the scene's draws, culling dispatches excluded
+            double nsPerDraw = _recordedDraws > 0 ? _drawRecordTime * 1000.0 / static_cast<double>(_recordedDraws) : 0.0;
+            ImGui::Text("Draw recording: %.0f us, %u draws, %.0f ns per draw", _drawRecordTime, _recordedDraws, nsPerDraw);
+            if (!_resources.settings.gpuDriven) {
+                DrawListStats drawListStats = _drawList.stats();
+                ImGui::Text("Draw list: %zu draws, %zu pipeline / %zu texture / %zu index binds, sort %.0f us", drawListStats.drawCount,
+                            drawListStats.pipelineBinds, drawListStats.descriptorBinds, drawListStats.indexBinds, drawListStats.sortTime);
+            }
+        }
+        ImGui::Separator();
+
+        // click in the viewport to pick a model
+        ImGui::Text("Picked: %s", _pickedModel.empty() ? "none" : _pickedModel.c_str());
         for (auto &it: _modelManager.models) {
+            if (!_pickOpened && it.first == _pickedModel) {
+                ImGui::SetNextItemOpen(true);
+            }
             if(ImGui::TreeNode(it.first.c_str())) {
                 ImGui::DragFloat3("Translation", it.second.translation, 1.0f, 0.0f, 0.0f, "%.1f");
                 ImGui::DragFloat3("Rotation", it.second.rotation, 1.0f, -360.0f, 360.0f, "%.1f deg");
                 ImGui::DragFloat3("Scale", it.second.scale, 1.0f, 0.0f, 0.0f, "%.1f");
+
+                // square grid of instances spaced by the model's size, all drawn with the same draw calls
+                int grid = static_cast<int>(std::lround(std::sqrt(static_cast<double>(it.second.instance_count()))));
+                if (ImGui::SliderInt("Instance Grid", &grid, 1, 100)) {
+                    std::vector<glm::mat4> instances;
+                    float spacing = 2.0f * it.second.bounding_radius();
+                    for (int x = 0; grid > 1 && x < grid; x++) {
+                        for (int z = 0; z < grid; z++) {
+                            instances.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(x) * spacing, 0.0f, static_cast<float>(z) * spacing)));
+                        }
+                    }
+                    it.second.set_instances(instances);
+                }
+                if (ImGui::Button("Remove")) {
+                    _removedModel = it.first;
+                }
                 ImGui::TreePop();
             }
         }
+        _pickOpened = true;
         ImGui::End();
     }
 
-    void Renderer::draw_objects(VkCommandBuffer cmd) {
+    void Renderer::pick(int x, int y) {
+        // ray from the camera through the pixel center to the far plane
+        glm::mat4 inverseViewproj = glm::inverse(_resources.flyCamera->_projection * _resources.flyCamera->get_view_matrix());
+        float ndcX = 2.0f * (static_cast<float>(x) + 0.5f) / static_cast<float>(_resources.windowExtent.width) - 1.0f;
+        float ndcY = 2.0f * (static_cast<float>(y) + 0.5f) / static_cast<float>(_resources.windowExtent.height) - 1.0f;
+        glm::vec4 farPoint = inverseViewproj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+        glm::vec3 origin = _resources.flyCamera->get_position();
+        glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+
+        PickResult result;
+        if (_sceneBvh.raycast(origin, direction, result)) {
+            _pickedModel = result.modelName;
+            _pickOpened = false;
+        } else {
+            _pickedModel.clear();
+        }
+    }
+
+    void Renderer::draw_objects(VkCommandBuffer cmd, bool late) {
         // set up camera parameters and copy
         GPUCameraData camData;
         camData.proj = _resources.flyCamera->_projection;
@@ -448,19 +780,66 @@ namespace VkRenderer {
 
         // get buffer info and build set
         VkDescriptorBufferInfo camBufferInfo = VkRenderer::info::descriptor_buffer_info(get_current_frame().cameraBuffer._buffer, 0, sizeof(GPUCameraData));
+        VkDescriptorBufferInfo instanceBufferInfo = VkRenderer::info::descriptor_buffer_info(_resources.instanceBuffer->buffer(_frameNumber % FRAME_OVERLAP), 0,
+                                                                                             INSTANCE_CAPACITY * sizeof(glm::mat4));
+        VkDescriptorBufferInfo drawDataInfo = VkRenderer::info::descriptor_buffer_info(_resources.drawData->buffer(_frameNumber % FRAME_OVERLAP), 0,
+                                                                                       DRAW_DATA_CAPACITY * sizeof(GPUDrawData));
+        if (_resources.settings.gpuDriven) {
+            drawDataInfo = _indirectScene.draw_data_info(_frameNumber % FRAME_OVERLAP);
+        }
         VkDescriptorSet globalSet;
         VkRenderer::descriptor::Builder::begin(_resources.descriptorLayoutCache, get_current_frame()._descriptorAllocator)
                 .bind_buffer(0, &camBufferInfo, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                .bind_buffer(1, &instanceBufferInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                .bind_buffer(2, &drawDataInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
                 .build(globalSet);
 
         Material *defaultMaterial = _materialManager.get_material("textured_mesh");
         vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultMaterial->pipeline);
         vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, defaultMaterial->pipelineLayout, 0, 1, &globalSet, 0, nullptr);
 
+        // every material has the same push constant range, so this survives the pipeline changes below
+        FramePushConstant constants = {};
+        constants.data.x = _resources.settings.lodBias;
+        vkCmdPushConstants(cmd, defaultMaterial->pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(FramePushConstant), &constants);
+
+        _resources.geometryBuffer->bind(cmd);
+        auto recordStart = std::chrono::high_resolution_clock::now();
+
+        // the whole scene in one indirect draw per batch
+        if (_resources.settings.gpuDriven) {
+            _indirectScene.draw(cmd, _frameNumber % FRAME_OVERLAP);
+            auto recordEnd = std::chrono::high_resolution_clock::now();
+            _drawRecordTime = std::chrono::duration<double, std::micro>(recordEnd - recordStart).count();
+            _recordedDraws = static_cast<uint32_t>(_indirectScene.stats().batchCount);
+            return;
+        }
+
+        // meshes that went through the culling pass draw from its compacted index buffer, then the shared one is rebound
+        if (_resources.settings.meshletCulling) {
+            _meshletCuller.draw(cmd, _frameNumber % FRAME_OVERLAP, late);
+            _resources.geometryBuffer->bind(cmd);
+        }
+
+        // everything else is drawn in the early pass, where it also occludes
+        if (late) {
+            auto lateEnd = std::chrono::high_resolution_clock::now();
+            _drawRecordTime += std::chrono::duration<double, std::micro>(lateEnd - recordStart).count();
+            return;
+        }
+
+        // models may use either vertex format, the layouts are compatible so the global set stays bound,
+        // the draw list orders every draw by state and depth before recording it
+        VkDescriptorSet textureTable = _resources.settings.bindlessTextures ? _resources.textureTable->descriptor(_frameNumber % FRAME_OVERLAP) : VK_NULL_HANDLE;
+        _drawList.clear();
         for (auto &it: _modelManager.models) {
-            it.second.update_transform();
-            it.second.draw_model(cmd);
+            it.second.draw_model(_drawList, _resources.drawData, _resources.flyCamera->get_position(), _resources.settings, textureTable);
         }
+        _drawList.submit(cmd);
+
+        auto recordEnd = std::chrono::high_resolution_clock::now();
+        _drawRecordTime = std::chrono::duration<double, std::micro>(recordEnd - recordStart).count();
+        _recordedDraws = _resources.drawData->count();
     }
 
     void Renderer::draw() {
@@ -470,6 +849,13 @@ namespace VkRenderer {
         // wait until previous frame is rendered, timeout 1sec
         VK_CHECK(vkWaitForFences(_resources.device, 1, &get_current_frame()._renderFence, true, 1000000000));
         VK_CHECK(vkResetFences(_resources.device, 1, &get_current_frame()._renderFence));
+        get_current_frame()._deletionQueue.flush();
+
+        // removed in the UI before the wait, freed with textures only it used once this frame's fence comes around again
+        if (!_removedModel.empty()) {
+            _modelManager.remove_model(_removedModel, get_current_frame()._deletionQueue);
+            _removedModel.clear();
+        }
 
         // check for camera movement - use previous frametime as a delta
         _resources.flyCamera->process_keyboard(_previousFrameTime);
@@ -487,6 +873,46 @@ namespace VkRenderer {
         VkCommandBufferBeginInfo cmdBeginInfo = VkRenderer::info::command_buffer_begin_info(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
         VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
+        // publish models whose background uploads have finished
+        _modelManager.update(cmd);
+
+        // this frame's fence has been waited on, so its draw data can be refilled
+        _resources.drawData->begin_frame(_frameNumber % FRAME_OVERLAP);
+
+        // stream texture mips and pick detail levels for what the camera can see, GPU-driven draws pick theirs per instance
+        _lodStats = {};
+        bool gpuDriven = _resources.settings.gpuDriven;
+        for (auto &it: _modelManager.models) {
+            it.second.update_transform();
+            it.second.update_instances(_resources.instanceBuffer, _frameNumber % FRAME_OVERLAP);
+            it.second.request_textures(_resources.textureStreamer, _resources.flyCamera->get_position(), _resources.flyCamera->_projection, _resources.windowExtent);
+            if (!gpuDriven) {
+                it.second.select_lods(_resources.flyCamera->get_position(), _resources.flyCamera->_projection, _resources.windowExtent,
+                                      _resources.settings.lodErrorPixels, _lodStats);
+            }
+        }
+        _resources.textureStreamer->update(get_current_frame()._deletionQueue);
+        // after the streamer, so images it replaced this frame are in the frame's table
+        _resources.textureTable->begin_frame(_frameNumber % FRAME_OVERLAP);
+
+        // refit the scene hierarchy to moved models, then drop draws outside the view, the meshlet pass only refines what is left
+        _sceneBvh.update(_modelManager.models);
+        glm::mat4 viewproj = _resources.flyCamera->_projection * _resources.flyCamera->get_view_matrix();
+        if (!gpuDriven) {
+            _frustumCuller.cull(_modelManager.models, _sceneBvh, viewproj, _resources.settings.frustumCulling);
+        }
+
+        // cull before the render pass, compute can't run inside it
+        bool occlusion = !gpuDriven && _resources.settings.meshletCulling && _resources.settings.occlusionCulling;
+        if (gpuDriven) {
+            _indirectScene.cull(cmd, _frameNumber % FRAME_OVERLAP, get_current_frame()._descriptorAllocator, _modelManager.models, viewproj,
+                                _resources.flyCamera->get_position());
+        } else if (_resources.settings.meshletCulling) {
+            _meshletCuller.cull(cmd, _frameNumber % FRAME_OVERLAP, get_current_frame()._descriptorAllocator, _modelManager.models, viewproj,
+                                _resources.flyCamera->get_position(), _depthPyramid, occlusion,
+                                get_current_frame()._deletionQueue);
+        }
+
         // clear screen to black
         VkClearValue clearValue;
         clearValue.color = {0.0f, 0.0f, 0.0f, 1.0f};
@@ -499,21 +925,34 @@ namespace VkRenderer {
         VkClearValue clearValues[2] = {clearValue, depthClear};
 
         // start the render pass
-        VkRenderPassBeginInfo rpInfo = VkRenderer::info::renderpass_begin_info(_resources.renderPass, 0, 0, _resources.windowExtent, _resources.framebuffers[swapchainImageIndex],
-                                                                               2, &clearValues[0]);
+        VkRenderPassBeginInfo rpInfo = VkRenderer::info::renderpass_begin_info(occlusion ? _resources.earlyRenderPass : _resources.renderPass, 0, 0, _resources.windowExtent,
+                                                                               _resources.framebuffers[swapchainImageIndex], 2, &clearValues[0]);
         vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+        draw_objects(cmd, false);
+
+        // what was visible last frame is in the depth now, test the rest against it and draw what shows
+        if (occlusion) {
+            vkCmdEndRenderPass(cmd);
+            _depthPyramid.build(cmd, get_current_frame()._descriptorAllocator);
+            _meshletCuller.cull_late(cmd, _frameNumber % FRAME_OVERLAP);
 
-        // draw scene and GUI
-        draw_objects(cmd);
+            rpInfo.renderPass = _resources.lateRenderPass;
+            vkCmdBeginRenderPass(cmd, &rpInfo, VK_SUBPASS_CONTENTS_INLINE);
+            draw_objects(cmd, true);
+        }
+
+        // GUI on top
         ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
 
         vkCmdEndRenderPass(cmd);
         VK_CHECK(vkEndCommandBuffer(cmd));
+        _resources.drawData->end_frame();
 
         // submit to queue and check result - wait on present semaphore so swapchain is ready, signal render semaphore when we're done
         VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
         VkSubmitInfo submit = VkRenderer::info::submit_info(&waitStage, 1, &get_current_frame()._presentSemaphore, 1,
                                                             &get_current_frame()._renderSemaphore, 1, &cmd);
+        std::lock_guard<std::mutex> queueLock(_resources.queueMutex);
         VK_CHECK(vkQueueSubmit(_resources.graphicsQueue, 1, &submit, get_current_frame()._renderFence));
 
         // present image and check result
@@ -558,6 +997,10 @@ namespace VkRenderer {
                 if (e.type == SDL_MOUSEMOTION && !_toggleUI) {
                     _resources.flyCamera->process_mouse(e.motion.xrel, e.motion.yrel);
                 }
+                // pick with clicks that the UI didn't take
+                if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT && _toggleUI && !ImGui::GetIO().WantCaptureMouse) {
+                    pick(e.button.x, e.button.y);
+                }
             }
 
             ImGui_ImplVulkan_NewFrame();
@@ -578,16 +1021,21 @@ namespace VkRenderer {
         if (_isInitialized) {
             // block until GPU finishes
             vkDeviceWaitIdle(_resources.device);
+            _modelManager.cleanup();
+            _resources.threadPool->cleanup();
 
             // flush the deletion queues
+            for (auto &_frame: _frames) {
+                _frame._deletionQueue.flush();
+            }
             _resources.mainDeletionQueue.flush();
-            //_modelManager.cleanup();
 
             // clean up caches
             for (auto &_frame: _frames) {
                 _frame._descriptorAllocator->cleanup();
             }
             _resources.descriptorLayoutCache->cleanup();
+            _resources.samplerCache->cleanup();
 
             // manually destroy remaining objects
             ImPlot::DestroyContext();
@@ -3,13 +3,17 @@
 #include <functional>
 #include <vk/material.h>
 #include <vk/model.h>
+#include <vk/meshlet_culling.h>
+#include <vk/frustum_culling.h>
+#include <vk/bvh.h>
+#include <vk/depth_pyramid.h>
+#include <vk/indirect_scene.h>
+#include <vk/draw_list.h>
 #include <vk/types.h>
 #include <camera.h>
 #include <imgui.h>
 
 namespace VkRenderer {
-    constexpr unsigned int FRAME_OVERLAP = 2;
-
     struct ScrollingBuffer {
         int MaxSize;
         int Offset;
@@ -54,6 +58,22 @@ namespace VkRenderer {
         int _frameNumber = 0;
         ModelManager _modelManager;
         MaterialManager _materialManager;
+        MeshletCuller _meshletCuller;
+        FrustumCuller _frustumCuller;
+        SceneBvh _sceneBvh;
+        DepthPyramid _depthPyramid;
+        IndirectScene _indirectScene;
+        DrawList _drawList;
+        // last model clicked in the viewport, its editor node is opened once
+        std::string _pickedModel;
+        // model whose Remove button was clicked, removed by draw after the fence wait
+        std::string _removedModel;
+        bool _pickOpened = true;
+        // detail levels picked for the frame being recorded
+        LodStats _lodStats;
+        // cpu time of the last frame's draw recording in microseconds
+        double _drawRecordTime = 0.0;
+        uint32_t _recordedDraws = 0;
         FrameData _frames[FRAME_OVERLAP];
 
         void init_vulkan();
@@ -78,10 +98,20 @@ namespace VkRenderer {
 
         void update_ui();
 
-        void draw_objects(VkCommandBuffer cmd);
+        // select the model under a window position
+        void pick(int x, int y);
+
+        // late only draws the meshlets the occlusion pass let through
+        void draw_objects(VkCommandBuffer cmd, bool late);
 
         void draw();
 
         FrameData &get_current_frame();
+
+        // textured material matching the selected vertex format
+        Material *get_model_material();
+
+        // MODEL_OPTION flags matching the selected import settings
+        uint32_t get_import_options();
     };
 }
\ No newline at end of file
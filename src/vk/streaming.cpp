@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <cmath>
+#include <vk/check.h>
+#include <vk/upload.h>
+#include <vk/texture.h>
+
+#include "streaming.h"
+
+namespace VkRenderer {
+    void TextureStreamer::init(ResourceHandles *resources) {
+        _resources = resources;
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    void TextureStreamer::register_texture(Texture *texture) {
+        if (_textureIndices.count(texture)) return;
+
+        StreamingTexture streaming;
+        streaming.texture = texture;
+        streaming.initialBase = initial_base(*texture->source);
+        streaming.targetBase = texture->residentBase;
+        _textureIndices[texture] = _textures.size();
+        _textures.push_back(streaming);
+    }
+
+    void TextureStreamer::unregister_texture(Texture *texture) {
+        auto it = _textureIndices.find(texture);
+        if (it == _textureIndices.end()) return;
+
+        size_t index = it->second;
+        if (_textures[index].pending) {
+            _resources->uploader->wait(_textures[index].ticket);
+            destroy_pending(_textures[index]);
+        }
+
+        // swap with the last entry to keep the array dense
+        _textureIndices.erase(it);
+        if (index + 1 < _textures.size()) {
+            _textures[index] = _textures.back();
+            _textureIndices[_textures[index].texture] = index;
+        }
+        _textures.pop_back();
+    }
+
+    void TextureStreamer::request(Texture *texture, float screenSize) {
+        auto it = _textureIndices.find(texture);
+        if (it == _textureIndices.end()) return;
+
+        StreamingTexture &streaming = _textures[it->second];
+        streaming.screenSize = std::max(streaming.screenSize, screenSize);
+    }
+
+    void TextureStreamer::update(DeletionQueue &frameDeletion) {
+        // swap in images whose uploads have completed
+        for (auto &streaming: _textures) {
+            if (streaming.pending && _resources->uploader->is_complete(streaming.ticket)) {
+                finish_upload(streaming, frameDeletion);
+            }
+        }
+
+        assign_targets();
+
+        // evictions first, they only ever upload the small levels that stay resident
+        bool submitted = false;
+        for (auto &streaming: _textures) {
+            if (!streaming.pending && streaming.targetBase > streaming.texture->residentBase) {
+                start_upload(streaming, streaming.targetBase);
+                submitted = true;
+            }
+        }
+
+        // promote the most visible textures one level at a time so no frame uploads a whole chain
+        std::vector<StreamingTexture *> promotions;
+        for (auto &streaming: _textures) {
+            if (!streaming.pending && streaming.targetBase < streaming.texture->residentBase) {
+                promotions.push_back(&streaming);
+            }
+        }
+        std::sort(promotions.begin(), promotions.end(), [](const StreamingTexture *a, const StreamingTexture *b) {
+            return a->screenSize > b->screenSize;
+        });
+
+        VkDeviceSize uploadBytes = 0;
+        for (StreamingTexture *streaming: promotions) {
+            uint32_t baseLevel = streaming->texture->residentBase - 1;
+            VkDeviceSize size = resident_size(*streaming->texture->source, baseLevel);
+            if (uploadBytes > 0 && uploadBytes + size > STREAMING_UPLOAD_BYTES_PER_FRAME) break;
+            start_upload(*streaming, baseLevel);
+            uploadBytes += size;
+            submitted = true;
+        }
+
+        if (submitted) {
+            uint64_t ticket = _resources->uploader->submit();
+            for (auto &streaming: _textures) {
+                if (streaming.pending && streaming.ticket == 0) {
+                    streaming.ticket = ticket;
+                }
+            }
+        }
+
+        // stats, requests start over next frame
+        _stats = {};
+        _stats.budgetBytes = static_cast<VkDeviceSize>(_resources->settings.textureBudgetMB) * 1024 * 1024;
+        _stats.textureCount = _textures.size();
+        for (auto &streaming: _textures) {
+            _stats.residentBytes += resident_size(*streaming.texture->source, streaming.texture->residentBase);
+            if (streaming.pending) {
+                _stats.residentBytes += resident_size(*streaming.texture->source, streaming.pendingBase);
+                _stats.uploadsInFlight++;
+            }
+            if (streaming.texture->residentBase == 0) _stats.fullyResident++;
+            streaming.screenSize = 0.0f;
+        }
+    }
+
+    StreamingStats TextureStreamer::stats() const {
+        return _stats;
+    }
+
+    uint32_t TextureStreamer::initial_base(const DecodedTexture &source) {
+        uint32_t baseLevel = 0;
+        while (baseLevel + 1 < source.levels.size() && std::max(source.width >> baseLevel, source.height >> baseLevel) > STREAMING_INITIAL_SIZE) {
+            baseLevel++;
+        }
+        return baseLevel;
+    }
+
+    uint32_t TextureStreamer::desired_base(const StreamingTexture &streaming) const {
+        if (streaming.screenSize <= 0.0f) return streaming.initialBase;
+
+        // one texel per pixel, assuming the texture spans the mesh once
+        const DecodedTexture &source = *streaming.texture->source;
+        float texels = static_cast<float>(std::max(source.width, source.height));
+        float level = std::floor(std::log2(texels / streaming.screenSize) + _resources->settings.lodBias);
+        return static_cast<uint32_t>(std::clamp(level, 0.0f, static_cast<float>(streaming.initialBase)));
+    }
+
+    void TextureStreamer::assign_targets() {
+        // the initial levels are always resident, the rest of the budget goes to the largest on screen
+        VkDeviceSize budget = static_cast<VkDeviceSize>(_resources->settings.textureBudgetMB) * 1024 * 1024;
+        VkDeviceSize used = 0;
+        std::vector<StreamingTexture *> order;
+        for (auto &streaming: _textures) {
+            used += resident_size(*streaming.texture->source, streaming.initialBase);
+            order.push_back(&streaming);
+        }
+        std::sort(order.begin(), order.end(), [](const StreamingTexture *a, const StreamingTexture *b) {
+            return a->screenSize > b->screenSize;
+        });
+
+        for (StreamingTexture *streaming: order) {
+            const DecodedTexture &source = *streaming->texture->source;
+            VkDeviceSize minimum = resident_size(source, streaming->initialBase);
+            uint32_t targetBase = desired_base(*streaming);
+            while (targetBase < streaming->initialBase && used - minimum + resident_size(source, targetBase) > budget) {
+                targetBase++;
+            }
+            used += resident_size(source, targetBase) - minimum;
+            streaming->targetBase = targetBase;
+        }
+    }
+
+    void TextureStreamer::start_upload(StreamingTexture &streaming, uint32_t baseLevel) {
+        TextureManager::create_image(_resources, _resources->uploader, *streaming.texture->source, baseLevel, streaming.pendingImage, streaming.pendingView);
+        streaming.pending = true;
+        streaming.ticket = 0;
+        streaming.pendingBase = baseLevel;
+    }
+
+    void TextureStreamer::finish_upload(StreamingTexture &streaming, DeletionQueue &frameDeletion) {
+        Texture *texture = streaming.texture;
+
+        // frames still in flight read the old set, so write the new image into a different one
+        VkDescriptorSet descriptor = _resources->textureManager->allocate_descriptor();
+        if (descriptor == VK_NULL_HANDLE) {
+            // keep the current image, the upload is retried next frame
+            destroy_pending(streaming);
+            return;
+        }
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.sampler = texture->sampler;
+        imageInfo.imageView = streaming.pendingView;
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        VkWriteDescriptorSet write = VkRenderer::descriptor::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, descriptor, &imageInfo, 0);
+        vkUpdateDescriptorSets(_resources->device, 1, &write, 0, nullptr);
+
+        // retire the old image once this frame's fence comes around again
+        AllocatedImage oldImage = texture->image;
+        VkImageView oldView = texture->imageView;
+        VkDescriptorSet oldDescriptor = texture->descriptor;
+        frameDeletion.push_function([=]() {
+            vkDestroyImageView(_resources->device, oldView, nullptr);
+            vmaDestroyImage(_resources->allocator, oldImage._image, oldImage._allocation);
+            _resources->textureManager->free_descriptor(oldDescriptor);
+        });
+
+        texture->image = streaming.pendingImage;
+        texture->imageView = streaming.pendingView;
+        texture->descriptor = descriptor;
+        texture->residentBase = streaming.pendingBase;
+        // the slot's other frame copy still points at the old image until its frame comes around, which is before the image is retired
+        _resources->textureTable->update(texture->tableSlot, streaming.pendingView);
+        streaming.pending = false;
+    }
+
+    void TextureStreamer::destroy_pending(StreamingTexture &streaming) {
+        vkDestroyImageView(_resources->device, streaming.pendingView, nullptr);
+        vmaDestroyImage(_resources->allocator, streaming.pendingImage._image, streaming.pendingImage._allocation);
+        streaming.pending = false;
+    }
+
+    void TextureStreamer::cleanup() {
+        for (auto &streaming: _textures) {
+            if (streaming.pending) {
+                destroy_pending(streaming);
+            }
+        }
+        _textures.clear();
+        _textureIndices.clear();
+    }
+
+    VkDeviceSize TextureStreamer::resident_size(const DecodedTexture &source, uint32_t baseLevel) {
+        VkDeviceSize size = 0;
+        for (uint32_t i = baseLevel; i < source.levels.size(); i++) {
+            size += source.levels[i].byteLength;
+        }
+        return size;
+    }
+}
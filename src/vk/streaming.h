@@ -0,0 +1,78 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <vk/types.h>
+#include <vk/texture.h>
+
+namespace VkRenderer {
+    // textures start with mips up to this size resident, larger levels are streamed in on demand
+    constexpr uint32_t STREAMING_INITIAL_SIZE = 128;
+    // upload bytes started per frame, at least one level always goes through
+    constexpr VkDeviceSize STREAMING_UPLOAD_BYTES_PER_FRAME = 16 * 1024 * 1024;
+
+    struct StreamingStats {
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize budgetBytes = 0;
+        size_t textureCount = 0;
+        size_t fullyResident = 0;
+        size_t uploadsInFlight = 0;
+    };
+
+    // keeps a subset of each texture's mip chain resident, rebuilding images at a new base level as demand changes
+    class TextureStreamer {
+    public:
+        void init(ResourceHandles *resources);
+
+        void register_texture(Texture *texture);
+
+        // stop streaming a texture that is about to be destroyed, waits for its upload if one is in flight
+        void unregister_texture(Texture *texture);
+
+        // report that texture covers screenSize pixels this frame, the largest request wins
+        void request(Texture *texture, float screenSize);
+
+        // finish swaps whose uploads have landed and start new ones within the budget
+        // replaced images and descriptor sets are retired through frameDeletion
+        void update(DeletionQueue &frameDeletion);
+
+        [[nodiscard]] StreamingStats stats() const;
+
+        // first level whose size is within STREAMING_INITIAL_SIZE
+        static uint32_t initial_base(const DecodedTexture &source);
+
+    private:
+        struct StreamingTexture {
+            Texture *texture;
+            uint32_t initialBase;
+            uint32_t targetBase;
+            float screenSize = 0.0f;
+
+            // replacement image being uploaded
+            bool pending = false;
+            uint64_t ticket;
+            uint32_t pendingBase;
+            AllocatedImage pendingImage;
+            VkImageView pendingView;
+        };
+
+        ResourceHandles *_resources;
+        std::vector<StreamingTexture> _textures;
+        std::unordered_map<Texture *, size_t> _textureIndices;
+        StreamingStats _stats;
+
+        [[nodiscard]] uint32_t desired_base(const StreamingTexture &streaming) const;
+
+        void assign_targets();
+
+        void start_upload(StreamingTexture &streaming, uint32_t baseLevel);
+
+        void finish_upload(StreamingTexture &streaming, DeletionQueue &frameDeletion);
+
+        void destroy_pending(StreamingTexture &streaming);
+
+        void cleanup();
+
+        static VkDeviceSize resident_size(const DecodedTexture &source, uint32_t baseLevel);
+    };
+}
@@ -1,137 +1,410 @@
-#include <iostream>
-#include <stb_image.h>
-#include <vk/utils.h>
-#include <vk/info.h>
-#include <vk/types.h>
-
-#include "texture.h"
-
-namespace VkRenderer {
-    void TextureManager::init(ResourceHandles *resources) {
-        _resources = resources;
-        _descriptorAllocator = new VkRenderer::descriptor::Allocator{};
-        _descriptorAllocator->init(_resources->device);
-        _defaultTexture = create_texture("../assets/devtex/dev_grid.png", "texture_diffuse");
-    }
-
-    Texture *TextureManager::create_texture(const std::string &filePath, const std::string &typeName) {
-        int texWidth, texHeight, texChannels;
-
-        stbi_uc *pixels = stbi_load(filePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        if (!pixels) {
-            std::cout << "Failed to load texture " << filePath << ", substituting for default" << std::endl;
-            return _defaultTexture;
-        }
-
-        // create a staging buffer for texture data
-        void *pixelPtr = pixels;
-        VkDeviceSize imageSize = texWidth * texHeight * 4;
-        VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
-        AllocatedBuffer stagingBuffer = VkRenderer::utils::create_buffer(_resources->allocator, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-        // copy
-        void *data;
-        vmaMapMemory(_resources->allocator, stagingBuffer._allocation, &data);
-        memcpy(data, pixelPtr, static_cast<size_t>(imageSize));
-        vmaUnmapMemory(_resources->allocator, stagingBuffer._allocation);
-        stbi_image_free(pixels);
-
-        // create the vk texture
-        Texture newTexture;
-        VkExtent3D imageExtent;
-        imageExtent.width = static_cast<uint32_t>(texWidth);
-        imageExtent.height = static_cast<uint32_t>(texHeight);
-        imageExtent.depth = 1;
-
-        // allocate image
-        VkImageCreateInfo imageInfo = VkRenderer::info::image_create_info(imageFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
-        VmaAllocationCreateInfo allocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_GPU_ONLY, 0);
-        vmaCreateImage(_resources->allocator, &imageInfo, &allocInfo, &newTexture.image._image, &newTexture.image._allocation, nullptr);
-
-        // transfer from staging to texture
-        VkRenderer::utils::immediate_submit(_resources, [=](VkCommandBuffer cmd) {
-            VkImageSubresourceRange range;
-            range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            range.baseMipLevel = 0;
-            range.levelCount = 1;
-            range.baseArrayLayer = 0;
-            range.layerCount = 1;
-
-            VkImageMemoryBarrier imageBarrierTransfer = {};
-            imageBarrierTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            imageBarrierTransfer.pNext = nullptr;
-            imageBarrierTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageBarrierTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            imageBarrierTransfer.image = newTexture.image._image;
-            imageBarrierTransfer.subresourceRange = range;
-            imageBarrierTransfer.srcAccessMask = 0;
-            imageBarrierTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrierTransfer);
-
-            VkBufferImageCopy copyRegion = {};
-            copyRegion.bufferOffset = 0;
-            copyRegion.bufferRowLength = 0;
-            copyRegion.bufferImageHeight = 0;
-            copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            copyRegion.imageSubresource.mipLevel = 0;
-            copyRegion.imageSubresource.baseArrayLayer = 0;
-            copyRegion.imageSubresource.layerCount = 1;
-            copyRegion.imageExtent = imageExtent;
-
-            vkCmdCopyBufferToImage(cmd, stagingBuffer._buffer, newTexture.image._image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-            VkImageMemoryBarrier imageBarrierReadable = imageBarrierTransfer;
-            imageBarrierReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            imageBarrierReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageBarrierReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            imageBarrierReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrierReadable);
-        });
-
-        _resources->mainDeletionQueue.push_function([=]() {
-            vmaDestroyImage(_resources->allocator, newTexture.image._image, newTexture.image._allocation);
-        });
-        vmaDestroyBuffer(_resources->allocator, stagingBuffer._buffer, stagingBuffer._allocation);
-
-        VkImageViewCreateInfo imageViewInfo = VkRenderer::info::imageview_create_info(VK_FORMAT_R8G8B8A8_SRGB, newTexture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
-        vkCreateImageView(_resources->device, &imageViewInfo, nullptr, &newTexture.imageView);
-        _resources->mainDeletionQueue.push_function([=]() {
-            vkDestroyImageView(_resources->device, newTexture.imageView, nullptr);
-        });
-
-        // create sampler
-        VkSamplerCreateInfo samplerInfo = VkRenderer::info::sampler_create_info(VK_FILTER_LINEAR);
-        VkSampler sampler;
-        vkCreateSampler(_resources->device, &samplerInfo, nullptr, &sampler);
-
-        // write to descriptor set
-        VkDescriptorImageInfo descriptorImageInfo = {};
-        descriptorImageInfo.sampler = sampler;
-        descriptorImageInfo.imageView = newTexture.imageView;
-        descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        VkDescriptorSet newDescriptor;
-        VkRenderer::descriptor::Builder::begin(_resources->descriptorLayoutCache, _descriptorAllocator)
-                .bind_image(0, &descriptorImageInfo, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-                .build(newDescriptor);
-
-        newTexture.descriptor = newDescriptor;
-        newTexture.type = typeName;
-        // just use file path as texture name for now
-        _textures[filePath] = newTexture;
-
-        std::cout << "Loaded texture " << filePath << std::endl;
-        return &_textures[filePath];
-    }
-
-    Texture *TextureManager::get_texture(const std::string &name) {
-        if (_textures.find(name) == _textures.end()) {
-            // does not exist
-            return nullptr;
-        } else {
-            return &_textures[name];
-        }
-    }
-}
\ No newline at end of file
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <stb_image.h>
+#include <vk/info.h>
+#include <vk/ktx.h>
+#include <vk/mipmap.h>
+#include <vk/types.h>
+#include <vk/check.h>
+#include <vk/streaming.h>
+#include <vk/utils.h>
+#include <cstring>
+#include <fstream>
+
+#include "texture.h"
+
+namespace VkRenderer {
+    static std::vector<ImageLevel> source_levels(const DecodedTexture &source, uint32_t baseLevel) {
+        std::vector<ImageLevel> levels;
+        for (uint32_t i = baseLevel; i < source.levels.size(); i++) {
+            VkExtent3D extent = {std::max(source.width >> i, 1u), std::max(source.height >> i, 1u), 1};
+            levels.push_back({source.data.data() + source.levels[i].byteOffset, source.levels[i].byteLength, extent});
+        }
+        return levels;
+    }
+
+    static void decode_texture(const std::string &filePath, const std::vector<uint8_t> &fileData, bool allowCooked, DecodedTexture &decoded) {
+        // prefer the cooked file, it needs no decode or mip generation
+        VkRenderer::ktx::Texture cooked;
+        if (allowCooked && VkRenderer::ktx::load(filePath, cooked)) {
+            decoded.format = cooked.format;
+            decoded.width = cooked.width;
+            decoded.height = cooked.height;
+            decoded.data = std::move(cooked.data);
+            decoded.levels = std::move(cooked.levels);
+            return;
+        }
+
+        int width, height, texChannels;
+        stbi_uc *pixels = stbi_load_from_memory(fileData.data(), static_cast<int>(fileData.size()), &width, &height, &texChannels, STBI_rgb_alpha);
+        if (!pixels) return;
+
+        // base level followed by the generated chain
+        std::vector<uint8_t> mipChain;
+        VkRenderer::mipmap::generate_chain(pixels, width, height, mipChain);
+        size_t baseSize = static_cast<size_t>(width) * height * 4;
+        decoded.format = VK_FORMAT_R8G8B8A8_SRGB;
+        decoded.width = static_cast<uint32_t>(width);
+        decoded.height = static_cast<uint32_t>(height);
+        decoded.data.resize(baseSize + mipChain.size());
+        memcpy(decoded.data.data(), pixels, baseSize);
+        memcpy(decoded.data.data() + baseSize, mipChain.data(), mipChain.size());
+        stbi_image_free(pixels);
+
+        uint64_t offset = 0;
+        uint32_t levelCount = VkRenderer::mipmap::level_count(decoded.width, decoded.height);
+        for (uint32_t i = 0; i < levelCount; i++) {
+            uint64_t size = static_cast<uint64_t>(std::max(decoded.width >> i, 1u)) * std::max(decoded.height >> i, 1u) * 4;
+            decoded.levels.push_back({offset, size, size});
+            offset += size;
+        }
+    }
+
+    void TextureManager::init(ResourceHandles *resources) {
+        _resources = resources;
+        _defaultTexture = nullptr;
+        _descriptorAllocator = new VkRenderer::descriptor::Allocator{};
+        _descriptorAllocator->init(_resources->device);
+
+        // default texture is the fallback for failed decodes, so it must be resident first
+        _defaultTexture = create_texture("../assets/devtex/dev_grid.png", "texture_diffuse", _resources->uploader);
+        flush_uploads(_resources->uploader);
+        _resources->uploader->flush();
+    }
+
+    Texture *TextureManager::create_texture(const std::string &filePath, const std::string &typeName, UploadBatcher *uploader) {
+        {
+            // paths seen before skip reading the file
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            auto path = _pathHashes.find(filePath);
+            if (path != _pathHashes.end()) {
+                auto entry = _entries.find(path->second);
+                if (entry != _entries.end()) {
+                    reference(path->second, entry->second, uploader);
+                    return &entry->second.texture;
+                }
+            }
+        }
+
+        // hash the file contents, the bytes are then decoded without reading the file again
+        auto fileData = std::make_shared<std::vector<uint8_t>>();
+        std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+        if (file.is_open()) {
+            fileData->resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(fileData->data()), static_cast<std::streamsize>(fileData->size()));
+        }
+        if (!file.is_open() || !file.good()) {
+            std::cout << "Failed to read texture " << filePath << ", substituting for default" << std::endl;
+            return _defaultTexture;
+        }
+        uint64_t contentHash = VkRenderer::utils::hash_bytes(fileData->data(), fileData->size());
+
+        {
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            _pathHashes[filePath] = contentHash;
+            auto [it, inserted] = _entries.try_emplace(contentHash);
+            CacheEntry &entry = it->second;
+            if (!inserted) {
+                // same image under another path
+                reference(contentHash, entry, uploader);
+                return &entry.texture;
+            }
+
+            // reserve the entry now so meshes can hold on to it while the decode runs
+            entry.refCount++;
+            entry.contentHash = contentHash;
+            entry.uploader = uploader;
+            entry.texture.type = typeName;
+            _entryHashes[&entry.texture] = contentHash;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_decodeMutex);
+            _pendingDecodes[uploader]++;
+        }
+
+        _resources->threadPool->submit([this, filePath, fileData, contentHash, uploader]() {
+            DecodeResult result;
+            result.contentHash = contentHash;
+            result.uploader = uploader;
+            result.decoded.filePath = filePath;
+            decode_texture(filePath, *fileData, _resources->textureCompressionBC, result.decoded);
+
+            // hand the pixels back to the uploading thread
+            {
+                std::lock_guard<std::mutex> lock(_decodeMutex);
+                _decoded.push_back(std::move(result));
+            }
+            _decodeCondition.notify_all();
+        });
+
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        return &_entries[contentHash].texture;
+    }
+
+    void TextureManager::release(Texture *texture) {
+        // the default texture lives until cleanup
+        if (texture == _defaultTexture) return;
+
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        auto hash = _entryHashes.find(texture);
+        if (hash == _entryHashes.end()) return;
+
+        CacheEntry &entry = _entries[hash->second];
+        if (--entry.refCount > 0) return;
+
+        if (entry.ownsResources) {
+            _resources->textureStreamer->unregister_texture(texture);
+        }
+        destroy_entry(entry);
+        uint64_t contentHash = entry.contentHash;
+        for (auto it = _pathHashes.begin(); it != _pathHashes.end();) {
+            it = it->second == contentHash ? _pathHashes.erase(it) : std::next(it);
+        }
+        _entryHashes.erase(hash);
+        _entries.erase(contentHash);
+    }
+
+    void TextureManager::flush_uploads(UploadBatcher *uploader) {
+        while (true) {
+            DecodeResult result;
+            {
+                // wait for the next decode queued for this uploader, in completion order
+                std::unique_lock<std::mutex> lock(_decodeMutex);
+                if (_pendingDecodes[uploader] == 0) break;
+                auto isOurs = [uploader](const DecodeResult &decodeResult) { return decodeResult.uploader == uploader; };
+                _decodeCondition.wait(lock, [&]() { return std::find_if(_decoded.begin(), _decoded.end(), isOurs) != _decoded.end(); });
+                auto it = std::find_if(_decoded.begin(), _decoded.end(), isOurs);
+                result = std::move(*it);
+                _decoded.erase(it);
+                _pendingDecodes[uploader]--;
+            }
+
+            // the requester holds a reference, so the entry stays put while it is filled in
+            CacheEntry *entry;
+            Texture texture;
+            {
+                std::lock_guard<std::mutex> lock(_cacheMutex);
+                entry = &_entries[result.contentHash];
+                texture = entry->texture;
+            }
+
+            DecodedTexture &decoded = result.decoded;
+            if (decoded.levels.empty()) {
+                std::cout << "Failed to load texture " << decoded.filePath << ", substituting for default" << std::endl;
+                std::lock_guard<std::mutex> lock(_cacheMutex);
+                entry->texture = *_defaultTexture;
+                entry->texture.type = texture.type;
+                entry->texture.source = nullptr;
+                entry->state = EntryState::Ready;
+                _readyCondition.notify_all();
+                continue;
+            }
+
+            // start with the low mips, the streamer brings in the rest once the texture is seen up close
+            std::string filePath = decoded.filePath;
+            uint32_t baseLevel = &entry->texture == _defaultTexture ? 0 : TextureStreamer::initial_base(decoded);
+            texture = upload_texture(texture, baseLevel, uploader, std::make_shared<DecodedTexture>(std::move(decoded)));
+            {
+                std::lock_guard<std::mutex> lock(_cacheMutex);
+                entry->texture = texture;
+                entry->ownsResources = true;
+                // the render thread submits its own batch before it publishes anything, so only other queues' uploads wait
+                if (uploader == _resources->uploader) {
+                    entry->state = EntryState::Ready;
+                } else {
+                    entry->state = EntryState::Uploaded;
+                    _unsubmitted[uploader].push_back(result.contentHash);
+                }
+            }
+            _readyCondition.notify_all();
+            std::cout << "Loaded texture " << filePath << std::endl;
+        }
+
+        // textures other batchers were still loading, completion on another queue isn't signalled so it is polled
+        std::unique_lock<std::mutex> lock(_cacheMutex);
+        std::vector<uint64_t> &referenced = _referenced[uploader];
+        for (uint64_t contentHash: referenced) {
+            while (!ready_for(contentHash, uploader)) {
+                _readyCondition.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+        referenced.clear();
+    }
+
+    void TextureManager::submitted(UploadBatcher *uploader, uint64_t ticket, std::vector<VkImageMemoryBarrier> &imageAcquires) {
+        {
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            std::vector<uint64_t> &unsubmitted = _unsubmitted[uploader];
+            for (uint64_t contentHash: unsubmitted) {
+                auto it = _entries.find(contentHash);
+                if (it == _entries.end() || it->second.uploader != uploader || it->second.state != EntryState::Uploaded) continue;
+
+                CacheEntry &entry = it->second;
+                entry.state = EntryState::Submitted;
+                entry.uploadTicket = ticket;
+                auto acquire = std::find_if(imageAcquires.begin(), imageAcquires.end(), [&](const VkImageMemoryBarrier &barrier) {
+                    return barrier.image == entry.texture.image._image;
+                });
+                if (acquire != imageAcquires.end()) {
+                    entry.acquire = *acquire;
+                    entry.needsAcquire = true;
+                    imageAcquires.erase(acquire);
+                }
+                _submitted[uploader].push_back(contentHash);
+            }
+            unsubmitted.clear();
+        }
+        _readyCondition.notify_all();
+    }
+
+    void TextureManager::acquire(VkCommandBuffer cmd, UploadBatcher *uploader) {
+        std::vector<VkImageMemoryBarrier> barriers;
+        {
+            std::lock_guard<std::mutex> lock(_cacheMutex);
+            std::vector<uint64_t> &submitted = _submitted[uploader];
+            for (auto it = submitted.begin(); it != submitted.end();) {
+                auto entry = _entries.find(*it);
+                // released, or already acquired by a flush on the render thread
+                if (entry == _entries.end() || entry->second.uploader != uploader || entry->second.state != EntryState::Submitted) {
+                    it = submitted.erase(it);
+                    continue;
+                }
+                if (!uploader->is_complete(entry->second.uploadTicket)) {
+                    it++;
+                    continue;
+                }
+                if (entry->second.needsAcquire) {
+                    barriers.push_back(entry->second.acquire);
+                }
+                entry->second.state = EntryState::Ready;
+                it = submitted.erase(it);
+            }
+        }
+        _readyCondition.notify_all();
+
+        if (barriers.empty()) return;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data());
+    }
+
+    void TextureManager::reference(uint64_t contentHash, CacheEntry &entry, UploadBatcher *caller) {
+        entry.refCount++;
+        // the caller's own batch orders its uploads, anything else is waited for in flush_uploads
+        if (entry.uploader != caller && entry.state != EntryState::Ready) {
+            _referenced[caller].push_back(contentHash);
+        }
+    }
+
+    bool TextureManager::ready_for(uint64_t contentHash, UploadBatcher *caller) {
+        auto it = _entries.find(contentHash);
+        if (it == _entries.end()) return true;
+
+        CacheEntry &entry = it->second;
+        if (entry.state == EntryState::Ready) return true;
+        if (entry.state != EntryState::Submitted || !entry.uploader->is_complete(entry.uploadTicket)) return false;
+
+        // the other queue is done with the image, the caller's batch takes ownership before anything it publishes
+        // only the render thread's batcher shares entries with another queue, so the caller is on the graphics queue
+        if (entry.needsAcquire) {
+            caller->acquire_image(entry.acquire);
+        }
+        entry.state = EntryState::Ready;
+        return true;
+    }
+
+    Texture TextureManager::upload_texture(Texture texture, uint32_t baseLevel, UploadBatcher *uploader, std::shared_ptr<DecodedTexture> decoded) {
+        Texture newTexture = texture;
+        create_image(_resources, uploader, *decoded, baseLevel, newTexture.image, newTexture.imageView);
+        newTexture.source = std::move(decoded);
+        newTexture.residentBase = baseLevel;
+
+        // shared sampler from the cache, also baked into the texture set layout
+        newTexture.sampler = _resources->textureSampler;
+
+        // write to descriptor set
+        VkDescriptorImageInfo descriptorImageInfo = {};
+        descriptorImageInfo.sampler = newTexture.sampler;
+        descriptorImageInfo.imageView = newTexture.imageView;
+        descriptorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        newTexture.descriptor = allocate_descriptor();
+        VkWriteDescriptorSet write = VkRenderer::descriptor::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, newTexture.descriptor, &descriptorImageInfo, 0);
+        vkUpdateDescriptorSets(_resources->device, 1, &write, 0, nullptr);
+        newTexture.tableSlot = _resources->textureTable->add(newTexture.imageView);
+        return newTexture;
+    }
+
+    void TextureManager::destroy_entry(CacheEntry &entry) {
+        if (!entry.ownsResources) return;
+
+        Texture &texture = entry.texture;
+        vkDestroyImageView(_resources->device, texture.imageView, nullptr);
+        vmaDestroyImage(_resources->allocator, texture.image._image, texture.image._allocation);
+        free_descriptor(texture.descriptor);
+        _resources->textureTable->remove(texture.tableSlot);
+        entry.ownsResources = false;
+    }
+
+    void TextureManager::create_image(ResourceHandles *resources, UploadBatcher *uploader, const DecodedTexture &source, uint32_t baseLevel,
+                                      AllocatedImage &image, VkImageView &imageView) {
+        std::vector<ImageLevel> levels = source_levels(source, baseLevel);
+        VkExtent3D imageExtent = levels[0].extent;
+        auto mipLevels = static_cast<uint32_t>(levels.size());
+
+        // allocate image
+        VkImageCreateInfo imageInfo = VkRenderer::info::image_create_info(source.format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, mipLevels);
+        VmaAllocationCreateInfo allocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_GPU_ONLY, 0);
+        VK_CHECK(vmaCreateImage(resources->allocator, &imageInfo, &allocInfo, &image._image, &image._allocation, nullptr));
+        uploader->upload_image(image._image, source.format, levels);
+
+        VkImageViewCreateInfo imageViewInfo = VkRenderer::info::imageview_create_info(source.format, image._image, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+        if (source.format == VK_FORMAT_BC4_UNORM_BLOCK) {
+            // single channel data reads as grey
+            imageViewInfo.components = {VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE};
+        }
+        VK_CHECK(vkCreateImageView(resources->device, &imageViewInfo, nullptr, &imageView));
+    }
+
+    Texture *TextureManager::get_default_texture() {
+        return _defaultTexture;
+    }
+
+    VkDescriptorSet TextureManager::allocate_descriptor() {
+        std::lock_guard<std::mutex> lock(_descriptorMutex);
+        VkDescriptorSet descriptor = VK_NULL_HANDLE;
+        if (!_freeDescriptors.empty()) {
+            descriptor = _freeDescriptors.back();
+            _freeDescriptors.pop_back();
+        } else if (!_descriptorAllocator->allocate(&descriptor, _resources->textureSetLayout)) {
+            std::cout << "Failed to allocate a texture descriptor set" << std::endl;
+        }
+        return descriptor;
+    }
+
+    void TextureManager::free_descriptor(VkDescriptorSet descriptor) {
+        std::lock_guard<std::mutex> lock(_descriptorMutex);
+        _freeDescriptors.push_back(descriptor);
+    }
+
+    size_t TextureManager::texture_count() {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        return _entries.size();
+    }
+
+    void TextureManager::cleanup() {
+        std::lock_guard<std::mutex> lock(_cacheMutex);
+        for (auto &it: _entries) {
+            destroy_entry(it.second);
+        }
+        _entries.clear();
+        _entryHashes.clear();
+        _pathHashes.clear();
+        _referenced.clear();
+        _unsubmitted.clear();
+        _submitted.clear();
+        _descriptorAllocator->cleanup();
+    }
+}
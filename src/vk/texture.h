@@ -1,29 +1,143 @@
-#pragma once
-
-#include <unordered_map>
-#include <string>
-#include <vk/types.h>
-
-namespace VkRenderer {
-    struct Texture {
-        AllocatedImage image;
-        VkImageView imageView;
-        VkDescriptorSet descriptor;
-        std::string type;
-    };
-
-    class TextureManager {
-    public:
-        void init(ResourceHandles *resources);
-
-        Texture *create_texture(const std::string &filePath, const std::string &typeName);
-
-        Texture *get_texture(const std::string &name);
-
-    private:
-        ResourceHandles *_resources;
-        Texture *_defaultTexture;
-        std::unordered_map<std::string, Texture> _textures;
-        VkRenderer::descriptor::Allocator *_descriptorAllocator;
-    };
-}
\ No newline at end of file
+#pragma once
+
+#include <unordered_map>
+#include <string>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vk/types.h>
+#include <vk/upload.h>
+#include <vk/ktx.h>
+#include <vk/texture_table.h>
+
+namespace VkRenderer {
+    // every mip level of a texture in CPU memory, either decoded with generated mips or a cooked file
+    struct DecodedTexture {
+        std::string filePath;
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> data;
+        std::vector<VkRenderer::ktx::LevelIndex> levels; // into data, level 0 first, empty if loading failed
+    };
+
+    struct Texture {
+        AllocatedImage image;
+        VkImageView imageView;
+        VkDescriptorSet descriptor;
+        VkSampler sampler;
+        std::string type;
+        // kept around so the streamer can rebuild the image at another resolution
+        std::shared_ptr<DecodedTexture> source;
+        // the image holds source levels [residentBase, levelCount)
+        uint32_t residentBase = 0;
+        // index into the TextureTable, unchanged when the streamer replaces the image
+        uint32_t tableSlot = TEXTURE_TABLE_DEFAULT;
+    };
+
+    // one cache for the whole process, textures are keyed by a hash of the file contents so copies
+    // of an image under different paths share a single upload
+    class TextureManager {
+    public:
+        void init(ResourceHandles *resources);
+
+        // returns a referenced texture, queuing a decode on the thread pool if the contents are new
+        // the texture is usable after flush_uploads with the same uploader, once the batch is submitted
+        // a cooked .ktx2 next to the source is used in preference to decoding it
+        Texture *create_texture(const std::string &filePath, const std::string &typeName, UploadBatcher *uploader);
+
+        // drop a reference, the GPU must be done with the texture if this was the last one
+        void release(Texture *texture);
+
+        // upload decoded textures as they complete, returns once all decodes queued for uploader are uploaded
+        // and every texture uploader got from another batcher is ready, acquires owed by those are added to uploader's batch
+        void flush_uploads(UploadBatcher *uploader);
+
+        // uploader's batch holding its flushed textures went out as ticket, their acquire barriers are taken out of imageAcquires
+        void submitted(UploadBatcher *uploader, uint64_t ticket, std::vector<VkImageMemoryBarrier> &imageAcquires);
+
+        // on the render thread, acquire the textures of uploader's completed batches into cmd, they are ready from then on
+        void acquire(VkCommandBuffer cmd, UploadBatcher *uploader);
+
+        Texture *get_default_texture();
+
+        // texture sets for every texture come from one pool, released sets are reused
+        VkDescriptorSet allocate_descriptor();
+
+        void free_descriptor(VkDescriptorSet descriptor);
+
+        [[nodiscard]] size_t texture_count();
+
+        void cleanup();
+
+        // image and view for source levels [baseLevel, levelCount), data goes through uploader
+        static void create_image(ResourceHandles *resources, UploadBatcher *uploader, const DecodedTexture &source, uint32_t baseLevel,
+                                 AllocatedImage &image, VkImageView &imageView);
+
+    private:
+        enum class EntryState {
+            Decoding,  // texture fields not written yet
+            Uploaded,  // recorded into the uploader's current batch
+            Submitted, // batch submitted, the image may still belong to the uploader's queue family
+            Ready      // anything the render thread publishes can use it
+        };
+
+        struct CacheEntry {
+            Texture texture;
+            uint64_t contentHash;
+            uint32_t refCount = 0;
+            // false while decoding and for failed loads, which borrow the default texture's handles
+            bool ownsResources = false;
+            UploadBatcher *uploader = nullptr;
+            EntryState state = EntryState::Decoding;
+            uint64_t uploadTicket = 0;
+            // acquire half of the upload's queue family transfer, recorded once on the graphics queue
+            VkImageMemoryBarrier acquire{};
+            bool needsAcquire = false;
+        };
+
+        struct DecodeResult {
+            uint64_t contentHash;
+            UploadBatcher *uploader;
+            DecodedTexture decoded;
+        };
+
+        ResourceHandles *_resources;
+        Texture *_defaultTexture;
+        VkRenderer::descriptor::Allocator *_descriptorAllocator;
+        std::mutex _descriptorMutex;
+        std::vector<VkDescriptorSet> _freeDescriptors;
+
+        // guards the cache, models load on the render and loader threads
+        std::mutex _cacheMutex;
+        std::unordered_map<uint64_t, CacheEntry> _entries;
+        std::unordered_map<Texture *, uint64_t> _entryHashes;
+        std::unordered_map<std::string, uint64_t> _pathHashes;
+        // signalled with _cacheMutex as entries move on
+        std::condition_variable _readyCondition;
+        // entries of other batchers each batcher was handed before they were ready
+        std::unordered_map<UploadBatcher *, std::vector<uint64_t>> _referenced;
+        // entries waiting on the batcher's next submit and on the graphics queue acquiring them
+        std::unordered_map<UploadBatcher *, std::vector<uint64_t>> _unsubmitted;
+        std::unordered_map<UploadBatcher *, std::vector<uint64_t>> _submitted;
+
+        // decode results handed back from worker threads
+        std::mutex _decodeMutex;
+        std::condition_variable _decodeCondition;
+        std::deque<DecodeResult> _decoded;
+        std::unordered_map<UploadBatcher *, size_t> _pendingDecodes;
+
+        // texture with a new image, set and table slot for decoded, the entry is updated by the caller
+        Texture upload_texture(Texture texture, uint32_t baseLevel, UploadBatcher *uploader, std::shared_ptr<DecodedTexture> decoded);
+
+        // hit on an entry, remembered if caller has to wait for it, _cacheMutex must be held
+        void reference(uint64_t contentHash, CacheEntry &entry, UploadBatcher *caller);
+
+        // whether caller can use the entry, moving completed ones to ready, _cacheMutex must be held
+        bool ready_for(uint64_t contentHash, UploadBatcher *caller);
+
+        void destroy_entry(CacheEntry &entry);
+    };
+}
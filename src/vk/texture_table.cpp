@@ -0,0 +1,138 @@
+#include <iostream>
+#include <algorithm>
+#include <vk/check.h>
+#include <vk/info.h>
+
+#include "texture_table.h"
+
+namespace VkRenderer {
+    void TextureTable::init(ResourceHandles *resources) {
+        _resources = resources;
+        if (!_resources->descriptorIndexing) {
+            std::cout << "Descriptor indexing unsupported, bindless textures are disabled" << std::endl;
+            return;
+        }
+
+        // the materials using the table sample nothing else in the fragment stage
+        const VkPhysicalDeviceLimits &limits = _resources->gpuProperties.limits;
+        _capacity = std::min({TEXTURE_TABLE_CAPACITY, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages});
+
+        // images, then the sampler every texture shares, slots that were never written are left unbound
+        VkDescriptorSetLayoutBinding bindings[2];
+        bindings[0] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+        bindings[0].descriptorCount = _capacity;
+        bindings[1] = VkRenderer::descriptor::descriptor_set_layout_binding(VK_DESCRIPTOR_TYPE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+        bindings[1].pImmutableSamplers = &_resources->textureSampler;
+        VkDescriptorBindingFlagsEXT bindingFlags[2] = {VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT, 0};
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+        bindingFlagsInfo.pNext = nullptr;
+        bindingFlagsInfo.bindingCount = 2;
+        bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+        // the layout cache ignores binding flags, so this layout is created on its own
+        VkDescriptorSetLayoutCreateInfo layoutInfo = VkRenderer::info::descriptor_set_layout_create_info(2, bindings, 0);
+        layoutInfo.pNext = &bindingFlagsInfo;
+        VK_CHECK(vkCreateDescriptorSetLayout(_resources->device, &layoutInfo, nullptr, &_layout));
+
+        VkDescriptorPoolSize poolSizes[] = {
+                {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, _capacity * FRAME_OVERLAP},
+                {VK_DESCRIPTOR_TYPE_SAMPLER, FRAME_OVERLAP}
+        };
+        VkDescriptorPoolCreateInfo poolInfo = VkRenderer::info::descriptor_pool_create_info(FRAME_OVERLAP, 2, poolSizes);
+        VK_CHECK(vkCreateDescriptorPool(_resources->device, &poolInfo, nullptr, &_pool));
+
+        VkDescriptorSetLayout layouts[FRAME_OVERLAP];
+        std::fill(std::begin(layouts), std::end(layouts), _layout);
+        VkDescriptorSetAllocateInfo allocateInfo = VkRenderer::info::descriptor_set_allocate_info(_pool, FRAME_OVERLAP, layouts);
+        VK_CHECK(vkAllocateDescriptorSets(_resources->device, &allocateInfo, _sets));
+
+        std::cout << "Bindless texture table with " << _capacity << " slots" << std::endl;
+        _resources->mainDeletionQueue.push_function([=]() {
+            cleanup();
+        });
+    }
+
+    uint32_t TextureTable::add(VkImageView view) {
+        if (!supported()) return TEXTURE_TABLE_DEFAULT;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        uint32_t slot;
+        if (!_freeSlots.empty()) {
+            slot = _freeSlots.back();
+            _freeSlots.pop_back();
+        } else if (_views.size() < _capacity) {
+            slot = static_cast<uint32_t>(_views.size());
+            _views.push_back(VK_NULL_HANDLE);
+        } else {
+            std::cout << "Texture table is full, drawing with the default texture" << std::endl;
+            return TEXTURE_TABLE_DEFAULT;
+        }
+        _views[slot] = view;
+        mark_pending(slot);
+        return slot;
+    }
+
+    void TextureTable::update(uint32_t slot, VkImageView view) {
+        if (!supported()) return;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _views[slot] = view;
+        mark_pending(slot);
+    }
+
+    void TextureTable::remove(uint32_t slot) {
+        // textures without a slot of their own share the default one
+        if (!supported() || slot == TEXTURE_TABLE_DEFAULT) return;
+
+        // the stale descriptor stays in the sets, partially bound slots only need to be valid when used
+        std::lock_guard<std::mutex> lock(_mutex);
+        _views[slot] = VK_NULL_HANDLE;
+        _freeSlots.push_back(slot);
+    }
+
+    void TextureTable::begin_frame(uint32_t frameIndex) {
+        if (!supported()) return;
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<uint32_t> &pending = _pending[frameIndex];
+        if (pending.empty()) return;
+
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        std::vector<VkDescriptorImageInfo> imageInfos;
+        imageInfos.reserve(pending.size());
+        std::vector<VkWriteDescriptorSet> writes;
+        writes.reserve(pending.size());
+        for (uint32_t slot: pending) {
+            if (_views[slot] == VK_NULL_HANDLE) continue;
+
+            VkDescriptorImageInfo imageInfo = {};
+            imageInfo.sampler = VK_NULL_HANDLE;
+            imageInfo.imageView = _views[slot];
+            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfos.push_back(imageInfo);
+            VkWriteDescriptorSet write = VkRenderer::descriptor::write_descriptor_image(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, _sets[frameIndex], &imageInfos.back(), 0);
+            write.dstArrayElement = slot;
+            writes.push_back(write);
+        }
+        vkUpdateDescriptorSets(_resources->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        pending.clear();
+    }
+
+    uint32_t TextureTable::count() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return static_cast<uint32_t>(_views.size() - _freeSlots.size());
+    }
+
+    void TextureTable::mark_pending(uint32_t slot) {
+        for (auto &pending: _pending) {
+            pending.push_back(slot);
+        }
+    }
+
+    void TextureTable::cleanup() {
+        vkDestroyDescriptorPool(_resources->device, _pool, nullptr);
+        vkDestroyDescriptorSetLayout(_resources->device, _layout, nullptr);
+    }
+}
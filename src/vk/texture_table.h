@@ -0,0 +1,63 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <vk/types.h>
+
+namespace VkRenderer {
+    // slots in the table, lowered to what the device allows
+    constexpr uint32_t TEXTURE_TABLE_CAPACITY = 4096;
+    // the first texture added, the default one, stands in for textures that didn't get a slot
+    constexpr uint32_t TEXTURE_TABLE_DEFAULT = 0;
+
+    // every texture's image in one partially bound array (descriptor indexing), shaders pick theirs with the textureIndex of the draw data
+    // so draws don't bind a texture set, each frame in flight has its own copy of the set and changed slots are written into it
+    // once its fence has been waited on, slots keep their index for the life of the texture
+    class TextureTable {
+    public:
+        // leaves the table unsupported unless the device has descriptor indexing
+        void init(ResourceHandles *resources);
+
+        // slot for view, TEXTURE_TABLE_DEFAULT if the table is full or unsupported
+        uint32_t add(VkImageView view);
+
+        // point the slot at another image of the texture, the old view must live until both frames have moved on
+        void update(uint32_t slot, VkImageView view);
+
+        // the GPU must be done with the slot's texture
+        void remove(uint32_t slot);
+
+        // write the slots changed since the frame last used its set, the frame's fence must have been waited on
+        void begin_frame(uint32_t frameIndex);
+
+        // bound at set 1 instead of a texture's own set
+        [[nodiscard]] VkDescriptorSet descriptor(uint32_t frameIndex) const { return _sets[frameIndex]; }
+
+        [[nodiscard]] VkDescriptorSetLayout layout() const { return _layout; }
+
+        [[nodiscard]] bool supported() const { return _layout != VK_NULL_HANDLE; }
+
+        [[nodiscard]] uint32_t capacity() const { return _capacity; }
+
+        [[nodiscard]] uint32_t count();
+
+    private:
+        ResourceHandles *_resources;
+        VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+        VkDescriptorPool _pool = VK_NULL_HANDLE;
+        VkDescriptorSet _sets[FRAME_OVERLAP] = {};
+        uint32_t _capacity = 0;
+
+        // textures are added on the loader thread
+        std::mutex _mutex;
+        // current view of every slot ever used, VK_NULL_HANDLE once removed
+        std::vector<VkImageView> _views;
+        std::vector<uint32_t> _freeSlots;
+        // slots each frame's set is behind on
+        std::vector<uint32_t> _pending[FRAME_OVERLAP];
+
+        void mark_pending(uint32_t slot);
+
+        void cleanup();
+    };
+}
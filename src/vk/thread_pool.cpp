@@ -0,0 +1,54 @@
+#include "thread_pool.h"
+
+namespace VkRenderer {
+    void ThreadPool::init(uint32_t threadCount) {
+        // always keep at least one worker so submitted jobs make progress
+        if (threadCount == 0) threadCount = 1;
+
+        _workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            _workers.emplace_back(&ThreadPool::worker_loop, this);
+        }
+    }
+
+    void ThreadPool::submit(std::function<void()> &&job) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _jobs.push_back(std::move(job));
+        }
+        _condition.notify_one();
+    }
+
+    uint32_t ThreadPool::thread_count() const {
+        return static_cast<uint32_t>(_workers.size());
+    }
+
+    void ThreadPool::cleanup() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_all();
+
+        // workers drain remaining jobs before exiting
+        for (auto &worker: _workers) {
+            worker.join();
+        }
+        _workers.clear();
+    }
+
+    void ThreadPool::worker_loop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _condition.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+                if (_jobs.empty()) return;
+
+                job = std::move(_jobs.front());
+                _jobs.pop_front();
+            }
+            job();
+        }
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VkRenderer {
+    class ThreadPool {
+    public:
+        void init(uint32_t threadCount);
+
+        void submit(std::function<void()> &&job);
+
+        [[nodiscard]] uint32_t thread_count() const;
+
+        void cleanup();
+
+    private:
+        std::vector<std::thread> _workers;
+        std::deque<std::function<void()>> _jobs;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _stopping = false;
+
+        void worker_loop();
+    };
+}
@@ -2,13 +2,30 @@
 
 #include <deque>
 #include <functional>
+#include <mutex>
+#include <vector>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
 #include <vk/descriptor.h>
+#include <vk/thread_pool.h>
 #include <camera.h>
 
 namespace VkRenderer {
+    class UploadBatcher;
+
+    class TextureManager;
+
+    class TextureStreamer;
+
+    class GeometryBuffer;
+
+    class InstanceBuffer;
+
+    class DrawDataBuffer;
+
+    class TextureTable;
+
     struct AllocatedBuffer {
         VkBuffer _buffer;
         VmaAllocation _allocation;
@@ -33,6 +50,31 @@ namespace VkRenderer {
         glm::vec4 sunlightColor;
     };
 
+    struct DeletionQueue {
+        std::deque<std::function<void()>> deletors;
+        std::mutex mutex;
+
+        void push_function(std::function<void()> &&function) {
+            // resources can be created on the model loader thread
+            std::lock_guard<std::mutex> lock(mutex);
+            deletors.push_back(function);
+        }
+
+        void flush() {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            // reverse iterate deletion queue and call all functions
+            for (auto i = deletors.rbegin(); i != deletors.rend(); i++) {
+                (*i)();
+            }
+
+            deletors.clear();
+        }
+    };
+
+    // frames recorded while the GPU works on earlier ones, per-frame resources are duplicated this many times
+    constexpr unsigned int FRAME_OVERLAP = 2;
+
     struct FrameData {
         VkSemaphore _presentSemaphore, _renderSemaphore;
         VkFence _renderFence;
@@ -40,6 +82,8 @@ namespace VkRenderer {
         VkCommandBuffer _mainCommandBuffer;
         AllocatedBuffer cameraBuffer;
         VkRenderer::descriptor::Allocator *_descriptorAllocator;
+        // resources the GPU may still be reading, flushed once this frame's fence is next waited on
+        DeletionQueue _deletionQueue;
     };
 
     struct UploadContext {
@@ -48,33 +92,48 @@ namespace VkRenderer {
         VkCommandBuffer _commandBuffer;
     };
 
-    struct MatrixPushConstant {
-        glm::vec4 data;
-        glm::mat4 matrix;
+    // runtime knobs exposed in the UI
+    struct RenderSettings {
+        float lodBias = 0.0f;
+        int textureBudgetMB = 512;
+        // models loaded while set use the compact vertex format
+        bool compactVertices = true;
+        // models loaded while set are imported with MODEL_OPTION_STATIC_BATCHING
+        bool staticBatching = true;
+        // skip mesh draws whose bounds are outside the camera frustum
+        bool frustumCulling = true;
+        // draw meshes through the meshlet culling compute pass
+        bool meshletCulling = true;
+        bool coneCulling = true;
+        // two phase hierarchical depth culling of meshlets, needs meshletCulling
+        bool occlusionCulling = true;
+        // cull, pick detail levels and write draws on the GPU, replaces the meshlet pass and the CPU draw loop
+        bool gpuDriven = false;
+        // sample textures from the TextureTable by the draw's texture index instead of binding a set per texture, needs descriptorIndexing
+        bool bindlessTextures = false;
+        // coarsest level of detail whose simplification error projects to at most this many pixels
+        float lodErrorPixels = 1.0f;
     };
 
-    struct DeletionQueue {
-        std::deque<std::function<void()>> deletors;
-
-        void push_function(std::function<void()> &&function) {
-            deletors.push_back(function);
-        }
-
-        void flush() {
-            // reverse iterate deletion queue and call all functions
-            for (auto i = deletors.rbegin(); i != deletors.rend(); i++) {
-                (*i)();
-            }
-
-            deletors.clear();
-        }
+    // pushed once per frame, per-draw data lives in the DrawDataBuffer
+    struct FramePushConstant {
+        glm::vec4 data; // x for texture LOD bias
     };
 
     struct ResourceHandles {
         struct SDL_Window *window{nullptr};
         FlyCamera *flyCamera;
+        ThreadPool *threadPool;
         GPUSceneData sceneParameters;
+        RenderSettings settings;
         UploadContext uploadContext;
+        UploadBatcher *uploader;
+        TextureManager *textureManager;
+        TextureStreamer *textureStreamer;
+        GeometryBuffer *geometryBuffer;
+        InstanceBuffer *instanceBuffer;
+        DrawDataBuffer *drawData;
+        TextureTable *textureTable;
         DeletionQueue mainDeletionQueue;
         VmaAllocator allocator;
         VkExtent2D windowExtent{1700, 900};
@@ -82,6 +141,15 @@ namespace VkRenderer {
         VkDebugUtilsMessengerEXT debug_messenger;
         VkPhysicalDevice chosenGPU;
         VkPhysicalDeviceProperties gpuProperties;
+        // some memory type is both DEVICE_LOCAL and HOST_VISIBLE (UMA, resizable BAR)
+        bool hostVisibleDeviceMemory{false};
+        // BC formats can be sampled, cooked textures are used
+        bool textureCompressionBC{false};
+        // indirect draws can use a GPU-written draw count (VK_KHR_draw_indirect_count) and several commands per call
+        bool drawIndirectCount{false};
+        bool multiDrawIndirect{false};
+        // partially bound, non-uniformly indexed sampled image arrays (VK_EXT_descriptor_indexing)
+        bool descriptorIndexing{false};
         VkDevice device;
         VkSurfaceKHR surface;
         VkSwapchainKHR swapchain;
@@ -93,9 +161,20 @@ namespace VkRenderer {
         VkFormat depthFormat;
         VkQueue graphicsQueue;
         uint32_t graphicsQueueFamily;
+        // dedicated transfer queue if the device has one, otherwise the graphics queue
+        VkQueue transferQueue;
+        uint32_t transferQueueFamily;
+        // guards submissions when the transfer and graphics queues are the same VkQueue
+        std::mutex queueMutex;
         VkRenderPass renderPass;
+        // renderPass split around the occlusion culling pass, the early one leaves depth readable and color unpresented
+        VkRenderPass earlyRenderPass;
+        VkRenderPass lateRenderPass;
         std::vector<VkFramebuffer> framebuffers;
         VkRenderer::descriptor::LayoutCache *descriptorLayoutCache;
+        VkRenderer::descriptor::SamplerCache *samplerCache;
+        // filtering shared by every material texture, baked into textureSetLayout
+        VkSampler textureSampler;
         VkDescriptorSetLayout globalSetLayout;
         VkDescriptorSetLayout textureSetLayout;
     };
@@ -0,0 +1,367 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <vk/check.h>
+#include <vk/info.h>
+
+#include "upload.h"
+
+namespace VkRenderer {
+    // satisfies copy offset rules for every format we upload
+    constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+    // buffer uploads are split into chunks no smaller than this when the ring is busy
+    constexpr VkDeviceSize STAGING_MIN_CHUNK = 256 * 1024;
+
+    static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    static void texel_block(VkFormat format, uint32_t &blockWidth, uint32_t &blockHeight, uint32_t &blockBytes) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+                blockWidth = 4;
+                blockHeight = 4;
+                blockBytes = 8;
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                blockWidth = 4;
+                blockHeight = 4;
+                blockBytes = 16;
+                break;
+            default:
+                blockWidth = 1;
+                blockHeight = 1;
+                blockBytes = 4;
+                break;
+        }
+    }
+
+    void UploadBatcher::init(ResourceHandles *resources, VkQueue queue, uint32_t queueFamily, VkDeviceSize stagingSize) {
+        _resources = resources;
+        _queue = queue;
+        _queueFamily = queueFamily;
+        _stagingSize = stagingSize;
+
+        // command buffers are recycled individually as batches retire
+        VkCommandPoolCreateInfo commandPoolInfo = VkRenderer::info::command_pool_create_info(queueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+        VK_CHECK(vkCreateCommandPool(_resources->device, &commandPoolInfo, nullptr, &_commandPool));
+
+        // persistently mapped staging ring
+        VkBufferCreateInfo stagingInfo = VkRenderer::info::buffer_create_info(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        VmaAllocationCreateInfo stagingAllocInfo = VkRenderer::info::allocation_create_info(VMA_MEMORY_USAGE_CPU_ONLY, 0);
+        stagingAllocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        VmaAllocationInfo stagingResult;
+        VK_CHECK(vmaCreateBuffer(_resources->allocator, &stagingInfo, &stagingAllocInfo, &_staging._buffer, &_staging._allocation, &stagingResult));
+        _stagingData = static_cast<uint8_t *>(stagingResult.pMappedData);
+
+        _resources->mainDeletionQueue.push_function([=]() {
+            for (auto &batch: _inFlight) {
+                _freeFences.push_back(batch.fence);
+            }
+            for (auto fence: _freeFences) {
+                vkDestroyFence(_resources->device, fence, nullptr);
+            }
+            vkDestroyCommandPool(_resources->device, _commandPool, nullptr);
+            vmaDestroyBuffer(_resources->allocator, _staging._buffer, _staging._allocation);
+        });
+    }
+
+    void UploadBatcher::upload_buffer(VkBuffer buffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size, VkAccessFlags dstAccessMask) {
+        const auto *src = static_cast<const uint8_t *>(data);
+        VkDeviceSize copied = 0;
+        while (copied < size) {
+            // take as much of the ring as is free, large buffers go in several copies
+            VkDeviceSize remaining = size - copied;
+            VkDeviceSize stagingOffset;
+            VkDeviceSize granted = allocate(remaining, std::min(remaining, STAGING_MIN_CHUNK), stagingOffset);
+            memcpy(_stagingData + stagingOffset, src + copied, granted);
+
+            VkBufferCopy copy;
+            copy.srcOffset = stagingOffset;
+            copy.dstOffset = dstOffset + copied;
+            copy.size = granted;
+            vkCmdCopyBuffer(command_buffer(), _staging._buffer, buffer, 1, &copy);
+
+            copied += granted;
+        }
+
+        // make the writes visible to the consumer at the end of the batch
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = dstOffset;
+        barrier.size = size;
+
+        if (transfers_ownership()) {
+            // release here, the graphics queue acquires before first use
+            barrier.srcQueueFamilyIndex = _queueFamily;
+            barrier.dstQueueFamilyIndex = _resources->graphicsQueueFamily;
+            VkBufferMemoryBarrier acquire = barrier;
+            acquire.srcAccessMask = 0;
+            _bufferAcquires.push_back(acquire);
+            barrier.dstAccessMask = 0;
+        }
+        _pendingBufferBarriers.push_back(barrier);
+    }
+
+    void UploadBatcher::upload_image(VkImage image, VkFormat format, const std::vector<ImageLevel> &levels) {
+        uint32_t blockWidth, blockHeight, blockBytes;
+        texel_block(format, blockWidth, blockHeight, blockBytes);
+
+        VkImageSubresourceRange range;
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = 0;
+        range.levelCount = static_cast<uint32_t>(levels.size());
+        range.baseArrayLayer = 0;
+        range.layerCount = 1;
+
+        VkImageMemoryBarrier imageBarrierTransfer = {};
+        imageBarrierTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        imageBarrierTransfer.pNext = nullptr;
+        imageBarrierTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageBarrierTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrierTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrierTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageBarrierTransfer.image = image;
+        imageBarrierTransfer.subresourceRange = range;
+        imageBarrierTransfer.srcAccessMask = 0;
+        imageBarrierTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(command_buffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrierTransfer);
+
+        for (uint32_t level = 0; level < levels.size(); level++) {
+            const ImageLevel &imageLevel = levels[level];
+            const auto *src = static_cast<const uint8_t *>(imageLevel.data);
+            uint32_t blocksWide = (imageLevel.extent.width + blockWidth - 1) / blockWidth;
+            uint32_t blocksHigh = (imageLevel.extent.height + blockHeight - 1) / blockHeight;
+            VkDeviceSize rowBytes = static_cast<VkDeviceSize>(blocksWide) * blockBytes;
+
+            // oversized levels are split into bands of whole block rows
+            uint32_t row = 0;
+            while (row < blocksHigh) {
+                VkDeviceSize stagingOffset;
+                VkDeviceSize granted = allocate((blocksHigh - row) * rowBytes, rowBytes, stagingOffset);
+                auto rows = static_cast<uint32_t>(std::min<VkDeviceSize>(granted / rowBytes, blocksHigh - row));
+                memcpy(_stagingData + stagingOffset, src + row * rowBytes, rows * rowBytes);
+
+                uint32_t texelRow = row * blockHeight;
+                VkBufferImageCopy copyRegion = {};
+                copyRegion.bufferOffset = stagingOffset;
+                copyRegion.bufferRowLength = 0;
+                copyRegion.bufferImageHeight = 0;
+                copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                copyRegion.imageSubresource.mipLevel = level;
+                copyRegion.imageSubresource.baseArrayLayer = 0;
+                copyRegion.imageSubresource.layerCount = 1;
+                copyRegion.imageOffset = {0, static_cast<int32_t>(texelRow), 0};
+                copyRegion.imageExtent = {imageLevel.extent.width, std::min(rows * blockHeight, imageLevel.extent.height - texelRow), 1};
+
+                vkCmdCopyBufferToImage(command_buffer(), _staging._buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+                row += rows;
+            }
+        }
+
+        // transition to readable at the end of the batch
+        VkImageMemoryBarrier imageBarrierReadable = imageBarrierTransfer;
+        imageBarrierReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        imageBarrierReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageBarrierReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        imageBarrierReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        if (transfers_ownership()) {
+            // transfer-only queues can't wait on shader stages, the graphics queue finishes the transition
+            imageBarrierReadable.srcQueueFamilyIndex = _queueFamily;
+            imageBarrierReadable.dstQueueFamilyIndex = _resources->graphicsQueueFamily;
+            VkImageMemoryBarrier acquire = imageBarrierReadable;
+            acquire.srcAccessMask = 0;
+            _imageAcquires.push_back(acquire);
+            imageBarrierReadable.dstAccessMask = 0;
+        }
+        _pendingImageBarriers.push_back(imageBarrierReadable);
+    }
+
+    uint64_t UploadBatcher::submit() {
+        if (!_pendingBufferBarriers.empty() || !_pendingImageBarriers.empty()) {
+            // one barrier for every resource in the batch
+            VkPipelineStageFlags dstStage = transfers_ownership() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            vkCmdPipelineBarrier(command_buffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr,
+                                 static_cast<uint32_t>(_pendingBufferBarriers.size()), _pendingBufferBarriers.data(),
+                                 static_cast<uint32_t>(_pendingImageBarriers.size()), _pendingImageBarriers.data());
+            _pendingBufferBarriers.clear();
+            _pendingImageBarriers.clear();
+        }
+
+        submit_current();
+        return _nextTicket - 1;
+    }
+
+    bool UploadBatcher::is_complete(uint64_t ticket) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (ticket <= _completedTicket) return true;
+
+        // batches complete in submission order, so the ticket's own fence is enough
+        for (auto &batch: _inFlight) {
+            if (batch.ticket == ticket) {
+                return vkGetFenceStatus(_resources->device, batch.fence) == VK_SUCCESS;
+            }
+        }
+        return false;
+    }
+
+    void UploadBatcher::wait(uint64_t ticket) {
+        while (_completedTicket < ticket && retire_oldest(true)) {}
+    }
+
+    void UploadBatcher::flush() {
+        wait(submit());
+    }
+
+    void UploadBatcher::take_acquires(std::vector<VkBufferMemoryBarrier> &bufferAcquires, std::vector<VkImageMemoryBarrier> &imageAcquires) {
+        bufferAcquires.swap(_bufferAcquires);
+        imageAcquires.swap(_imageAcquires);
+        _bufferAcquires.clear();
+        _imageAcquires.clear();
+    }
+
+    void UploadBatcher::acquire_image(const VkImageMemoryBarrier &acquire) {
+        _pendingImageBarriers.push_back(acquire);
+    }
+
+    VkCommandBuffer UploadBatcher::command_buffer() {
+        if (_currentCmd != VK_NULL_HANDLE) {
+            return _currentCmd;
+        }
+
+        // recycle a retired command buffer if there is one
+        if (!_freeCommandBuffers.empty()) {
+            _currentCmd = _freeCommandBuffers.back();
+            _freeCommandBuffers.pop_back();
+        } else {
+            VkCommandBufferAllocateInfo cmdAllocInfo = VkRenderer::info::command_buffer_allocate_info(_commandPool, 1);
+            VK_CHECK(vkAllocateCommandBuffers(_resources->device, &cmdAllocInfo, &_currentCmd));
+        }
+
+        VkCommandBufferBeginInfo cmdBeginInfo = VkRenderer::info::command_buffer_begin_info(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(_currentCmd, &cmdBeginInfo));
+        return _currentCmd;
+    }
+
+    VkDeviceSize UploadBatcher::allocate(VkDeviceSize maxSize, VkDeviceSize minSize, VkDeviceSize &offset) {
+        if (minSize > _stagingSize) {
+            std::cout << "Upload of " << minSize << " bytes does not fit the staging ring" << std::endl;
+            abort();
+        }
+
+        while (true) {
+            if (_used == 0) _head = 0;
+
+            // free space is [head, end) + [0, tail) unless the in-use region wraps
+            VkDeviceSize tail = (_head + _stagingSize - _used) % _stagingSize;
+            VkDeviceSize alignedHead = align_up(_head, STAGING_ALIGNMENT);
+            VkDeviceSize granted = 0;
+            VkDeviceSize consumed = 0;
+            if (_used < _stagingSize) {
+                if (_head >= tail) {
+                    if (alignedHead < _stagingSize && _stagingSize - alignedHead >= minSize) {
+                        offset = alignedHead;
+                        granted = std::min(maxSize, _stagingSize - alignedHead);
+                        consumed = alignedHead - _head + granted;
+                    } else if (tail >= minSize) {
+                        // skip the end of the ring and wrap around
+                        offset = 0;
+                        granted = std::min(maxSize, tail);
+                        consumed = _stagingSize - _head + granted;
+                    }
+                } else if (alignedHead < tail && tail - alignedHead >= minSize) {
+                    offset = alignedHead;
+                    granted = std::min(maxSize, tail - alignedHead);
+                    consumed = alignedHead - _head + granted;
+                }
+            }
+
+            if (granted > 0) {
+                _head = offset + granted;
+                _used += consumed;
+                _batchBytes += consumed;
+                return granted;
+            }
+
+            // ring is full, get our own copies moving and reclaim the oldest batch
+            if (_batchBytes > 0) {
+                submit_current();
+            }
+            retire_oldest(true);
+        }
+    }
+
+    void UploadBatcher::submit_current() {
+        if (_currentCmd == VK_NULL_HANDLE) return;
+        VK_CHECK(vkEndCommandBuffer(_currentCmd));
+
+        // grab a fence from the pool
+        VkFence fence;
+        if (!_freeFences.empty()) {
+            fence = _freeFences.back();
+            _freeFences.pop_back();
+        } else {
+            VkFenceCreateInfo fenceCreateInfo = VkRenderer::info::fence_create_info();
+            VK_CHECK(vkCreateFence(_resources->device, &fenceCreateInfo, nullptr, &fence));
+        }
+
+        VkSubmitInfo submitInfo = VkRenderer::info::submit_info(nullptr, 0, nullptr, 0, nullptr, 1, &_currentCmd);
+        {
+            std::lock_guard<std::mutex> lock(_resources->queueMutex);
+            VK_CHECK(vkQueueSubmit(_queue, 1, &submitInfo, fence));
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        _inFlight.push_back({_nextTicket++, fence, _currentCmd, _batchBytes});
+        _currentCmd = VK_NULL_HANDLE;
+        _batchBytes = 0;
+    }
+
+    bool UploadBatcher::retire_oldest(bool block) {
+        InFlightBatch batch;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_inFlight.empty()) return false;
+            batch = _inFlight.front();
+        }
+
+        // wait outside the lock so is_complete never stalls behind us
+        if (block) {
+            VK_CHECK(vkWaitForFences(_resources->device, 1, &batch.fence, true, UINT64_MAX));
+        } else if (vkGetFenceStatus(_resources->device, batch.fence) != VK_SUCCESS) {
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _inFlight.pop_front();
+            vkResetFences(_resources->device, 1, &batch.fence);
+            _completedTicket = batch.ticket;
+        }
+
+        // staging bytes and command buffer can be reused now
+        _freeFences.push_back(batch.fence);
+        vkResetCommandBuffer(batch.cmd, 0);
+        _freeCommandBuffers.push_back(batch.cmd);
+        _used -= batch.ringBytes;
+        return true;
+    }
+
+    bool UploadBatcher::transfers_ownership() const {
+        return _queueFamily != _resources->graphicsQueueFamily;
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <vk/types.h>
+
+namespace VkRenderer {
+    constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+
+    struct ImageLevel {
+        const void *data;
+        VkDeviceSize size;
+        VkExtent3D extent;
+    };
+
+    // records copies for many resources into a few command buffers, staged through one persistently mapped ring
+    class UploadBatcher {
+    public:
+        void init(ResourceHandles *resources, VkQueue queue, uint32_t queueFamily, VkDeviceSize stagingSize = STAGING_RING_SIZE);
+
+        void upload_buffer(VkBuffer buffer, VkDeviceSize dstOffset, const void *data, VkDeviceSize size, VkAccessFlags dstAccessMask);
+
+        // levels are uploaded in order starting at mip 0, image ends up in SHADER_READ_ONLY_OPTIMAL
+        void upload_image(VkImage image, VkFormat format, const std::vector<ImageLevel> &levels);
+
+        // submit everything recorded so far, the returned ticket can be polled from any thread
+        uint64_t submit();
+
+        bool is_complete(uint64_t ticket);
+
+        void wait(uint64_t ticket);
+
+        // submit and block until the GPU is done
+        void flush();
+
+        // acquire halves of queue family ownership transfers, recorded later on the graphics queue
+        void take_acquires(std::vector<VkBufferMemoryBarrier> &bufferAcquires, std::vector<VkImageMemoryBarrier> &imageAcquires);
+
+        // record the acquire half of another batcher's image transfer at the end of the batch, the release must have completed
+        void acquire_image(const VkImageMemoryBarrier &acquire);
+
+        // uploads end with a release to the graphics queue family
+        [[nodiscard]] bool transfers_ownership() const;
+
+    private:
+        struct InFlightBatch {
+            uint64_t ticket;
+            VkFence fence;
+            VkCommandBuffer cmd;
+            VkDeviceSize ringBytes;
+        };
+
+        ResourceHandles *_resources;
+        VkQueue _queue;
+        uint32_t _queueFamily;
+        VkCommandPool _commandPool;
+        VkCommandBuffer _currentCmd = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> _freeCommandBuffers;
+        std::vector<VkFence> _freeFences;
+
+        // staging ring, in-use bytes end at _head
+        AllocatedBuffer _staging;
+        uint8_t *_stagingData;
+        VkDeviceSize _stagingSize;
+        VkDeviceSize _head = 0;
+        VkDeviceSize _used = 0;
+        VkDeviceSize _batchBytes = 0;
+
+        // guards in-flight state, is_complete can be called from other threads
+        std::mutex _mutex;
+        std::deque<InFlightBatch> _inFlight;
+        uint64_t _nextTicket = 1;
+        uint64_t _completedTicket = 0;
+
+        // final barriers, recorded once at the end of the batch
+        std::vector<VkBufferMemoryBarrier> _pendingBufferBarriers;
+        std::vector<VkImageMemoryBarrier> _pendingImageBarriers;
+        std::vector<VkBufferMemoryBarrier> _bufferAcquires;
+        std::vector<VkImageMemoryBarrier> _imageAcquires;
+
+        VkCommandBuffer command_buffer();
+
+        VkDeviceSize allocate(VkDeviceSize maxSize, VkDeviceSize minSize, VkDeviceSize &offset);
+
+        void submit_current();
+
+        bool retire_oldest(bool block);
+    };
+}
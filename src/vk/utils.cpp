@@ -1,49 +1,133 @@
-#include <iostream>
-#include <vk/info.h>
-#include <vk/check.h>
-
-#include "utils.h"
-
-namespace VkRenderer::utils {
-    AllocatedBuffer create_buffer(VmaAllocator &allocator, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
-        // allocate buffer
-        VkBufferCreateInfo bufferInfo = VkRenderer::info::buffer_create_info(allocSize, usage);
-        VmaAllocationCreateInfo vmaAllocInfo = VkRenderer::info::allocation_create_info(memoryUsage, 0);
-        AllocatedBuffer newBuffer;
-        VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaAllocInfo, &newBuffer._buffer, &newBuffer._allocation, nullptr));
-        return newBuffer;
-    }
-
-    size_t pad_uniform_buffer_size(VkPhysicalDeviceProperties gpuProperties, size_t originalSize) {
-        // calculate alignment
-        size_t minUboAlignment = gpuProperties.limits.minUniformBufferOffsetAlignment;
-        size_t alignedSize = originalSize;
-        if (minUboAlignment > 0) {
-            alignedSize = (alignedSize + minUboAlignment - 1) & ~(minUboAlignment - 1);
-        }
-
-        return alignedSize;
-    }
-
-    void immediate_submit(ResourceHandles *resources, std::function<void(VkCommandBuffer cmd)> &&function) {
-        // begin buffer recording
-        VkCommandBuffer cmd = resources->uploadContext._commandBuffer;
-        VkCommandBufferBeginInfo cmdBeginInfo = VkRenderer::info::command_buffer_begin_info(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-        VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
-
-        // execute passed function
-        function(cmd);
-
-        // end recording and submit
-        VK_CHECK(vkEndCommandBuffer(cmd));
-        VkSubmitInfo submitInfo = VkRenderer::info::submit_info(nullptr, 0, nullptr, 0, nullptr, 1, &cmd);
-        VK_CHECK(vkQueueSubmit(resources->graphicsQueue, 1, &submitInfo, resources->uploadContext._uploadFence));
-
-        // block on fence
-        vkWaitForFences(resources->device, 1, &resources->uploadContext._uploadFence, true, 1000000000);
-        vkResetFences(resources->device, 1, &resources->uploadContext._uploadFence);
-
-        // reset pool
-        vkResetCommandPool(resources->device, resources->uploadContext._commandPool, 0);
-    }
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <vk/info.h>
+#include <vk/check.h>
+
+#include "utils.h"
+
+namespace VkRenderer::utils {
+    AllocatedBuffer create_buffer(VmaAllocator &allocator, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage) {
+        // allocate buffer
+        VkBufferCreateInfo bufferInfo = VkRenderer::info::buffer_create_info(allocSize, usage);
+        VmaAllocationCreateInfo vmaAllocInfo = VkRenderer::info::allocation_create_info(memoryUsage, 0);
+        AllocatedBuffer newBuffer;
+        VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &vmaAllocInfo, &newBuffer._buffer, &newBuffer._allocation, nullptr));
+        return newBuffer;
+    }
+
+    bool has_host_visible_device_memory(VkPhysicalDevice physicalDevice) {
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+        VkDeviceSize largestDeviceHeap = 0;
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+            if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                largestDeviceHeap = std::max(largestDeviceHeap, memoryProperties.memoryHeaps[i].size);
+            }
+        }
+
+        // integrated GPUs and resizable BAR map most of VRAM, a plain 256 MB BAR window is too small to hold the geometry
+        const VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+            const VkMemoryType &type = memoryProperties.memoryTypes[i];
+            if ((type.propertyFlags & wanted) == wanted && memoryProperties.memoryHeaps[type.heapIndex].size >= largestDeviceHeap / 2) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint64_t hash_bytes(const void *data, size_t size) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    size_t pad_uniform_buffer_size(VkPhysicalDeviceProperties gpuProperties, size_t originalSize) {
+        // calculate alignment
+        size_t minUboAlignment = gpuProperties.limits.minUniformBufferOffsetAlignment;
+        size_t alignedSize = originalSize;
+        if (minUboAlignment > 0) {
+            alignedSize = (alignedSize + minUboAlignment - 1) & ~(minUboAlignment - 1);
+        }
+
+        return alignedSize;
+    }
+
+    void immediate_submit(ResourceHandles *resources, std::function<void(VkCommandBuffer cmd)> &&function) {
+        // begin buffer recording
+        VkCommandBuffer cmd = resources->uploadContext._commandBuffer;
+        VkCommandBufferBeginInfo cmdBeginInfo = VkRenderer::info::command_buffer_begin_info(nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+
+        // execute passed function
+        function(cmd);
+
+        // end recording and submit
+        VK_CHECK(vkEndCommandBuffer(cmd));
+        VkSubmitInfo submitInfo = VkRenderer::info::submit_info(nullptr, 0, nullptr, 0, nullptr, 1, &cmd);
+        {
+            std::lock_guard<std::mutex> lock(resources->queueMutex);
+            VK_CHECK(vkQueueSubmit(resources->graphicsQueue, 1, &submitInfo, resources->uploadContext._uploadFence));
+        }
+
+        // block on fence
+        vkWaitForFences(resources->device, 1, &resources->uploadContext._uploadFence, true, 1000000000);
+        vkResetFences(resources->device, 1, &resources->uploadContext._uploadFence);
+
+        // reset pool
+        vkResetCommandPool(resources->device, resources->uploadContext._commandPool, 0);
+    }
+
+    bool load_shader_module(VkDevice device, const char *filePath, VkShaderModule *outShaderModule) {
+        // open file, cursor at end
+        std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open()) {
+            return false;
+        }
+
+        // get file size by checking location of cursor
+        size_t fileSize = (size_t) file.tellg();
+        // SPIR-V expects uint32_t buffer
+        std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+        // return cursor to beginning
+        file.seekg(0);
+        // read entire file into buffer
+        file.read((char *) buffer.data(), fileSize);
+        // done with file, clean up
+        file.close();
+
+        // create shader module and check - not using VK_CHECK as shader errors are common
+        VkShaderModuleCreateInfo createInfo = VkRenderer::info::shader_module_create_info(buffer.size() * sizeof(uint32_t), buffer.data());
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            return false;
+        }
+        *outShaderModule = shaderModule;
+        return true;
+    }
+
+    void frustum_planes(const glm::mat4 &viewproj, glm::vec4 planes[6]) {
+        // Gribb-Hartmann, rows of the matrix combined for each clip plane
+        glm::vec4 row0(viewproj[0][0], viewproj[1][0], viewproj[2][0], viewproj[3][0]);
+        glm::vec4 row1(viewproj[0][1], viewproj[1][1], viewproj[2][1], viewproj[3][1]);
+        glm::vec4 row2(viewproj[0][2], viewproj[1][2], viewproj[2][2], viewproj[3][2]);
+        glm::vec4 row3(viewproj[0][3], viewproj[1][3], viewproj[2][3], viewproj[3][3]);
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        // -w <= z also holds for zero-to-one depth, so the near plane is conservative either way
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+        for (int i = 0; i < 6; i++) {
+            planes[i] /= glm::length(glm::vec3(planes[i]));
+        }
+    }
 }
\ No newline at end of file
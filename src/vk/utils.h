@@ -1,9 +1,20 @@
-#include <vk/types.h>
-
-namespace VkRenderer::utils {
-    AllocatedBuffer create_buffer(VmaAllocator &allocator, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
-
-    size_t pad_uniform_buffer_size(VkPhysicalDeviceProperties gpuProperties, size_t originalSize);
-
-    void immediate_submit(ResourceHandles *resources, std::function<void(VkCommandBuffer cmd)> &&function);
+#include <vk/types.h>
+
+namespace VkRenderer::utils {
+    AllocatedBuffer create_buffer(VmaAllocator &allocator, size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+
+    // host-visible device-local memory in a heap large enough to hold scene data, not just the small BAR window
+    bool has_host_visible_device_memory(VkPhysicalDevice physicalDevice);
+
+    // 64-bit FNV-1a, for keying caches by content
+    uint64_t hash_bytes(const void *data, size_t size);
+
+    size_t pad_uniform_buffer_size(VkPhysicalDeviceProperties gpuProperties, size_t originalSize);
+
+    bool load_shader_module(VkDevice device, const char *filePath, VkShaderModule *outShaderModule);
+
+    // normalized world space planes facing inwards, left, right, bottom, top, near, far
+    void frustum_planes(const glm::mat4 &viewproj, glm::vec4 planes[6]);
+
+    void immediate_submit(ResourceHandles *resources, std::function<void(VkCommandBuffer cmd)> &&function);
 }
\ No newline at end of file
@@ -1,49 +1,140 @@
-#include "vertex.h"
-
-namespace VkRenderer {
-    VertexInputDescription Vertex::get_vertex_description() {
-        VertexInputDescription description;
-
-        // one vertex buffer binding, per-vertex rate
-        VkVertexInputBindingDescription mainBinding = {};
-        mainBinding.binding = 0;
-        mainBinding.stride = sizeof(Vertex);
-        mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        description.bindings.push_back(mainBinding);
-
-        // position at location 0
-        VkVertexInputAttributeDescription positionAttribute = {};
-        positionAttribute.binding = 0;
-        positionAttribute.location = 0;
-        positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-        positionAttribute.offset = offsetof(Vertex, position);
-
-        // normal at location 1
-        VkVertexInputAttributeDescription normalAttribute = {};
-        normalAttribute.binding = 0;
-        normalAttribute.location = 1;
-        normalAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-        normalAttribute.offset = offsetof(Vertex, normal);
-
-        // color at location 2
-        VkVertexInputAttributeDescription colorAttribute = {};
-        colorAttribute.binding = 0;
-        colorAttribute.location = 2;
-        colorAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
-        colorAttribute.offset = offsetof(Vertex, color);
-
-        // UV at location 3
-        VkVertexInputAttributeDescription uvAttribute = {};
-        uvAttribute.binding = 0;
-        uvAttribute.location = 3;
-        uvAttribute.format = VK_FORMAT_R32G32_SFLOAT;
-        uvAttribute.offset = offsetof(Vertex, uv);
-
-        description.attributes.push_back(positionAttribute);
-        description.attributes.push_back(normalAttribute);
-        description.attributes.push_back(colorAttribute);
-        description.attributes.push_back(uvAttribute);
-
-        return description;
-    }
+#include <cmath>
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
+
+#include "vertex.h"
+
+namespace VkRenderer {
+    VertexInputDescription Vertex::get_vertex_description(VertexFormat format) {
+        if (format == VertexFormat::Compact) {
+            return CompactVertex::get_vertex_description();
+        }
+
+        VertexInputDescription description;
+
+        // one vertex buffer binding, per-vertex rate
+        VkVertexInputBindingDescription mainBinding = {};
+        mainBinding.binding = 0;
+        mainBinding.stride = sizeof(Vertex);
+        mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        description.bindings.push_back(mainBinding);
+
+        // position at location 0
+        VkVertexInputAttributeDescription positionAttribute = {};
+        positionAttribute.binding = 0;
+        positionAttribute.location = 0;
+        positionAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+        positionAttribute.offset = offsetof(Vertex, position);
+
+        // normal at location 1
+        VkVertexInputAttributeDescription normalAttribute = {};
+        normalAttribute.binding = 0;
+        normalAttribute.location = 1;
+        normalAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+        normalAttribute.offset = offsetof(Vertex, normal);
+
+        // color at location 2
+        VkVertexInputAttributeDescription colorAttribute = {};
+        colorAttribute.binding = 0;
+        colorAttribute.location = 2;
+        colorAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+        colorAttribute.offset = offsetof(Vertex, color);
+
+        // UV at location 3
+        VkVertexInputAttributeDescription uvAttribute = {};
+        uvAttribute.binding = 0;
+        uvAttribute.location = 3;
+        uvAttribute.format = VK_FORMAT_R32G32_SFLOAT;
+        uvAttribute.offset = offsetof(Vertex, uv);
+
+        description.attributes.push_back(positionAttribute);
+        description.attributes.push_back(normalAttribute);
+        description.attributes.push_back(colorAttribute);
+        description.attributes.push_back(uvAttribute);
+
+        return description;
+    }
+
+    VertexInputDescription CompactVertex::get_vertex_description() {
+        VertexInputDescription description;
+
+        VkVertexInputBindingDescription mainBinding = {};
+        mainBinding.binding = 0;
+        mainBinding.stride = sizeof(CompactVertex);
+        mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        description.bindings.push_back(mainBinding);
+
+        // position at location 0, three component 16-bit formats are rarely supported for vertex input
+        VkVertexInputAttributeDescription positionAttribute = {};
+        positionAttribute.binding = 0;
+        positionAttribute.location = 0;
+        positionAttribute.format = VK_FORMAT_R16G16B16A16_UNORM;
+        positionAttribute.offset = offsetof(CompactVertex, position);
+
+        // octahedral normal at location 1
+        VkVertexInputAttributeDescription normalAttribute = {};
+        normalAttribute.binding = 0;
+        normalAttribute.location = 1;
+        normalAttribute.format = VK_FORMAT_R16G16_SNORM;
+        normalAttribute.offset = offsetof(CompactVertex, normal);
+
+        // UV at location 3, the shader derives color from the normal
+        VkVertexInputAttributeDescription uvAttribute = {};
+        uvAttribute.binding = 0;
+        uvAttribute.location = 3;
+        uvAttribute.format = VK_FORMAT_R16G16_SFLOAT;
+        uvAttribute.offset = offsetof(CompactVertex, uv);
+
+        description.attributes.push_back(positionAttribute);
+        description.attributes.push_back(normalAttribute);
+        description.attributes.push_back(uvAttribute);
+
+        return description;
+    }
+
+    CompactVertex CompactVertex::pack(const Vertex &vertex, const glm::vec3 &boundsMin, const glm::vec3 &boundsExtent) {
+        CompactVertex packed{};
+
+        glm::vec3 position = glm::clamp((vertex.position - boundsMin) / boundsExtent, 0.0f, 1.0f);
+        for (int i = 0; i < 3; i++) {
+            packed.position[i] = static_cast<uint16_t>(std::lround(position[i] * 65535.0f));
+        }
+
+        glm::vec2 normal = octahedral_encode(vertex.normal);
+        for (int i = 0; i < 2; i++) {
+            packed.normal[i] = static_cast<int16_t>(std::lround(std::clamp(normal[i], -1.0f, 1.0f) * 32767.0f));
+            packed.uv[i] = glm::packHalf1x16(vertex.uv[i]);
+        }
+
+        return packed;
+    }
+
+    size_t vertex_stride(VertexFormat format) {
+        return format == VertexFormat::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+    }
+
+    glm::vec2 octahedral_encode(const glm::vec3 &normal) {
+        float length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length == 0.0f) {
+            return glm::vec2(0.0f);
+        }
+
+        // project onto the octahedron, then fold the lower half over the diagonals
+        glm::vec3 n = normal / length;
+        glm::vec2 encoded(n.x, n.y);
+        if (n.z < 0.0f) {
+            encoded.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            encoded.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        return encoded;
+    }
+
+    glm::vec3 octahedral_decode(const glm::vec2 &encoded) {
+        // must match decode_normal in default_mesh_compact.vert
+        glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+    }
 }
\ No newline at end of file
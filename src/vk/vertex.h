@@ -1,22 +1,47 @@
-#pragma once
-
-#include <vector>
-#include <vulkan/vulkan.h>
-#include <glm/glm.hpp>
-
-namespace VkRenderer {
-    struct VertexInputDescription {
-        std::vector<VkVertexInputBindingDescription> bindings;
-        std::vector<VkVertexInputAttributeDescription> attributes;
-        VkPipelineVertexInputStateCreateFlags flags = 0;
-    };
-
-    struct Vertex {
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec3 color;
-        glm::vec2 uv;
-
-        static VertexInputDescription get_vertex_description();
-    };
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+namespace VkRenderer {
+    struct VertexInputDescription {
+        std::vector<VkVertexInputBindingDescription> bindings;
+        std::vector<VkVertexInputAttributeDescription> attributes;
+        VkPipelineVertexInputStateCreateFlags flags = 0;
+    };
+
+    enum class VertexFormat {
+        Standard,
+        Compact
+    };
+
+    struct Vertex {
+        glm::vec3 position;
+        glm::vec3 normal;
+        glm::vec3 color;
+        glm::vec2 uv;
+
+        static VertexInputDescription get_vertex_description(VertexFormat format = VertexFormat::Standard);
+    };
+
+    // 16 bytes instead of 44, color is dropped since it only ever held the normal
+    struct CompactVertex {
+        uint16_t position[4]; // unorm within the mesh's quantization box, w unused
+        int16_t normal[2]; // snorm octahedral encoding
+        uint16_t uv[2]; // half float
+
+        static VertexInputDescription get_vertex_description();
+
+        // boundsExtent must be non-zero on every axis
+        static CompactVertex pack(const Vertex &vertex, const glm::vec3 &boundsMin, const glm::vec3 &boundsExtent);
+    };
+
+    size_t vertex_stride(VertexFormat format);
+
+    // unit vector to the [-1, 1] square, zero vectors map to +z
+    glm::vec2 octahedral_encode(const glm::vec3 &normal);
+
+    glm::vec3 octahedral_decode(const glm::vec2 &encoded);
 }
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "bc7.h"
+
+namespace TextureCooker {
+    static const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    struct BitWriter {
+        uint8_t *out;
+        uint32_t position = 0;
+
+        void write(uint32_t value, uint32_t bits) {
+            for (uint32_t i = 0; i < bits; i++) {
+                if ((value >> i) & 1) {
+                    out[position / 8] |= static_cast<uint8_t>(1 << (position % 8));
+                }
+                position++;
+            }
+        }
+    };
+
+    struct Candidate {
+        int quantized[2][4]; // 7-bit endpoints
+        int pBits[2];
+        uint8_t indices[16];
+        uint32_t error;
+    };
+
+    static uint32_t select_indices(const uint8_t *rgba, Candidate &candidate) {
+        // expand endpoints and build the 16 entry palette
+        int endpoints[2][4];
+        for (int i = 0; i < 2; i++) {
+            for (int c = 0; c < 4; c++) {
+                endpoints[i][c] = (candidate.quantized[i][c] << 1) | candidate.pBits[i];
+            }
+        }
+        int palette[16][4];
+        for (int i = 0; i < 16; i++) {
+            for (int c = 0; c < 4; c++) {
+                palette[i][c] = ((64 - BC7_WEIGHTS[i]) * endpoints[0][c] + BC7_WEIGHTS[i] * endpoints[1][c] + 32) >> 6;
+            }
+        }
+
+        uint32_t totalError = 0;
+        for (int p = 0; p < 16; p++) {
+            uint32_t bestError = UINT32_MAX;
+            for (int i = 0; i < 16; i++) {
+                uint32_t error = 0;
+                for (int c = 0; c < 4; c++) {
+                    int diff = rgba[p * 4 + c] - palette[i][c];
+                    error += diff * diff;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    candidate.indices[p] = static_cast<uint8_t>(i);
+                }
+            }
+            totalError += bestError;
+        }
+        candidate.error = totalError;
+        return totalError;
+    }
+
+    static Candidate fit_endpoints(const uint8_t *rgba, const float endpoints[2][4]) {
+        // try every p-bit combination, each shifts the representable values by one
+        Candidate best;
+        best.error = UINT32_MAX;
+        for (int pBits = 0; pBits < 4; pBits++) {
+            Candidate candidate;
+            candidate.pBits[0] = pBits & 1;
+            candidate.pBits[1] = pBits >> 1;
+            for (int i = 0; i < 2; i++) {
+                for (int c = 0; c < 4; c++) {
+                    int value = static_cast<int>(std::lround((endpoints[i][c] - static_cast<float>(candidate.pBits[i])) * 0.5f));
+                    candidate.quantized[i][c] = std::clamp(value, 0, 127);
+                }
+            }
+            if (select_indices(rgba, candidate) < best.error) {
+                best = candidate;
+            }
+        }
+        return best;
+    }
+
+    static bool refine_endpoints(const uint8_t *rgba, const uint8_t *indices, float endpoints[2][4]) {
+        // least squares endpoints for the chosen indices
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[4] = {}, bx[4] = {};
+        for (int p = 0; p < 16; p++) {
+            float t = static_cast<float>(BC7_WEIGHTS[indices[p]]) / 64.0f;
+            float a = 1.0f - t;
+            aa += a * a;
+            ab += a * t;
+            bb += t * t;
+            for (int c = 0; c < 4; c++) {
+                ax[c] += a * rgba[p * 4 + c];
+                bx[c] += t * rgba[p * 4 + c];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) < 1e-6f) return false;
+        for (int c = 0; c < 4; c++) {
+            endpoints[0][c] = std::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+            endpoints[1][c] = std::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    void encode_bc7_block(const uint8_t *rgba, uint8_t *out) {
+        // principal axis of the block colors by power iteration
+        float mean[4] = {};
+        for (int p = 0; p < 16; p++) {
+            for (int c = 0; c < 4; c++) {
+                mean[c] += rgba[p * 4 + c] / 16.0f;
+            }
+        }
+        float covariance[4][4] = {};
+        for (int p = 0; p < 16; p++) {
+            float d[4];
+            for (int c = 0; c < 4; c++) d[c] = rgba[p * 4 + c] - mean[c];
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    covariance[i][j] += d[i] * d[j];
+                }
+            }
+        }
+        float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (int i = 0; i < 4; i++) {
+                for (int j = 0; j < 4; j++) {
+                    next[i] += covariance[i][j] * axis[j];
+                }
+            }
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (length < 1e-6f) break;
+            for (int c = 0; c < 4; c++) axis[c] = next[c] / length;
+        }
+
+        // endpoints at the extremes of the projection
+        float minProjection = 0.0f, maxProjection = 0.0f;
+        for (int p = 0; p < 16; p++) {
+            float projection = 0.0f;
+            for (int c = 0; c < 4; c++) projection += (rgba[p * 4 + c] - mean[c]) * axis[c];
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+        float endpoints[2][4];
+        for (int c = 0; c < 4; c++) {
+            endpoints[0][c] = std::clamp(mean[c] + axis[c] * minProjection, 0.0f, 255.0f);
+            endpoints[1][c] = std::clamp(mean[c] + axis[c] * maxProjection, 0.0f, 255.0f);
+        }
+
+        Candidate best = fit_endpoints(rgba, endpoints);
+        if (best.error > 0 && refine_endpoints(rgba, best.indices, endpoints)) {
+            Candidate refined = fit_endpoints(rgba, endpoints);
+            if (refined.error < best.error) best = refined;
+        }
+
+        // the first index has an implicit zero high bit, swap endpoints if it's set
+        if (best.indices[0] >= 8) {
+            for (int c = 0; c < 4; c++) std::swap(best.quantized[0][c], best.quantized[1][c]);
+            std::swap(best.pBits[0], best.pBits[1]);
+            for (auto &index: best.indices) index = static_cast<uint8_t>(15 - index);
+        }
+
+        memset(out, 0, 16);
+        BitWriter writer{out};
+        writer.write(1 << 6, 7);
+        for (int c = 0; c < 4; c++) {
+            writer.write(best.quantized[0][c], 7);
+            writer.write(best.quantized[1][c], 7);
+        }
+        writer.write(best.pBits[0], 1);
+        writer.write(best.pBits[1], 1);
+        writer.write(best.indices[0], 3);
+        for (int p = 1; p < 16; p++) {
+            writer.write(best.indices[p], 4);
+        }
+    }
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+namespace TextureCooker {
+    // encodes a 4x4 RGBA8 block (row-major, 64 bytes) into 16 bytes of BC7
+    // uses mode 6 only: one subset, 7-bit RGBA endpoints with p-bits and 4-bit indices
+    void encode_bc7_block(const uint8_t *rgba, uint8_t *out);
+}
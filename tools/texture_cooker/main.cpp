@@ -0,0 +1,290 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <vk/ktx.h>
+#include <vk/mipmap.h>
+#include <vk/thread_pool.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_DXT_IMPLEMENTATION
+
+#include <stb_image.h>
+#include <stb_dxt.h>
+
+#include "bc7.h"
+
+namespace TextureCooker {
+    // block rows encoded per thread pool job
+    constexpr uint32_t BAND_BLOCK_ROWS = 16;
+
+    enum class TextureKind {
+        Color,
+        Normal,
+        Data
+    };
+
+    struct Options {
+        bool force = false;
+        bool highQuality = false;
+    };
+
+    // waits for a fixed number of jobs to finish
+    struct JobCounter {
+        std::mutex mutex;
+        std::condition_variable condition;
+        size_t remaining = 0;
+
+        void finish() {
+            std::lock_guard<std::mutex> lock(mutex);
+            remaining--;
+            condition.notify_one();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return remaining == 0; });
+        }
+    };
+
+    static const char *format_name(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                return "BC1";
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+                return "BC4";
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                return "BC5";
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+                return "BC7";
+            default:
+                return "unknown";
+        }
+    }
+
+    static bool is_image_path(const std::string &filePath) {
+        std::string extension = std::filesystem::path(filePath).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+    }
+
+    static TextureKind texture_kind(aiTextureType type) {
+        switch (type) {
+            case aiTextureType_DIFFUSE:
+            case aiTextureType_BASE_COLOR:
+            case aiTextureType_EMISSIVE:
+            case aiTextureType_EMISSION_COLOR:
+            case aiTextureType_SPECULAR:
+            case aiTextureType_AMBIENT:
+                return TextureKind::Color;
+            case aiTextureType_NORMALS:
+            case aiTextureType_NORMAL_CAMERA:
+                return TextureKind::Normal;
+            default:
+                return TextureKind::Data;
+        }
+    }
+
+    static void collect_model_textures(const std::string &modelPath, std::map<std::string, TextureKind> &textures) {
+        Assimp::Importer importer;
+        const aiScene *scene = importer.ReadFile(modelPath, 0);
+        if (!scene) {
+            std::cout << "Assimp error: " << importer.GetErrorString() << std::endl;
+            return;
+        }
+
+        // same path resolution as Model::process_mesh
+        std::string directory = modelPath.substr(0, modelPath.find_last_of('/'));
+        const aiTextureType types[] = {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_AMBIENT, aiTextureType_EMISSIVE, aiTextureType_HEIGHT,
+                                       aiTextureType_NORMALS, aiTextureType_SHININESS, aiTextureType_OPACITY, aiTextureType_DISPLACEMENT, aiTextureType_LIGHTMAP,
+                                       aiTextureType_REFLECTION, aiTextureType_BASE_COLOR, aiTextureType_NORMAL_CAMERA, aiTextureType_EMISSION_COLOR,
+                                       aiTextureType_METALNESS, aiTextureType_DIFFUSE_ROUGHNESS, aiTextureType_AMBIENT_OCCLUSION, aiTextureType_UNKNOWN};
+        for (uint32_t m = 0; m < scene->mNumMaterials; m++) {
+            aiMaterial *material = scene->mMaterials[m];
+            for (aiTextureType type: types) {
+                for (uint32_t i = 0; i < material->GetTextureCount(type); i++) {
+                    aiString str;
+                    material->GetTexture(type, i, &str);
+                    if (str.C_Str()[0] == '*') {
+                        std::cout << "Skipping embedded texture " << str.C_Str() << " in " << modelPath << std::endl;
+                        continue;
+                    }
+                    // first use decides the kind
+                    textures.emplace(directory + '/' + str.C_Str(), texture_kind(type));
+                }
+            }
+        }
+    }
+
+    static VkFormat choose_format(TextureKind kind, const uint8_t *pixels, size_t texelCount, const Options &options) {
+        bool hasAlpha = false;
+        bool grayscale = true;
+        for (size_t i = 0; i < texelCount; i++) {
+            const uint8_t *texel = pixels + i * 4;
+            hasAlpha |= texel[3] != 255;
+            grayscale &= texel[0] == texel[1] && texel[1] == texel[2];
+        }
+
+        switch (kind) {
+            case TextureKind::Color:
+                return hasAlpha || options.highQuality ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+            case TextureKind::Normal:
+                return VK_FORMAT_BC5_UNORM_BLOCK;
+            case TextureKind::Data:
+            default:
+                return grayscale && !hasAlpha ? VK_FORMAT_BC4_UNORM_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+    }
+
+    static void encode_blocks(VkFormat format, const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t firstRow, uint32_t lastRow, uint8_t *out) {
+        uint32_t blocksWide = (width + 3) / 4;
+        uint32_t blockBytes = VkRenderer::ktx::block_bytes(format);
+        for (uint32_t by = firstRow; by < lastRow; by++) {
+            for (uint32_t bx = 0; bx < blocksWide; bx++) {
+                // gather the block, edges clamp for levels smaller than 4x4
+                uint8_t block[64];
+                for (uint32_t y = 0; y < 4; y++) {
+                    for (uint32_t x = 0; x < 4; x++) {
+                        uint32_t px = std::min(bx * 4 + x, width - 1);
+                        uint32_t py = std::min(by * 4 + y, height - 1);
+                        memcpy(block + (y * 4 + x) * 4, pixels + (static_cast<size_t>(py) * width + px) * 4, 4);
+                    }
+                }
+
+                uint8_t *dst = out + (static_cast<size_t>(by) * blocksWide + bx) * blockBytes;
+                switch (format) {
+                    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                        stb_compress_dxt_block(dst, block, 0, STB_DXT_HIGHQUAL);
+                        break;
+                    case VK_FORMAT_BC4_UNORM_BLOCK: {
+                        uint8_t red[16];
+                        for (int i = 0; i < 16; i++) red[i] = block[i * 4];
+                        stb_compress_bc4_block(dst, red);
+                        break;
+                    }
+                    case VK_FORMAT_BC5_UNORM_BLOCK: {
+                        uint8_t redGreen[32];
+                        for (int i = 0; i < 16; i++) {
+                            redGreen[i * 2] = block[i * 4];
+                            redGreen[i * 2 + 1] = block[i * 4 + 1];
+                        }
+                        stb_compress_bc5_block(dst, redGreen);
+                        break;
+                    }
+                    default:
+                        encode_bc7_block(block, dst);
+                        break;
+                }
+            }
+        }
+    }
+
+    static bool cook_texture(const std::string &filePath, TextureKind kind, VkRenderer::ThreadPool &pool, const Options &options) {
+        std::string cookedPath = VkRenderer::ktx::cooked_path(filePath);
+        std::error_code error;
+        if (!options.force && std::filesystem::exists(cookedPath, error) &&
+            std::filesystem::last_write_time(cookedPath, error) >= std::filesystem::last_write_time(filePath, error)) {
+            std::cout << "Up to date: " << cookedPath << std::endl;
+            return true;
+        }
+
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load(filePath.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            std::cout << "Failed to load texture " << filePath << std::endl;
+            return false;
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        // mips are filtered before compression, in linear space for color
+        VkFormat format = choose_format(kind, pixels, static_cast<size_t>(width) * height, options);
+        std::vector<uint8_t> mipChain;
+        VkRenderer::mipmap::generate_chain(pixels, width, height, mipChain, kind == TextureKind::Color);
+
+        uint32_t levelCount = VkRenderer::mipmap::level_count(width, height);
+        std::vector<std::vector<uint8_t>> levels(levelCount);
+        JobCounter counter;
+        size_t chainOffset = 0;
+        for (uint32_t level = 0; level < levelCount; level++) {
+            uint32_t levelWidth = std::max(static_cast<uint32_t>(width) >> level, 1u);
+            uint32_t levelHeight = std::max(static_cast<uint32_t>(height) >> level, 1u);
+            const uint8_t *levelPixels = level == 0 ? pixels : mipChain.data() + chainOffset;
+            uint32_t blocksHigh = (levelHeight + 3) / 4;
+            levels[level].resize(static_cast<size_t>((levelWidth + 3) / 4) * blocksHigh * VkRenderer::ktx::block_bytes(format));
+
+            // split each level into bands of block rows across the pool
+            for (uint32_t row = 0; row < blocksHigh; row += BAND_BLOCK_ROWS) {
+                uint32_t lastRow = std::min(row + BAND_BLOCK_ROWS, blocksHigh);
+                uint8_t *out = levels[level].data();
+                {
+                    std::lock_guard<std::mutex> lock(counter.mutex);
+                    counter.remaining++;
+                }
+                pool.submit([=, &counter]() {
+                    encode_blocks(format, levelPixels, levelWidth, levelHeight, row, lastRow, out);
+                    counter.finish();
+                });
+            }
+
+            if (level > 0) chainOffset += static_cast<size_t>(levelWidth) * levelHeight * 4;
+        }
+        counter.wait();
+        stbi_image_free(pixels);
+
+        if (!VkRenderer::ktx::write(cookedPath, format, width, height, levels)) {
+            return false;
+        }
+
+        size_t cookedBytes = 0;
+        for (auto &level: levels) cookedBytes += level.size();
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Cooked " << filePath << " -> " << format_name(format) << ", " << levelCount << " levels, "
+                  << (static_cast<size_t>(width) * height * 4 * 4 / 3) / 1024 << " KiB -> " << cookedBytes / 1024 << " KiB in " << elapsed << " ms" << std::endl;
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    TextureCooker::Options options;
+    std::map<std::string, TextureCooker::TextureKind> textures;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--force") {
+            options.force = true;
+        } else if (arg == "--high-quality") {
+            options.highQuality = true;
+        } else if (TextureCooker::is_image_path(arg)) {
+            // loose images are assumed to be color
+            textures.emplace(arg, TextureCooker::TextureKind::Color);
+        } else {
+            TextureCooker::collect_model_textures(arg, textures);
+        }
+    }
+
+    if (textures.empty()) {
+        std::cout << "usage: texture_cooker [--force] [--high-quality] <model or image>..." << std::endl;
+        return 1;
+    }
+
+    uint32_t coreCount = std::thread::hardware_concurrency();
+    VkRenderer::ThreadPool pool;
+    pool.init(coreCount > 0 ? coreCount : 1);
+
+    int failures = 0;
+    for (auto &it: textures) {
+        if (!TextureCooker::cook_texture(it.first, it.second, pool, options)) {
+            failures++;
+        }
+    }
+
+    pool.cleanup();
+    return failures == 0 ? 0 : 1;
+}